@@ -15,8 +15,11 @@ extern "C"
     typedef void *UNIGD_RENDERERS_HANDLE;
     typedef void *UNIGD_RENDERERS_ENTRY_HANDLE;
     typedef void *UNIGD_FIND_HANDLE;
+    typedef void *UNIGD_PLOTS_INFO_HANDLE;
+    typedef void *UNIGD_SEARCH_HANDLE;
     typedef const char *UNIGD_RENDERER_ID;
     typedef uint32_t UNIGD_PLOT_ID;
+    typedef uint32_t UNIGD_PLOT_VERSION;
     typedef uint32_t UNIGD_PLOT_INDEX;
     typedef int32_t UNIGD_PLOT_RELATIVE;
     typedef uint32_t UNIGD_CLIENT_ID;
@@ -60,12 +63,139 @@ extern "C"
         double scale;
     };
 
+    enum unigd_render_encoding
+    {
+        UNIGD_RENDER_ENCODING_IDENTITY = 0,
+        // gzip (RFC 1952) compressed, usable as HTTP 'Content-Encoding: gzip'.
+        UNIGD_RENDER_ENCODING_GZIP = 1,
+        // Raw deflate (RFC 1951) with the preset dictionary from
+        // render_encoding_dictionary.
+        UNIGD_RENDER_ENCODING_DEFLATE_DICT = 2
+    };
+
+    // Receives chunks of streamed render output, return false to abort.
+    typedef bool (*unigd_render_writer)(void *writer_data, const uint8_t *data, uint64_t size);
+
     struct unigd_render_access
     {
         const uint8_t *buffer;
         uint64_t size;
     };
 
+    // Receives the full quality result of a progressive render. Called from a worker
+    // thread, handle is NULL if the render failed. Free with device_render_destroy.
+    typedef void (*unigd_render_ready)(void *ready_data, UNIGD_RENDER_HANDLE handle,
+                                       const unigd_render_access *access);
+
+    struct unigd_shm_access
+    {
+        // POSIX shared memory object name (for shm_open).
+        const char *name;
+        // Sequence number of the output, also stored as uint64 at the start of the
+        // segment followed by the output size (uint64). It is odd while a render
+        // writes into the segment and even when the output is complete: readers copy
+        // the output and check that the stored generation is still this value.
+        // The uint64 after the size is set to 1 when the device drops the segment
+        // (see device_render_shm), the next render returns a new name then.
+        uint64_t generation;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct unigd_render_estimate
+    {
+        // Renderer the estimate is for (the selected one for 'auto' IDs).
+        UNIGD_RENDERER_ID renderer_id;
+        double bytes;
+        double seconds;
+    };
+
+    struct unigd_render_patch
+    {
+        // Plot version the patch is rendered from, pass as 'since' for the next patch.
+        UNIGD_PLOT_VERSION version;
+        // Position and size of the patch in pixels. Zero size if nothing changed.
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+        // The patch covers the whole plot.
+        bool full;
+    };
+
+    enum unigd_primitive_type
+    {
+        // Center (x0, y0) and radius x1.
+        UNIGD_PRIMITIVE_CIRCLE = 0,
+        // From (x0, y0) to (x1, y1).
+        UNIGD_PRIMITIVE_LINE = 1,
+        // Corners (x0, y0) and (x1, y1).
+        UNIGD_PRIMITIVE_RECT = 2
+    };
+
+    struct unigd_primitive_style
+    {
+        // Colors as packed by R (red in the lowest byte, alpha in the highest).
+        uint32_t col;
+        uint32_t fill;
+        // Line width in R units (1/96 inch).
+        double lwd;
+        // R line type (0 solid, -1 blank).
+        int32_t lty;
+    };
+
+    struct unigd_clip_rect
+    {
+        double x;
+        double y;
+        double width;
+        double height;
+    };
+
+    // Primitives of one type as struct of arrays. Coordinates are in plot units
+    // (1/72 inch) with the origin at the top left.
+    struct unigd_primitive_batch
+    {
+        unigd_primitive_type type;
+        uint64_t size;
+        const double *x0;
+        const double *y0;
+        const double *x1;
+        // Not used for circles, can be NULL.
+        const double *y1;
+        // Per primitive index into styles, NULL to use styles[0] for all primitives.
+        const uint32_t *style;
+        const unigd_primitive_style *styles;
+        uint32_t styles_size;
+        // Per primitive index into clips, NULL to use clips[0] for all primitives.
+        // Without clips the current clipping region of the plot is used.
+        const uint32_t *clip;
+        const unigd_clip_rect *clips;
+        uint32_t clips_size;
+    };
+
+    struct unigd_render_limits
+    {
+        // Renders running at the same time (at least 1).
+        uint32_t workers;
+        // Render requests waiting for a worker, further requests are rejected.
+        uint32_t queue;
+        // Waiting render requests per client key, 0 for no extra limit.
+        uint32_t client_queue;
+    };
+
+    struct unigd_render_queue_stats
+    {
+        unigd_render_limits limits;
+        uint32_t running;
+        uint32_t queued;
+        // Client keys with waiting render requests.
+        uint32_t clients;
+        uint32_t peak_queued;
+        uint64_t admitted;
+        uint64_t rejected;
+    };
+
     struct unigd_find_results
     {
         unigd_device_state state;
@@ -73,6 +203,44 @@ extern "C"
         UNIGD_PLOT_ID *ids;
     };
 
+    struct unigd_plot_info
+    {
+        UNIGD_PLOT_ID id;
+        UNIGD_PLOT_INDEX index;
+        UNIGD_PLOT_VERSION version;
+        double width;
+        double height;
+        uint64_t draw_calls;
+        uint64_t clips;
+        uint64_t raster_bytes;
+        // Seconds since epoch of the last render, 0 if the plot was never rendered.
+        double last_render;
+    };
+
+    struct unigd_plots_info_results
+    {
+        unigd_device_state state;
+        UNIGD_PLOT_INDEX size;
+        unigd_plot_info *entries;
+    };
+
+    struct unigd_text_match
+    {
+        UNIGD_PLOT_ID id;
+        UNIGD_PLOT_INDEX index;
+        // Position of the text in the plot.
+        double x;
+        double y;
+        const char *text;
+    };
+
+    struct unigd_search_results
+    {
+        unigd_device_state state;
+        UNIGD_PLOT_INDEX size;
+        unigd_text_match *matches;
+    };
+
     // unigd API access version 1
     struct unigd_api_v1
     {
@@ -119,7 +287,7 @@ extern "C"
         // Clear plot history.
         bool (*device_plots_clear)(UNIGD_HANDLE);
 
-        // Plot ID lookup.
+        // Plot ID lookup. Plot versions are returned by device_plots_info.
         UNIGD_FIND_HANDLE(*device_plots_find)
         (UNIGD_HANDLE, UNIGD_PLOT_RELATIVE offset, UNIGD_PLOT_INDEX limit, unigd_find_results *results);
 
@@ -141,6 +309,125 @@ extern "C"
 
         // Free memory of renderer lookup.
         void (*renderers_find_destroy)(UNIGD_RENDERERS_ENTRY_HANDLE);
+
+        // CACHING
+
+        // Fingerprint of the output a render call with the same arguments would produce.
+        // Can be used as HTTP ETag. Returns false when the plot does not exist or needs
+        // to be replayed at a different size first.
+        bool (*device_render_fingerprint)(UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID,
+                                          unigd_render_args, uint64_t *fingerprint);
+
+        // HISTORY
+
+        // Metadata of a range of plots in a single call.
+        UNIGD_PLOTS_INFO_HANDLE(*device_plots_info)
+        (UNIGD_HANDLE, UNIGD_PLOT_RELATIVE offset, UNIGD_PLOT_INDEX limit, unigd_plots_info_results *results);
+
+        // Free plot metadata memory.
+        void (*device_plots_info_destroy)(UNIGD_PLOTS_INFO_HANDLE);
+
+        // Render plot in the requested content encoding. Text renderer results are
+        // cached per plot version, so encoded variants are only computed once.
+        // Returns NULL if the output can not be encoded. Free with
+        // device_render_destroy.
+        UNIGD_RENDER_HANDLE(*device_render_create_encoded)
+        (UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID, unigd_render_args,
+         unigd_render_encoding, unigd_render_access *);
+
+        // Preset dictionary used by UNIGD_RENDER_ENCODING_DEFLATE_DICT. The ID is the
+        // Adler-32 checksum of the dictionary. The buffer is static, do not free.
+        void (*render_encoding_dictionary)(unigd_render_access *dictionary,
+                                           uint32_t *dictionary_id);
+
+        // Render plot and pass the output to a writer as it is produced, without
+        // buffering the whole file (for renderers that support it).
+        bool (*device_render_stream)(UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID,
+                                     unigd_render_args, unigd_render_writer writer,
+                                     void *writer_data);
+
+        // Render plot and write the output to a file descriptor.
+        bool (*device_render_fd)(UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID,
+                                 unigd_render_args, int fd);
+
+        // Render plot into a shared memory segment owned by the device. Local clients
+        // can map the segment instead of copying the output. Each render client (see
+        // render_client) gets a segment of its own, which is reused by its next call.
+        // The segments of the least recently rendering clients are dropped when more
+        // than 16 clients use this call. The name stays valid until the next call of
+        // the calling thread. Not available on Windows.
+        bool (*device_render_shm)(UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID,
+                                  unigd_render_args, unigd_shm_access *);
+
+        // Render a range of plots into a single multi-page document (renderers 'pdf',
+        // 'ps', 'tiff' and 'apng'). Free with device_render_destroy.
+        UNIGD_RENDER_HANDLE(*device_render_document_create)
+        (UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_RELATIVE from, UNIGD_PLOT_RELATIVE to,
+         unigd_render_args, unigd_render_access *);
+
+        // Progressive rendering: returns a low resolution PNG preview (rendered at
+        // preview_scale, 0.25 if out of range) and renders the full result with the
+        // requested renderer in the background. ready is only called if the preview
+        // handle is not NULL. The full render does not wait for a render slot: if all
+        // are busy, ready receives NULL and render_busy is true. ready receives NULL as
+        // well if the full render fails for any other reason. ready is required: the
+        // call returns NULL without rendering if it is NULL. Free both handles with
+        // device_render_destroy.
+        UNIGD_RENDER_HANDLE(*device_render_progressive)
+        (UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID, unigd_render_args,
+         double preview_scale, unigd_render_access *preview, unigd_render_ready ready,
+         void *ready_data);
+
+        // Predicted output size and render time, calibrated with the render times
+        // measured so far. Renderer ID 'auto' (optionally 'auto:bytes=<n>,ms=<n>')
+        // selects SVG or PNG for the budget and can be passed to all render functions.
+        bool (*device_render_estimate)(UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID,
+                                       unigd_render_args, unigd_render_estimate *);
+
+        // Full-text search over the text of all plots. Returns text draw calls that
+        // contain all words of the query (case-insensitive), ordered by plot index.
+        // A limit of 0 returns all matches.
+        UNIGD_SEARCH_HANDLE(*device_plots_search)
+        (UNIGD_HANDLE, const char *query, UNIGD_PLOT_INDEX limit,
+         unigd_search_results *results);
+
+        // Free search results.
+        void (*device_plots_search_destroy)(UNIGD_SEARCH_HANDLE);
+
+        // Render only the area of a plot that changed after plot version 'since', at the
+        // current plot size. Raster renderers ('png', 'rgba', 'qoi') return a patch to
+        // draw at the given offset, other renderers and unknown versions render the
+        // whole plot. Free with device_render_destroy.
+        UNIGD_RENDER_HANDLE(*device_render_patch)
+        (UNIGD_HANDLE, UNIGD_RENDERER_ID, UNIGD_PLOT_ID, UNIGD_PLOT_VERSION since,
+         double scale, unigd_render_patch *patch, unigd_render_access *);
+
+        // Append a batch of primitives to a plot in one call (thread safe). The batch
+        // is validated first and nothing is appended if it is invalid or has more than
+        // 2^24 primitives. Primitives are not part of the R display list, so they are
+        // lost when R replays the plot (e.g. to render it at a different size).
+        bool (*device_plots_append)(UNIGD_HANDLE, UNIGD_PLOT_ID,
+                                    const unigd_primitive_batch *batch);
+
+        // ADMISSION CONTROL
+
+        // Limit the renders of a device. Render calls wait for a free worker and fail
+        // right away when the queue is full. Waiting requests are served round robin
+        // by client key. Cached results and patches do not wait. Defaults: one worker
+        // per CPU core, a queue of 256 and no per-client limit.
+        void (*device_render_limits)(UNIGD_HANDLE, unigd_render_limits limits);
+
+        // Current queue depths and counters of the render queue.
+        unigd_render_queue_stats (*device_render_queue)(UNIGD_HANDLE);
+
+        // Client key for the render calls of the calling thread (e.g. a connection ID),
+        // 0 by default.
+        void (*render_client)(uint64_t client_key);
+
+        // The last render call of the calling thread was rejected because the render
+        // queue was full. Clients can answer with 'busy' (e.g. HTTP 503) instead of an
+        // error.
+        bool (*render_busy)();
     };
 
 #ifdef __cplusplus
@@ -0,0 +1,272 @@
+#include "apng.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+
+namespace unigd
+{
+namespace apng
+{
+namespace
+{
+const int bytes_per_pixel = 4;
+
+inline void put_u32(std::vector<uint8_t> *t_buf, uint32_t t_value)
+{
+  t_buf->push_back(static_cast<uint8_t>(t_value >> 24));
+  t_buf->push_back(static_cast<uint8_t>(t_value >> 16));
+  t_buf->push_back(static_cast<uint8_t>(t_value >> 8));
+  t_buf->push_back(static_cast<uint8_t>(t_value));
+}
+
+inline void put_u16(std::vector<uint8_t> *t_buf, uint16_t t_value)
+{
+  t_buf->push_back(static_cast<uint8_t>(t_value >> 8));
+  t_buf->push_back(static_cast<uint8_t>(t_value));
+}
+
+void write_chunk(output_sink *t_out, const char *t_type, const uint8_t *t_data,
+                 std::size_t t_size)
+{
+  std::vector<uint8_t> head;
+  put_u32(&head, static_cast<uint32_t>(t_size));
+  head.insert(head.end(), t_type, t_type + 4);
+  t_out->write(head.data(), head.size());
+  t_out->write(t_data, t_size);
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<const Bytef *>(t_type), 4);
+  if (t_size > 0)
+  {
+    crc = crc32(crc, t_data, static_cast<uInt>(t_size));
+  }
+  std::vector<uint8_t> tail;
+  put_u32(&tail, static_cast<uint32_t>(crc));
+  t_out->write(tail.data(), tail.size());
+}
+
+inline void write_chunk(output_sink *t_out, const char *t_type,
+                        const std::vector<uint8_t> &t_data)
+{
+  write_chunk(t_out, t_type, t_data.data(), t_data.size());
+}
+
+// Pixel of a frame, transparent outside of the frame bounds
+inline uint32_t pixel(const frame &t_frame, int x, int y)
+{
+  if (x >= t_frame.width || y >= t_frame.height)
+  {
+    return 0;
+  }
+  uint32_t px;
+  std::memcpy(&px, &t_frame.rgba[(static_cast<std::size_t>(y) * t_frame.width + x) * 4],
+              sizeof(px));
+  return px;
+}
+
+// Bounding box of all pixels that differ between two frames. Both frames are
+// transparent outside of their bounds.
+bool diff_region(const frame &t_prev, const frame &t_next, region *t_region)
+{
+  const int width = std::max(t_prev.width, t_next.width);
+  const int height = std::max(t_prev.height, t_next.height);
+  int x0 = width, y0 = height, x1 = -1, y1 = -1;
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      if (pixel(t_prev, x, y) != pixel(t_next, x, y))
+      {
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x);
+        y0 = std::min(y0, y);
+        y1 = std::max(y1, y);
+      }
+    }
+  }
+  if (x1 < 0)
+  {
+    return false;
+  }
+  *t_region = {x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+  return true;
+}
+
+// Filter (PNG "Sub" filter) and deflate a frame region
+std::vector<uint8_t> compress_region(const frame &t_frame, region t_rect)
+{
+  const std::size_t row_size = static_cast<std::size_t>(t_rect.width) * bytes_per_pixel;
+  std::vector<uint8_t> raw((row_size + 1) * t_rect.height);
+  std::vector<uint8_t> row(row_size);
+  for (int y = 0; y < t_rect.height; ++y)
+  {
+    for (int x = 0; x < t_rect.width; ++x)
+    {
+      const uint32_t px = pixel(t_frame, t_rect.x + x, t_rect.y + y);
+      std::memcpy(&row[static_cast<std::size_t>(x) * bytes_per_pixel], &px, sizeof(px));
+    }
+    uint8_t *dst = &raw[y * (row_size + 1)];
+    dst[0] = 1;  // Sub
+    for (std::size_t i = 0; i < row_size; ++i)
+    {
+      dst[i + 1] = row[i] - (i >= bytes_per_pixel ? row[i - bytes_per_pixel] : 0);
+    }
+  }
+
+  uLongf size = compressBound(static_cast<uLong>(raw.size()));
+  std::vector<uint8_t> out(size);
+  if (compress2(out.data(), &size, raw.data(), static_cast<uLong>(raw.size()),
+                Z_DEFAULT_COMPRESSION) != Z_OK)
+  {
+    return {};
+  }
+  out.resize(size);
+  return out;
+}
+
+std::vector<uint8_t> fctl(uint32_t t_sequence, region t_rect, uint16_t t_delay_num,
+                          uint16_t t_delay_den)
+{
+  std::vector<uint8_t> c;
+  put_u32(&c, t_sequence);
+  put_u32(&c, t_rect.width);
+  put_u32(&c, t_rect.height);
+  put_u32(&c, t_rect.x);
+  put_u32(&c, t_rect.y);
+  put_u16(&c, t_delay_num);
+  put_u16(&c, t_delay_den);
+  c.push_back(0);  // APNG_DISPOSE_OP_NONE
+  c.push_back(0);  // APNG_BLEND_OP_SOURCE
+  return c;
+}
+}  // namespace
+
+encoder::encoder(uint16_t t_delay_num, uint16_t t_delay_den, async::thread_pool *t_pool)
+    : m_delay_num(t_delay_num),
+      m_delay_den(t_delay_den),
+      m_pool(t_pool),
+      m_start(std::chrono::steady_clock::now())
+{
+}
+
+void encoder::add(std::shared_ptr<const frame> t_frame)
+{
+  m_width = std::max(m_width, t_frame->width);
+  m_height = std::max(m_height, t_frame->height);
+  if (!m_first)
+  {
+    m_first = t_frame;
+    m_prev = std::move(t_frame);
+    m_frames.push_back({{0, 0, 0, 0}, m_delay_num, {}});
+    return;
+  }
+
+  auto prev = std::move(m_prev);
+  m_prev = t_frame;
+  m_pending.push_back(m_pool->submit(
+      [prev, next = std::move(t_frame)]()
+      {
+        diff d{false, {0, 0, 1, 1}, {}};
+        d.changed = diff_region(*prev, *next, &d.rect);
+        d.data = compress_region(*next, d.rect);
+        return d;
+      }));
+
+  // Bounds the number of frames held by tasks
+  while (m_pending.size() > 2 * m_pool->size())
+  {
+    m_resolve_front();
+  }
+}
+
+void encoder::m_resolve_front()
+{
+  auto d = m_pool->get(m_pending.front());
+  m_pending.pop_front();
+  // Identical frames show the previous frame longer, as long as the delay fits
+  if (!d.changed &&
+      m_frames.back().delay_num <= std::numeric_limits<uint16_t>::max() - m_delay_num)
+  {
+    m_frames.back().delay_num += m_delay_num;
+    return;
+  }
+  m_frames.push_back({d.rect, m_delay_num, std::move(d.data)});
+}
+
+bool encoder::finish(output_sink *t_out, encode_stats *t_stats)
+{
+  while (!m_pending.empty())
+  {
+    m_resolve_front();
+  }
+  if (m_frames.empty() || m_width <= 0 || m_height <= 0)
+  {
+    return false;
+  }
+  m_frames[0].rect = {0, 0, m_width, m_height};
+  m_frames[0].data = compress_region(*m_first, m_frames[0].rect);
+  m_first.reset();
+  m_prev.reset();
+
+  static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  t_out->write(signature, sizeof(signature));
+
+  std::vector<uint8_t> ihdr;
+  put_u32(&ihdr, m_width);
+  put_u32(&ihdr, m_height);
+  ihdr.push_back(8);  // bit depth
+  ihdr.push_back(6);  // RGBA
+  ihdr.push_back(0);  // deflate
+  ihdr.push_back(0);  // adaptive filtering
+  ihdr.push_back(0);  // no interlace
+  write_chunk(t_out, "IHDR", ihdr);
+
+  std::vector<uint8_t> actl;
+  put_u32(&actl, static_cast<uint32_t>(m_frames.size()));
+  put_u32(&actl, 0);  // loop forever
+  write_chunk(t_out, "acTL", actl);
+
+  uint32_t sequence = 0;
+  std::size_t changed_pixels = 0;
+  for (std::size_t i = 0; i < m_frames.size(); ++i)
+  {
+    const auto &f = m_frames[i];
+    write_chunk(t_out, "fcTL", fctl(sequence++, f.rect, f.delay_num, m_delay_den));
+    if (f.data.empty())
+    {
+      return false;
+    }
+    if (i == 0)
+    {
+      write_chunk(t_out, "IDAT", f.data);
+    }
+    else
+    {
+      std::vector<uint8_t> fdat;
+      fdat.reserve(f.data.size() + 4);
+      put_u32(&fdat, sequence++);
+      fdat.insert(fdat.end(), f.data.begin(), f.data.end());
+      write_chunk(t_out, "fdAT", fdat);
+    }
+    changed_pixels += static_cast<std::size_t>(f.rect.width) * f.rect.height;
+  }
+  write_chunk(t_out, "IEND", nullptr, 0);
+
+  if (t_stats)
+  {
+    t_stats->frames = m_frames.size();
+    t_stats->changed_pixels = changed_pixels;
+    t_stats->seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+  }
+  m_frames.clear();
+  return t_out->ok();
+}
+
+}  // namespace apng
+}  // namespace unigd
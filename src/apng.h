@@ -0,0 +1,91 @@
+#ifndef __UNIGD_APNG_H__
+#define __UNIGD_APNG_H__
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "async_utils.h"
+#include "output_sink.h"
+
+namespace unigd
+{
+// Animated PNG (APNG) encoder.
+// See: https://wiki.mozilla.org/APNG_Specification
+namespace apng
+{
+// Straight (not premultiplied) 8 bit RGBA pixels, row major.
+struct frame
+{
+  int width;
+  int height;
+  std::vector<uint8_t> rgba;
+};
+
+struct encode_stats
+{
+  std::size_t frames;          // frames in the output (identical frames are merged)
+  std::size_t changed_pixels;  // sum of all frame regions
+  double seconds;              // wall time spent encoding
+};
+
+// Area of the canvas in pixels
+struct region
+{
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// Frames are placed at the top left of a canvas that fits all frames. Only the
+// region that changed since the previous frame is stored.
+// Frames are diffed and compressed on the pool as they are added. Besides the first
+// frame (the default image, which needs the final canvas size) only the previous
+// frame and the frames of running tasks are kept in memory.
+class encoder
+{
+ public:
+  encoder(uint16_t t_delay_num, uint16_t t_delay_den, async::thread_pool *t_pool);
+
+  // Frames have to be added in order from a single thread
+  void add(std::shared_ptr<const frame> t_frame);
+  bool finish(output_sink *t_out, encode_stats *t_stats = nullptr);
+
+ private:
+  struct diff
+  {
+    bool changed;
+    region rect;
+    std::vector<uint8_t> data;  // compressed, a single pixel for unchanged frames
+  };
+  struct out_frame
+  {
+    region rect;
+    uint16_t delay_num;
+    std::vector<uint8_t> data;
+  };
+
+  uint16_t m_delay_num;
+  uint16_t m_delay_den;
+  async::thread_pool *m_pool;
+  std::chrono::steady_clock::time_point m_start;
+
+  int m_width{0};
+  int m_height{0};
+  std::shared_ptr<const frame> m_first;
+  std::shared_ptr<const frame> m_prev;
+  std::deque<std::future<diff>> m_pending;
+  // m_frames[0] is the first frame, its data is compressed by finish()
+  std::vector<out_frame> m_frames;
+
+  void m_resolve_front();
+};
+
+}  // namespace apng
+}  // namespace unigd
+
+#endif /* __UNIGD_APNG_H__ */
@@ -0,0 +1,36 @@
+#include "async_utils.h"
+
+namespace unigd
+{
+namespace async
+{
+namespace
+{
+std::mutex worker_pool_mutex;
+// Not a static object: it must not be destroyed (and run tasks) at process exit
+thread_pool *shared_pool = nullptr;
+}  // namespace
+
+thread_pool *worker_pool()
+{
+  const std::lock_guard<std::mutex> lock(worker_pool_mutex);
+  if (!shared_pool)
+  {
+    shared_pool = new thread_pool();
+  }
+  return shared_pool;
+}
+
+void worker_pool_shutdown()
+{
+  thread_pool *pool;
+  {
+    const std::lock_guard<std::mutex> lock(worker_pool_mutex);
+    pool = shared_pool;
+    shared_pool = nullptr;
+  }
+  delete pool;
+}
+
+}  // namespace async
+}  // namespace unigd
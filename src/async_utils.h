@@ -1,11 +1,17 @@
 #ifndef __UNIGD_ASYNC_UTILS_H__
 #define __UNIGD_ASYNC_UTILS_H__
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace unigd
 {
@@ -98,6 +104,8 @@ class function_wrapper
 
   void call() { impl->call(); }
 
+  explicit operator bool() const { return impl != nullptr; }
+
   function_wrapper(function_wrapper &&other) : impl(std::move(other.impl)) {}
 
   function_wrapper &operator=(function_wrapper &&other)
@@ -110,6 +118,112 @@ class function_wrapper
   function_wrapper(function_wrapper &) = delete;
   function_wrapper &operator=(const function_wrapper &) = delete;
 };
+
+// Fixed size worker pool. Tasks must not call into R.
+class thread_pool
+{
+ public:
+  explicit thread_pool(unsigned t_threads = std::thread::hardware_concurrency())
+  {
+    t_threads = std::max(1U, t_threads);
+    m_threads.reserve(t_threads);
+    for (unsigned i = 0; i < t_threads; ++i)
+    {
+      m_threads.emplace_back(&thread_pool::worker_thread, this);
+    }
+  }
+
+  ~thread_pool()
+  {
+    // an empty task stops one worker
+    for (std::size_t i = 0; i < m_threads.size(); ++i)
+    {
+      m_work_queue.push(function_wrapper());
+    }
+    for (auto &t : m_threads)
+    {
+      t.join();
+    }
+  }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  template <typename FunctionType>
+  std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+  {
+    using result_type = typename std::result_of<FunctionType()>::type;
+    std::packaged_task<result_type()> task(std::move(f));
+    std::future<result_type> res(task.get_future());
+    m_work_queue.push(std::move(task));
+    return res;
+  }
+
+  // Result of a task submitted to this pool. Called from a worker of the pool, other
+  // queued tasks are run while waiting, so tasks can wait for tasks they submitted
+  // without using up all workers.
+  template <typename T>
+  T get(std::future<T> &t_future)
+  {
+    if (current_pool() == this)
+    {
+      while (t_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      {
+        function_wrapper task;
+        if (m_work_queue.try_pop(task))
+        {
+          if (!task)
+          {
+            // stop marker of the destructor, leave it to the worker loop
+            m_work_queue.push(std::move(task));
+            t_future.wait();
+            break;
+          }
+          task.call();
+        }
+        else
+        {
+          t_future.wait_for(std::chrono::microseconds(100));
+        }
+      }
+    }
+    return t_future.get();
+  }
+
+  std::size_t size() const { return m_threads.size(); }
+
+ private:
+  threadsafe_queue<function_wrapper> m_work_queue;
+  std::vector<std::thread> m_threads;
+
+  static thread_pool *&current_pool()
+  {
+    thread_local thread_pool *pool = nullptr;
+    return pool;
+  }
+
+  void worker_thread()
+  {
+    current_pool() = this;
+    for (;;)
+    {
+      function_wrapper task;
+      m_work_queue.wait_and_pop(task);
+      if (!task)
+      {
+        return;
+      }
+      task.call();
+    }
+  }
+};
+
+// Pool shared by all renderers and devices for background and parallel work (e.g.
+// compression, progressive renders). Created on first use.
+thread_pool *worker_pool();
+// Runs all queued tasks and stops the workers, called when the package is unloaded
+// so no task outlives the library or runs during static destruction.
+void worker_pool_shutdown();
 }  // namespace async
 
 }  // namespace unigd
@@ -2,6 +2,8 @@
 
 #include <cmath>
 
+#include "png_palette.h"
+
 extern "C"
 {
 #include <png.h>
@@ -53,10 +55,10 @@ static void png_memory_write(png_structp png_ptr, png_bytep data, png_size_t len
   std::vector<uint8_t> *p = (std::vector<uint8_t> *)png_get_io_ptr(png_ptr);
   p->insert(p->end(), data, data + length);
 }
-inline std::string raster_to_string(std::vector<unsigned int> raster_, int w, int h,
-                                    double width, double height, bool interpolate)
+inline std::string raster_to_string(const std::vector<unsigned int> &raster_, int w,
+                                    int h, double width, double height, bool interpolate)
 {
-  unsigned int *raster = raster_.data();
+  const unsigned int *raster = raster_.data();
 
   h = h < 0 ? -h : h;
   w = w < 0 ? -w : w;
@@ -101,6 +103,15 @@ inline std::string raster_to_string(std::vector<unsigned int> raster_, int w, in
     h = h_new;
   }
 
+  // Lossless only, raster images are often photos or gradients
+  output_sink indexed;
+  if (png_palette::encode(raster, w, h, static_cast<size_t>(w) * 4,
+                          png_palette::pixel_format::r_color, png_palette::mode::exact,
+                          &indexed))
+  {
+    return base64_encode(indexed.data(), indexed.size());
+  }
+
   png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (!png)
   {
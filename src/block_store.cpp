@@ -0,0 +1,136 @@
+#include "block_store.h"
+
+#include <algorithm>
+
+namespace unigd
+{
+namespace
+{
+// Shorter runs are not worth a block
+constexpr std::size_t min_block_size{4};
+
+// Equal hashes are not enough to share draw calls, a collision would show the
+// content of another page
+bool same_draw_calls(
+    const std::vector<std::shared_ptr<const renderers::DrawCall>> &t_stored,
+    const std::vector<std::shared_ptr<const renderers::DrawCall>> &t_dcs,
+    std::size_t t_begin)
+{
+  for (std::size_t i = 0; i < t_stored.size(); ++i)
+  {
+    const auto &dc = t_dcs[t_begin + i];
+    if (dc != t_stored[i] && !fingerprint::same_content(*dc, *t_stored[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+void block_store::dedupe(renderers::Page *t_page)
+{
+  const auto &dcs = t_page->dcs;
+  std::size_t begin = 0;
+  while (begin < dcs.size())
+  {
+    auto end = begin + 1;
+    while (end < dcs.size() && dcs[end]->clip_id == dcs[begin]->clip_id)
+    {
+      ++end;
+    }
+    if (end - begin >= min_block_size)
+    {
+      m_dedupe_run(t_page, begin, end);
+    }
+    begin = end;
+  }
+}
+
+void block_store::m_dedupe_run(renderers::Page *t_page, std::size_t t_begin,
+                               std::size_t t_end)
+{
+  auto &dcs = t_page->dcs;
+  std::vector<fingerprint::fingerprint_t> hashes(t_end - t_begin);
+  auto key = fingerprint::seed;
+  for (auto i = t_begin; i < t_end; ++i)
+  {
+    hashes[i - t_begin] = fingerprint::draw_call(*dcs[i]);
+    key = fingerprint::combine(key, hashes[i - t_begin]);
+  }
+
+  auto it = m_blocks.find(key);
+  if (it != m_blocks.end())
+  {
+    if (auto stored = it->second.lock())
+    {
+      if (stored->hashes == hashes && same_draw_calls(stored->dcs, dcs, t_begin))
+      {
+        for (auto i = t_begin; i < t_end; ++i)
+        {
+          const auto *dc = stored->dcs[i - t_begin].get();
+          if (dcs[i].get() != dc)
+          {
+            dcs[i] = std::shared_ptr<const renderers::DrawCall>(stored, dc);
+            m_deduplicated++;
+          }
+        }
+      }
+      return;
+    }
+  }
+
+  // The page references the new block, so it lives as long as one of its pages
+  auto created = std::make_shared<block>();
+  created->dcs.assign(dcs.begin() + t_begin, dcs.begin() + t_end);
+  created->hashes = std::move(hashes);
+  for (auto i = t_begin; i < t_end; ++i)
+  {
+    dcs[i] = std::shared_ptr<const renderers::DrawCall>(
+        created, created->dcs[i - t_begin].get());
+  }
+  m_blocks[key] = created;
+
+  if (m_blocks.size() >= m_prune_at)
+  {
+    m_prune();
+  }
+}
+
+void block_store::m_prune()
+{
+  for (auto it = m_blocks.begin(); it != m_blocks.end();)
+  {
+    if (it->second.expired())
+    {
+      it = m_blocks.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  m_prune_at = std::max<std::size_t>(1024, m_blocks.size() * 2);
+}
+
+void block_store::clear()
+{
+  m_blocks.clear();
+  m_prune_at = 1024;
+}
+
+block_store::stats block_store::get_stats() const
+{
+  stats res;
+  res.deduplicated = m_deduplicated;
+  for (const auto &b : m_blocks)
+  {
+    if (!b.second.expired())
+    {
+      res.blocks++;
+    }
+  }
+  return res;
+}
+
+}  // namespace unigd
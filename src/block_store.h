@@ -0,0 +1,52 @@
+#ifndef __UNIGD_BLOCK_STORE_H__
+#define __UNIGD_BLOCK_STORE_H__
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "draw_data.h"
+#include "fingerprint.h"
+
+// Do not include any R headers here!
+
+namespace unigd
+{
+// Content addressed store of draw call blocks. A block is a run of draw calls between
+// clip changes. Pages that repeat a block (animation frames, facets, small multiples)
+// reference the draw calls of the first page instead of keeping their own copy.
+class block_store
+{
+ public:
+  struct stats
+  {
+    // Stored blocks that are still referenced
+    std::size_t blocks = 0;
+    // Draw calls replaced by a reference to a stored block so far
+    std::size_t deduplicated = 0;
+  };
+
+  // Replace the blocks of a complete page by stored ones and store new blocks.
+  void dedupe(renderers::Page *t_page);
+  void clear();
+  stats get_stats() const;
+
+ private:
+  struct block
+  {
+    std::vector<std::shared_ptr<const renderers::DrawCall>> dcs;
+    std::vector<fingerprint::fingerprint_t> hashes;
+  };
+
+  // Blocks are owned by the pages that reference them
+  std::unordered_map<fingerprint::fingerprint_t, std::weak_ptr<const block>> m_blocks;
+  std::size_t m_prune_at = 1024;
+  std::size_t m_deduplicated = 0;
+
+  void m_dedupe_run(renderers::Page *t_page, std::size_t t_begin, std::size_t t_end);
+  void m_prune();
+};
+
+}  // namespace unigd
+
+#endif /* __UNIGD_BLOCK_STORE_H__ */
@@ -2,6 +2,7 @@
 
 #include <zlib.h>
 
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,65 @@ namespace unigd
 {
 namespace compr
 {
+namespace
+{
+// Vocabulary shared by SVG and JSON renderer output. zlib prefers matches
+// closer to the end of the window, so the most frequent strings go last.
+const std::string preset_dictionary =
+    R""(<?xml version="1.0" encoding="UTF-8"?>)""
+    R""(<svg xmlns="http://www.w3.org/2000/svg" xmlns:xlink="http://www.w3.org/1999/xlink" class="httpgd" )""
+    R""(width="" height="" viewBox="0 0 ">)""
+    "\n<defs>\n"
+    "  <style type='text/css'><![CDATA[\n"
+    "    .httpgd line, .httpgd polyline, .httpgd polygon, .httpgd path, "
+    ".httpgd rect, .httpgd circle {\n"
+    "      fill: none;\n"
+    "      stroke: #000000;\n"
+    "      stroke-linecap: round;\n"
+    "      stroke-linejoin: round;\n"
+    "      stroke-miterlimit: 10.00;\n"
+    "    }\n"
+    "  ]]></style>\n"
+    R""(<rect width="100%" height="100%" style="stroke: none;fill: #FFFFFF;"/>)""
+    "\n"
+    R""(<rect width="100%" height="100%" stroke="none" fill="#FFFFFF"/>)""
+    "\n"
+    R""(<image width="" height="" preserveAspectRatio="none" xlink:href="data:image/png;base64,)""
+    R""(font-family: Arial;font-size: 12.00px;font-weight: bold;font-style: italic;)""
+    R""(text-anchor="middle" text-anchor="end" transform="translate(,) rotate(-90)")""
+    R""({ "id": "", "w": , "h": , "scale": 1.00, "fill": "#FFFFFF",)""
+    "\n \"clips\": [\n  "
+    "\n ],\n \"draw_calls\": [\n  "
+    R""("type": "raster", "raster": { "w": , "h": , "data": "" })""
+    R""("type": "path", "nper": [], "points": )""
+    R""("type": "polygon", "clip_id": , "fill": "#000000", "line": )""
+    R""("type": "circle", "clip_id": , "x": , "y": , "r": , "fill": "#000000", "line": )""
+    R""("type": "text", "clip_id": , "x": , "y": , "rot": 0.00, "hadj": 0.50, "col": "#000000", "str": "", )""
+    R""("weight": 400, "features": "", "font_family": "Arial", "fontsize": 12.00, "italic": false, "txtwidth_px": )""
+    R""("type": "polyline", "clip_id": , "line": , "points": [ [ , ], [ , ] ])""
+    R""("type": "line", "clip_id": , "x0": , "y0": , "x1": , "y1": , "line": )""
+    R""("type": "rect", "clip_id": , "x": , "y": , "w": , "h": , "line": )""
+    R""({ "col": "#000000", "lwd": 1.00, "lty": 0, "lend": 1, "ljoin": 1, "lmitre": 10.00 } },)""
+    "\n  "
+    R""(<clipPath id="c"><rect x="0.00" y="0.00" width="" height=""/></clipPath>)""
+    "\n</defs>\n"
+    R""(</g><g clip-path="url(#c)">)""
+    "\n"
+    R""(<path d="M L Z" fill-rule: evenodd;fill-rule: nonzero;)""
+    R""(<polygon points="" stroke-dasharray: stroke-linecap: butt;stroke-linejoin: miter;)""
+    R""(<g><text x="" y="" style="fill-opacity: 0.50;stroke-opacity: 0.50;stroke: none;"/></g>)""
+    R""(<polyline points="" style="stroke-width: 0.75;stroke: #000000;"/>)""
+    "\n"
+    R""(<circle cx="" cy="" r="" style="stroke-width: 0.75;fill: #000000;"/>)""
+    "\n"
+    R""(<rect x="" y="" width="" height="" style="stroke-width: 0.75;"/>)""
+    "\n"
+    R""(<line x1="" y1="" x2="" y2="" style="stroke-width: 0.75;"/>)""
+    "\n"
+    R""(<line x1="" y1="" x2="" y2="" stroke-width="0.75" stroke="#000000"/>)""
+    "\n</g>\n</svg>";
+}  // namespace
+
 template <typename charTypeIn, typename charTypeOut>
 inline std::vector<charTypeOut> compressToGzip(const charTypeIn *input, size_t inputSize)
 {
@@ -66,6 +126,112 @@ std::vector<unsigned char> compress_str(const std::string &s)
   return compressToGzip<char, unsigned char>(s.c_str(), s.size());
 }
 
+std::vector<uint8_t> compress_dict(const uint8_t *input, size_t input_size)
+{
+  if (input_size > std::numeric_limits<uInt>::max())
+  {
+    return {};
+  }
+  z_stream zs;
+  zs.zalloc = Z_NULL;
+  zs.zfree = Z_NULL;
+  zs.opaque = Z_NULL;
+  zs.avail_in = static_cast<uInt>(input_size);
+  zs.next_in = const_cast<Bytef *>(input);
+
+  // negative window bits: raw deflate without zlib header
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK)
+  {
+    return {};
+  }
+  if (deflateSetDictionary(&zs, reinterpret_cast<const Bytef *>(preset_dictionary.data()),
+                           static_cast<uInt>(preset_dictionary.size())) != Z_OK)
+  {
+    deflateEnd(&zs);
+    return {};
+  }
+
+  std::vector<uint8_t> buffer(deflateBound(&zs, static_cast<uLong>(input_size)));
+  zs.avail_out = static_cast<uInt>(buffer.size());
+  zs.next_out = buffer.data();
+  const int ret = deflate(&zs, Z_FINISH);
+  deflateEnd(&zs);
+  if (ret != Z_STREAM_END)
+  {
+    return {};
+  }
+  buffer.resize(zs.total_out);
+  return buffer;
+}
+
+const std::string &dictionary() { return preset_dictionary; }
+
+std::vector<uint8_t> compress_raw(const uint8_t *input, size_t input_size, int level)
+{
+  if (input_size > std::numeric_limits<uInt>::max())
+  {
+    return {};
+  }
+  z_stream zs;
+  zs.zalloc = Z_NULL;
+  zs.zfree = Z_NULL;
+  zs.opaque = Z_NULL;
+  zs.avail_in = static_cast<uInt>(input_size);
+  zs.next_in = const_cast<Bytef *>(input);
+
+  if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return {};
+  }
+  std::vector<uint8_t> buffer(deflateBound(&zs, static_cast<uLong>(input_size)));
+  zs.avail_out = static_cast<uInt>(buffer.size());
+  zs.next_out = buffer.data();
+  const int ret = deflate(&zs, Z_FINISH);
+  deflateEnd(&zs);
+  if (ret != Z_STREAM_END)
+  {
+    return {};
+  }
+  buffer.resize(zs.total_out);
+  buffer.shrink_to_fit();
+  return buffer;
+}
+
+bool decompress_raw(const uint8_t *input, size_t input_size, uint8_t *output,
+                    size_t output_size)
+{
+  if (input_size > std::numeric_limits<uInt>::max() ||
+      output_size > std::numeric_limits<uInt>::max())
+  {
+    return false;
+  }
+  z_stream zs;
+  zs.zalloc = Z_NULL;
+  zs.zfree = Z_NULL;
+  zs.opaque = Z_NULL;
+  zs.avail_in = static_cast<uInt>(input_size);
+  zs.next_in = const_cast<Bytef *>(input);
+
+  if (inflateInit2(&zs, -15) != Z_OK)
+  {
+    return false;
+  }
+  zs.avail_out = static_cast<uInt>(output_size);
+  zs.next_out = output;
+  const int ret = inflate(&zs, Z_FINISH);
+  inflateEnd(&zs);
+  return ret == Z_STREAM_END && zs.total_out == output_size;
+}
+
+uint32_t dictionary_id()
+{
+  static const uint32_t id = static_cast<uint32_t>(
+      adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(preset_dictionary.data()),
+              static_cast<uInt>(preset_dictionary.size())));
+  return id;
+}
+
 }  // namespace compr
 
 }  // namespace unigd
@@ -13,6 +13,22 @@ std::vector<uint8_t> compress(const uint8_t *input, size_t input_size);
 
 std::vector<unsigned char> compress_str(const std::string &s);
 
+// Raw deflate (RFC 1951) primed with a preset dictionary of common renderer
+// output. Decoders need to call inflateSetDictionary() with dictionary().
+std::vector<uint8_t> compress_dict(const uint8_t *input, size_t input_size);
+
+const std::string &dictionary();
+
+// Raw deflate for data that is kept in memory, empty on failure.
+std::vector<uint8_t> compress_raw(const uint8_t *input, size_t input_size, int level);
+
+// Inflate raw deflate data. The decompressed size has to be known.
+bool decompress_raw(const uint8_t *input, size_t input_size, uint8_t *output,
+                    size_t output_size);
+
+// Adler-32 checksum of dictionary() (same as the zlib DICTID).
+uint32_t dictionary_id();
+
 }  // namespace compr
 }  // namespace unigd
 
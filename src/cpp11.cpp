@@ -6,10 +6,17 @@
 #include <R_ext/Visibility.h>
 
 // unigd.cpp
-int unigd_ugd_(std::string bg, double width, double height, double pointsize, cpp11::list aliases, bool reset_par);
-extern "C" SEXP _unigd_unigd_ugd_(SEXP bg, SEXP width, SEXP height, SEXP pointsize, SEXP aliases, SEXP reset_par) {
+int unigd_ugd_(std::string bg, double width, double height, double pointsize, cpp11::list aliases, bool reset_par, bool history, std::string store_file);
+extern "C" SEXP _unigd_unigd_ugd_(SEXP bg, SEXP width, SEXP height, SEXP pointsize, SEXP aliases, SEXP reset_par, SEXP history, SEXP store_file) {
   BEGIN_CPP11
-    return cpp11::as_sexp(unigd_ugd_(cpp11::as_cpp<cpp11::decay_t<std::string>>(bg), cpp11::as_cpp<cpp11::decay_t<double>>(width), cpp11::as_cpp<cpp11::decay_t<double>>(height), cpp11::as_cpp<cpp11::decay_t<double>>(pointsize), cpp11::as_cpp<cpp11::decay_t<cpp11::list>>(aliases), cpp11::as_cpp<cpp11::decay_t<bool>>(reset_par)));
+    return cpp11::as_sexp(unigd_ugd_(cpp11::as_cpp<cpp11::decay_t<std::string>>(bg), cpp11::as_cpp<cpp11::decay_t<double>>(width), cpp11::as_cpp<cpp11::decay_t<double>>(height), cpp11::as_cpp<cpp11::decay_t<double>>(pointsize), cpp11::as_cpp<cpp11::decay_t<cpp11::list>>(aliases), cpp11::as_cpp<cpp11::decay_t<bool>>(reset_par), cpp11::as_cpp<cpp11::decay_t<bool>>(history), cpp11::as_cpp<cpp11::decay_t<std::string>>(store_file)));
+  END_CPP11
+}
+// unigd.cpp
+int unigd_ugd_inline_(std::string bg, double width, double height, double pointsize, cpp11::list aliases, bool reset_par, bool history, std::string key);
+extern "C" SEXP _unigd_unigd_ugd_inline_(SEXP bg, SEXP width, SEXP height, SEXP pointsize, SEXP aliases, SEXP reset_par, SEXP history, SEXP key) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(unigd_ugd_inline_(cpp11::as_cpp<cpp11::decay_t<std::string>>(bg), cpp11::as_cpp<cpp11::decay_t<double>>(width), cpp11::as_cpp<cpp11::decay_t<double>>(height), cpp11::as_cpp<cpp11::decay_t<double>>(pointsize), cpp11::as_cpp<cpp11::decay_t<cpp11::list>>(aliases), cpp11::as_cpp<cpp11::decay_t<bool>>(reset_par), cpp11::as_cpp<cpp11::decay_t<bool>>(history), cpp11::as_cpp<cpp11::decay_t<std::string>>(key)));
   END_CPP11
 }
 // unigd.cpp
@@ -48,6 +55,13 @@ extern "C" SEXP _unigd_unigd_render_(SEXP devnum, SEXP page, SEXP width, SEXP he
   END_CPP11
 }
 // unigd.cpp
+bool unigd_save_(int devnum, int page, double width, double height, double zoom, std::string renderer_id, std::string file);
+extern "C" SEXP _unigd_unigd_save_(SEXP devnum, SEXP page, SEXP width, SEXP height, SEXP zoom, SEXP renderer_id, SEXP file) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(unigd_save_(cpp11::as_cpp<cpp11::decay_t<int>>(devnum), cpp11::as_cpp<cpp11::decay_t<int>>(page), cpp11::as_cpp<cpp11::decay_t<double>>(width), cpp11::as_cpp<cpp11::decay_t<double>>(height), cpp11::as_cpp<cpp11::decay_t<double>>(zoom), cpp11::as_cpp<cpp11::decay_t<std::string>>(renderer_id), cpp11::as_cpp<cpp11::decay_t<std::string>>(file)));
+  END_CPP11
+}
+// unigd.cpp
 bool unigd_remove_(int devnum, int page);
 extern "C" SEXP _unigd_unigd_remove_(SEXP devnum, SEXP page) {
   BEGIN_CPP11
@@ -69,6 +83,34 @@ extern "C" SEXP _unigd_unigd_id_(SEXP devnum, SEXP page, SEXP limit) {
   END_CPP11
 }
 // unigd.cpp
+cpp11::writable::data_frame unigd_plots_(int devnum, int page, int limit);
+extern "C" SEXP _unigd_unigd_plots_(SEXP devnum, SEXP page, SEXP limit) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(unigd_plots_(cpp11::as_cpp<cpp11::decay_t<int>>(devnum), cpp11::as_cpp<cpp11::decay_t<int>>(page), cpp11::as_cpp<cpp11::decay_t<int>>(limit)));
+  END_CPP11
+}
+// unigd.cpp
+cpp11::writable::data_frame unigd_search_(int devnum, std::string query, int limit);
+extern "C" SEXP _unigd_unigd_search_(SEXP devnum, SEXP query, SEXP limit) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(unigd_search_(cpp11::as_cpp<cpp11::decay_t<int>>(devnum), cpp11::as_cpp<cpp11::decay_t<std::string>>(query), cpp11::as_cpp<cpp11::decay_t<int>>(limit)));
+  END_CPP11
+}
+// unigd.cpp
+cpp11::writable::list unigd_render_patch_(int devnum, int page, int since, double zoom, std::string renderer_id);
+extern "C" SEXP _unigd_unigd_render_patch_(SEXP devnum, SEXP page, SEXP since, SEXP zoom, SEXP renderer_id) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(unigd_render_patch_(cpp11::as_cpp<cpp11::decay_t<int>>(devnum), cpp11::as_cpp<cpp11::decay_t<int>>(page), cpp11::as_cpp<cpp11::decay_t<int>>(since), cpp11::as_cpp<cpp11::decay_t<double>>(zoom), cpp11::as_cpp<cpp11::decay_t<std::string>>(renderer_id)));
+  END_CPP11
+}
+// unigd.cpp
+cpp11::writable::raws unigd_render_document_(int devnum, int from, int to, double width, double height, double zoom, std::string renderer_id);
+extern "C" SEXP _unigd_unigd_render_document_(SEXP devnum, SEXP from, SEXP to, SEXP width, SEXP height, SEXP zoom, SEXP renderer_id) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(unigd_render_document_(cpp11::as_cpp<cpp11::decay_t<int>>(devnum), cpp11::as_cpp<cpp11::decay_t<int>>(from), cpp11::as_cpp<cpp11::decay_t<int>>(to), cpp11::as_cpp<cpp11::decay_t<double>>(width), cpp11::as_cpp<cpp11::decay_t<double>>(height), cpp11::as_cpp<cpp11::decay_t<double>>(zoom), cpp11::as_cpp<cpp11::decay_t<std::string>>(renderer_id)));
+  END_CPP11
+}
+// unigd.cpp
 bool unigd_clear_(int devnum);
 extern "C" SEXP _unigd_unigd_clear_(SEXP devnum) {
   BEGIN_CPP11
@@ -94,18 +136,24 @@ extern "C" SEXP _unigd_unigd_ipc_close_() {
 
 extern "C" {
 static const R_CallMethodDef CallEntries[] = {
-    {"_unigd_unigd_clear_",     (DL_FUNC) &_unigd_unigd_clear_,     1},
-    {"_unigd_unigd_id_",        (DL_FUNC) &_unigd_unigd_id_,        3},
-    {"_unigd_unigd_info_",      (DL_FUNC) &_unigd_unigd_info_,      1},
-    {"_unigd_unigd_ipc_close_", (DL_FUNC) &_unigd_unigd_ipc_close_, 0},
-    {"_unigd_unigd_ipc_open_",  (DL_FUNC) &_unigd_unigd_ipc_open_,  0},
-    {"_unigd_unigd_plot_find_", (DL_FUNC) &_unigd_unigd_plot_find_, 2},
-    {"_unigd_unigd_remove_",    (DL_FUNC) &_unigd_unigd_remove_,    2},
-    {"_unigd_unigd_remove_id_", (DL_FUNC) &_unigd_unigd_remove_id_, 2},
-    {"_unigd_unigd_render_",    (DL_FUNC) &_unigd_unigd_render_,    6},
-    {"_unigd_unigd_renderers_", (DL_FUNC) &_unigd_unigd_renderers_, 0},
-    {"_unigd_unigd_state_",     (DL_FUNC) &_unigd_unigd_state_,     1},
-    {"_unigd_unigd_ugd_",       (DL_FUNC) &_unigd_unigd_ugd_,       6},
+    {"_unigd_unigd_clear_",           (DL_FUNC) &_unigd_unigd_clear_,           1},
+    {"_unigd_unigd_id_",              (DL_FUNC) &_unigd_unigd_id_,              3},
+    {"_unigd_unigd_info_",            (DL_FUNC) &_unigd_unigd_info_,            1},
+    {"_unigd_unigd_ipc_close_",       (DL_FUNC) &_unigd_unigd_ipc_close_,       0},
+    {"_unigd_unigd_ipc_open_",        (DL_FUNC) &_unigd_unigd_ipc_open_,        0},
+    {"_unigd_unigd_plot_find_",       (DL_FUNC) &_unigd_unigd_plot_find_,       2},
+    {"_unigd_unigd_plots_",           (DL_FUNC) &_unigd_unigd_plots_,           3},
+    {"_unigd_unigd_remove_",          (DL_FUNC) &_unigd_unigd_remove_,          2},
+    {"_unigd_unigd_remove_id_",       (DL_FUNC) &_unigd_unigd_remove_id_,       2},
+    {"_unigd_unigd_render_",          (DL_FUNC) &_unigd_unigd_render_,          6},
+    {"_unigd_unigd_render_document_", (DL_FUNC) &_unigd_unigd_render_document_, 7},
+    {"_unigd_unigd_render_patch_",    (DL_FUNC) &_unigd_unigd_render_patch_,    5},
+    {"_unigd_unigd_renderers_",       (DL_FUNC) &_unigd_unigd_renderers_,       0},
+    {"_unigd_unigd_save_",            (DL_FUNC) &_unigd_unigd_save_,            7},
+    {"_unigd_unigd_search_",          (DL_FUNC) &_unigd_unigd_search_,          3},
+    {"_unigd_unigd_state_",           (DL_FUNC) &_unigd_unigd_state_,           1},
+    {"_unigd_unigd_ugd_",             (DL_FUNC) &_unigd_unigd_ugd_,             8},
+    {"_unigd_unigd_ugd_inline_",      (DL_FUNC) &_unigd_unigd_ugd_inline_,      8},
     {NULL, NULL, 0}
 };
 }
@@ -0,0 +1,71 @@
+#include "device_pool.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace unigd
+{
+namespace device_pool
+{
+namespace
+{
+// Upper bound of pooled devices (open and closed)
+const std::size_t max_devices = 4;
+
+struct entry
+{
+  std::string key;
+  std::shared_ptr<unigd_device> device;
+};
+
+std::vector<entry> pool;
+
+int create(const std::shared_ptr<unigd_device> &t_device)
+{
+  try
+  {
+    return t_device->create("unigd");
+  }
+  catch (...)
+  {
+    // Device was never added, make it available again
+    t_device->release();
+    throw;
+  }
+}
+}  // namespace
+
+int open(const std::string &t_key, const device_params &t_params)
+{
+  for (auto &e : pool)
+  {
+    if (e.key == t_key && !e.device->is_open())
+    {
+      e.device->reopen();
+      return create(e.device);
+    }
+  }
+
+  auto dev = std::make_shared<unigd_device>(t_params);
+  if (pool.size() < max_devices)
+  {
+    pool.push_back({t_key, dev});
+  }
+  else
+  {
+    // Replace a closed device with other parameters
+    for (auto &e : pool)
+    {
+      if (!e.device->is_open())
+      {
+        e = {t_key, dev};
+        break;
+      }
+    }
+  }
+  return create(dev);
+}
+
+}  // namespace device_pool
+}  // namespace unigd
@@ -0,0 +1,21 @@
+#ifndef __UNIGD_DEVICE_POOL_H__
+#define __UNIGD_DEVICE_POOL_H__
+
+#include <string>
+
+#include "unigd_dev.h"
+
+namespace unigd
+{
+// Closed devices kept around for reuse by the inline render functions. Devices are
+// matched by a key that has to cover all device parameters. Must be called from the R
+// main thread.
+namespace device_pool
+{
+// Opens a device from the pool (or creates one) and returns its device number.
+int open(const std::string &t_key, const device_params &t_params);
+
+}  // namespace device_pool
+}  // namespace unigd
+
+#endif /* __UNIGD_DEVICE_POOL_H__ */
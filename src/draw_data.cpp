@@ -1,46 +1,221 @@
 #include "draw_data.h"
 
-#include <iterator>
+#include <cmath>
+#include <utility>
+
+#include "unigd_commons.h"
 
 namespace unigd
 {
 namespace renderers
 {
+namespace
+{
+class stats_visitor : public draw_call_visitor
+{
+ public:
+  explicit stats_visitor(PageStats *t_stats) : m_stats(t_stats) {}
+
+  void visit(const Rect *t_rect) override { shape(4); }
+  void visit(const Text *t_text) override
+  {
+    m_stats->texts++;
+    m_stats->text_chars += t_text->str.size();
+  }
+  void visit(const Circle *t_circle) override { shape(1); }
+  void visit(const Line *t_line) override { shape(2); }
+  void visit(const Polyline *t_polyline) override { shape(t_polyline->points.size()); }
+  void visit(const Polygon *t_polygon) override { shape(t_polygon->points.size()); }
+  void visit(const Path *t_path) override { shape(t_path->points.size()); }
+  void visit(const Raster *t_raster) override
+  {
+    m_stats->rasters++;
+    m_stats->raster_bytes += t_raster->raster.size() * sizeof(unsigned int);
+  }
+
+ private:
+  PageStats *m_stats;
+
+  void shape(std::size_t t_vertices)
+  {
+    m_stats->shapes++;
+    m_stats->vertices += t_vertices;
+  }
+};
+
+constexpr double MATH_PI{3.14159265358979323846};
+// Maximum number of damage log entries per page
+constexpr std::size_t damage_log_size{64};
+// Extra margin for anti-aliasing
+constexpr double damage_margin{1.0};
+
+class bounds_visitor : public draw_call_visitor
+{
+ public:
+  void visit(const Rect *t_rect) override
+  {
+    const auto &r = t_rect->rect;
+    add(r.x, r.y);
+    add(r.x + r.width, r.y + r.height);
+    pad(stroke(t_rect->line));
+  }
+  void visit(const Text *t_text) override
+  {
+    // Glyphs may be wider than the measured string width
+    const double fs = t_text->text.fontsize;
+    const double w = t_text->text.txtwidth_px * 1.1 + fs;
+    const double x0 = -w * t_text->hadj - fs * 0.5;
+    add_rotated(t_text->pos, t_text->rot, x0, -fs * 1.2, x0 + w, fs * 0.5);
+    pad(0);
+  }
+  void visit(const Circle *t_circle) override
+  {
+    const double r = std::max(t_circle->radius, 0.5);
+    add(t_circle->pos.x - r, t_circle->pos.y - r);
+    add(t_circle->pos.x + r, t_circle->pos.y + r);
+    pad(stroke(t_circle->line));
+  }
+  void visit(const Line *t_line) override
+  {
+    add(t_line->orig.x, t_line->orig.y);
+    add(t_line->dest.x, t_line->dest.y);
+    pad(stroke(t_line->line));
+  }
+  void visit(const Polyline *t_polyline) override
+  {
+    add(t_polyline->points);
+    pad(stroke(t_polyline->line));
+  }
+  void visit(const Polygon *t_polygon) override
+  {
+    add(t_polygon->points);
+    pad(stroke(t_polygon->line));
+  }
+  void visit(const Path *t_path) override
+  {
+    add(t_path->points);
+    pad(stroke(t_path->line));
+  }
+  void visit(const Raster *t_raster) override
+  {
+    const auto &r = t_raster->rect;
+    add_rotated({r.x, r.y}, t_raster->rot, 0, 0, r.width, r.height);
+    pad(0);
+  }
+
+  grect<double> rect() const
+  {
+    if (m_x0 > m_x1 || m_y0 > m_y1)
+    {
+      return {0, 0, 0, 0};
+    }
+    return {m_x0, m_y0, m_x1 - m_x0, m_y1 - m_y0};
+  }
+
+ private:
+  double m_x0 = HUGE_VAL, m_y0 = HUGE_VAL, m_x1 = -HUGE_VAL, m_y1 = -HUGE_VAL;
+
+  // Half the stroke width, with room for caps and mitre joins
+  static double stroke(const LineInfo &t_line)
+  {
+    const double lwd = std::max(t_line.lwd, 1.0) / 96.0 * 72;
+    const double join =
+        t_line.ljoin == LineInfo::GC_MITRE_JOIN ? std::max(t_line.lmitre, 1.0) : 1.5;
+    return lwd * join / 2;
+  }
+
+  void add(double t_x, double t_y)
+  {
+    m_x0 = std::min(m_x0, t_x);
+    m_y0 = std::min(m_y0, t_y);
+    m_x1 = std::max(m_x1, t_x);
+    m_y1 = std::max(m_y1, t_y);
+  }
+  void add(const std::vector<gvertex<double>> &t_points)
+  {
+    for (const auto &p : t_points)
+    {
+      add(p.x, p.y);
+    }
+  }
+  // Rectangle relative to t_origin, rotated like the cairo renderer does
+  void add_rotated(gvertex<double> t_origin, double t_rot, double t_x0, double t_y0,
+                   double t_x1, double t_y1)
+  {
+    const double a = -t_rot / 180.0 * MATH_PI;
+    const double c = std::cos(a);
+    const double s = std::sin(a);
+    for (const auto &p : {gvertex<double>{t_x0, t_y0}, gvertex<double>{t_x1, t_y0},
+                          gvertex<double>{t_x0, t_y1}, gvertex<double>{t_x1, t_y1}})
+    {
+      add(t_origin.x + p.x * c - p.y * s, t_origin.y + p.x * s + p.y * c);
+    }
+  }
+  void pad(double t_pad)
+  {
+    t_pad += damage_margin;
+    m_x0 -= t_pad;
+    m_y0 -= t_pad;
+    m_x1 += t_pad;
+    m_y1 += t_pad;
+  }
+};
+}  // namespace
+
+grect<double> bounds(const DrawCall &t_dc)
+{
+  bounds_visitor bv;
+  t_dc.visit(&bv);
+  return bv.rect();
+}
 
 Text::Text(color_t t_col, gvertex<double> t_pos, std::string &&t_str, double t_rot,
            double t_hadj, TextInfo &&t_text)
-    : col(t_col), pos(t_pos), rot(t_rot), hadj(t_hadj), str(t_str), text(t_text)
+    : col(t_col),
+      pos(t_pos),
+      rot(t_rot),
+      hadj(t_hadj),
+      str(std::move(t_str)),
+      text(std::move(t_text))
 {
 }
 Circle::Circle(LineInfo &&t_line, color_t t_fill, gvertex<double> t_pos, double t_radius)
-    : line(t_line), fill(t_fill), pos(t_pos), radius(t_radius)
+    : line(std::move(t_line)), fill(t_fill), pos(t_pos), radius(t_radius)
 {
 }
 Line::Line(LineInfo &&t_line, gvertex<double> t_orig, gvertex<double> t_dest)
-    : line(t_line), orig(t_orig), dest(t_dest)
+    : line(std::move(t_line)), orig(t_orig), dest(t_dest)
 {
 }
 Rect::Rect(LineInfo &&t_line, color_t t_fill, grect<double> t_rect)
-    : line(t_line), fill(t_fill), rect(t_rect)
+    : line(std::move(t_line)), fill(t_fill), rect(t_rect)
 {
 }
 Polyline::Polyline(LineInfo &&t_line, std::vector<gvertex<double>> &&t_points)
-    : line(t_line), points(t_points)
+    : line(std::move(t_line)), points(std::move(t_points))
 {
 }
 Polygon::Polygon(LineInfo &&t_line, color_t t_fill,
                  std::vector<gvertex<double>> &&t_points)
-    : line(t_line), fill(t_fill), points(t_points)
+    : line(std::move(t_line)), fill(t_fill), points(std::move(t_points))
 {
 }
 Path::Path(LineInfo &&t_line, color_t t_fill, std::vector<gvertex<double>> &&t_points,
            std::vector<int> &&t_nper, bool t_winding)
-    : line(t_line), fill(t_fill), points(t_points), nper(t_nper), winding(t_winding)
+    : line(std::move(t_line)),
+      fill(t_fill),
+      points(std::move(t_points)),
+      nper(std::move(t_nper)),
+      winding(t_winding)
 {
 }
 Raster::Raster(std::vector<unsigned int> &&t_raster, gvertex<int> t_wh,
                grect<double> t_rect, double t_rot, bool t_interpolate)
-    : raster(t_raster), wh(t_wh), rect(t_rect), rot(t_rot), interpolate(t_interpolate)
+    : raster(std::move(t_raster)),
+      wh(t_wh),
+      rect(t_rect),
+      rot(t_rot),
+      interpolate(t_interpolate)
 {
 }
 
@@ -67,22 +242,85 @@ Page::Page(page_id_t t_id, gvertex<double> t_size) : id(t_id), size(t_size), dcs
 void Page::put(std::unique_ptr<DrawCall> &&t_dc)
 {
   t_dc->clip_id = cps.back().id;
+  content_hash = fingerprint::combine(content_hash, fingerprint::draw_call(*t_dc));
+  stats_visitor sv(&stats);
+  t_dc->visit(&sv);
+  stats.draw_calls++;
+  const auto damaged = rect_intersect(bounds(*t_dc), cps.back().rect);
   dcs.emplace_back(std::move(t_dc));
+  version = incwrap(version);
+  m_add_damage(damaged);
 }
 void Page::put(std::vector<std::unique_ptr<DrawCall>> &&t_dcs)
 {
+  stats_visitor sv(&stats);
+  grect<double> damaged{0, 0, 0, 0};
   for (auto &cp : t_dcs)
   {
     cp->clip_id = cps.back().id;
+    content_hash = fingerprint::combine(content_hash, fingerprint::draw_call(*cp));
+    cp->visit(&sv);
+    stats.draw_calls++;
+    damaged = rect_union(damaged, rect_intersect(bounds(*cp), cps.back().rect));
   }
-  dcs.insert(dcs.end(), std::make_move_iterator(t_dcs.begin()),
-             std::make_move_iterator(t_dcs.end()));
+  // One owner for the whole batch instead of a control block per draw call
+  const auto owner =
+      std::make_shared<std::vector<std::unique_ptr<DrawCall>>>(std::move(t_dcs));
+  dcs.reserve(dcs.size() + owner->size());
+  for (const auto &dc : *owner)
+  {
+    dcs.emplace_back(owner, dc.get());
+  }
+  version = incwrap(version);
+  m_add_damage(damaged);
 }
 void Page::clear()
 {
   dcs.clear();
   cps.clear();
+  content_hash = fingerprint::seed;
+  stats = PageStats{};
   clip({0, 0, size.x, size.y});
+  version = incwrap(version);
+  damage_all();
+}
+void Page::damage_all()
+{
+  m_damage.clear();
+  m_damage_base = version;
+}
+bool Page::damage(page_version_t t_since, grect<double> *t_rect) const
+{
+  // Distances to the current version, so wrapped versions compare correctly
+  const auto age = [&](page_version_t v) { return page_version_t(version - v); };
+  if (age(t_since) > age(m_damage_base))
+  {
+    return false;
+  }
+  grect<double> damaged{0, 0, 0, 0};
+  for (const auto &d : m_damage)
+  {
+    if (age(d.version) < age(t_since))
+    {
+      damaged = rect_union(damaged, d.rect);
+    }
+  }
+  *t_rect = damaged;
+  return true;
+}
+void Page::m_add_damage(grect<double> t_rect)
+{
+  if (rect_empty(t_rect))
+  {
+    return;
+  }
+  if (m_damage.size() == damage_log_size)
+  {
+    // Clients older than the merged entry get the union of both
+    m_damage[1].rect = rect_union(m_damage[0].rect, m_damage[1].rect);
+    m_damage.erase(m_damage.begin());
+  }
+  m_damage.push_back({version, t_rect});
 }
 void Page::clip(grect<double> t_rect)
 {
@@ -90,6 +328,10 @@ void Page::clip(grect<double> t_rect)
   if (cps_count == 0 || !cps.back().equals(t_rect))
   {
     cps.emplace_back(Clip{(int)cps_count, t_rect});
+    stats.clips++;
+    content_hash = fingerprint::combine(content_hash, cps.back().id);
+    content_hash = fingerprint::combine(content_hash, t_rect);
+    version = incwrap(version);
   }
 }
 
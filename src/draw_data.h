@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "fingerprint.h"
 #include "geom.h"
 
 // Do not include any R headers here !
@@ -56,6 +57,7 @@ constexpr double alpha_frac(color_t x) { return byte_frac(alpha(x)); }
 
 using clip_id_t = int;
 using page_id_t = uint32_t;
+using page_version_t = uint32_t;
 
 // Data
 
@@ -235,6 +237,10 @@ class Raster : public DrawCall
   bool interpolate;
 };
 
+// Area a draw call can change, in page coordinates. Conservative: line widths and
+// text extents are overestimated.
+grect<double> bounds(const DrawCall &t_dc);
+
 class Clip
 {
  public:
@@ -247,6 +253,19 @@ class Clip
   grect<double> rect;
 };
 
+// Running totals of the draw calls of a page, used for render cost estimates.
+struct PageStats
+{
+  std::size_t draw_calls = 0;
+  std::size_t clips = 0;
+  std::size_t shapes = 0;    // draw calls except text and raster
+  std::size_t vertices = 0;  // points of all shapes
+  std::size_t texts = 0;
+  std::size_t text_chars = 0;
+  std::size_t rasters = 0;
+  std::size_t raster_bytes = 0;
+};
+
 class Page
 {
  public:
@@ -263,13 +282,43 @@ class Page
   void put(std::vector<std::unique_ptr<DrawCall>> &&t_dcs);
   void clear();
   void clip(grect<double> t_rect);
+  // The whole page changed (e.g. the background fill)
+  void damage_all();
+  // Union of the areas changed after version t_since, empty if nothing changed.
+  // Returns false if the whole page changed or t_since is unknown.
+  bool damage(page_version_t t_since, grect<double> *t_rect) const;
 
   page_id_t id;
   gvertex<double> size;
   color_t fill;
-
-  std::vector<std::unique_ptr<DrawCall>> dcs;
+  // Incremented every time the page content changes
+  page_version_t version = 0;
+  // Incrementally updated hash of the draw calls and clip regions
+  fingerprint::fingerprint_t content_hash = fingerprint::seed;
+  PageStats stats;
+  // Seconds since epoch, 0 if never rendered (written by the page store)
+  double last_render = 0;
+  // Sequence number in the page file, 0 if not stored
+  uint64_t stored_seq = 0;
+  // Restored from the page file, draw calls are only loaded for rendering
+  bool restored = false;
+
+  // Draw calls can be shared with other pages (see block_store.h)
+  std::vector<std::shared_ptr<const DrawCall>> dcs;
   std::vector<Clip> cps;
+
+ private:
+  struct damage_entry
+  {
+    page_version_t version;
+    grect<double> rect;
+  };
+  // Changed areas by version, the oldest entries are merged when the log is full
+  std::vector<damage_entry> m_damage;
+  // Version of the last change of the whole page
+  page_version_t m_damage_base = 0;
+
+  void m_add_damage(grect<double> t_rect);
 };
 
 }  // namespace renderers
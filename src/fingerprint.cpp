@@ -0,0 +1,281 @@
+#include "fingerprint.h"
+
+#include <cstring>
+
+#include "draw_data.h"
+
+namespace unigd
+{
+namespace fingerprint
+{
+namespace
+{
+// MurmurHash3 finalizer: every input bit affects every output bit, so differences in
+// the high bits of a word (e.g. sign bits of doubles) do not cancel out later.
+inline uint64_t avalanche(uint64_t t_word)
+{
+  t_word ^= t_word >> 33;
+  t_word *= 0xff51afd7ed558ccdULL;
+  t_word ^= t_word >> 33;
+  t_word *= 0xc4ceb9fe1a85ec53ULL;
+  t_word ^= t_word >> 33;
+  return t_word;
+}
+
+inline fingerprint_t mix(fingerprint_t t_hash, uint64_t t_word)
+{
+  return avalanche(t_hash ^ t_word);
+}
+
+inline fingerprint_t combine_lineinfo(fingerprint_t t_hash,
+                                      const renderers::LineInfo &t_line)
+{
+  t_hash = combine(t_hash, t_line.col);
+  t_hash = combine(t_hash, t_line.lwd);
+  t_hash = combine(t_hash, t_line.lty);
+  t_hash = combine(t_hash, t_line.lend);
+  t_hash = combine(t_hash, t_line.ljoin);
+  return combine(t_hash, t_line.lmitre);
+}
+
+class hash_visitor : public renderers::draw_call_visitor
+{
+ public:
+  explicit hash_visitor(fingerprint_t t_hash) : hash(t_hash) {}
+
+  void visit(const renderers::Rect *t_rect) override
+  {
+    hash = combine(hash, 'R');
+    hash = combine_lineinfo(hash, t_rect->line);
+    hash = combine(hash, t_rect->fill);
+    hash = combine(hash, t_rect->rect);
+  }
+  void visit(const renderers::Text *t_text) override
+  {
+    hash = combine(hash, 'T');
+    hash = combine(hash, t_text->col);
+    hash = combine(hash, t_text->pos);
+    hash = combine(hash, t_text->rot);
+    hash = combine(hash, t_text->hadj);
+    hash = combine(hash, t_text->str);
+    hash = combine(hash, t_text->text.weight);
+    hash = combine(hash, t_text->text.features);
+    hash = combine(hash, t_text->text.font_family);
+    hash = combine(hash, t_text->text.fontsize);
+    hash = combine(hash, t_text->text.italic);
+    hash = combine(hash, t_text->text.txtwidth_px);
+  }
+  void visit(const renderers::Circle *t_circle) override
+  {
+    hash = combine(hash, 'C');
+    hash = combine_lineinfo(hash, t_circle->line);
+    hash = combine(hash, t_circle->fill);
+    hash = combine(hash, t_circle->pos);
+    hash = combine(hash, t_circle->radius);
+  }
+  void visit(const renderers::Line *t_line) override
+  {
+    hash = combine(hash, 'L');
+    hash = combine_lineinfo(hash, t_line->line);
+    hash = combine(hash, t_line->orig);
+    hash = combine(hash, t_line->dest);
+  }
+  void visit(const renderers::Polyline *t_polyline) override
+  {
+    hash = combine(hash, 'l');
+    hash = combine_lineinfo(hash, t_polyline->line);
+    hash = combine(hash, t_polyline->points);
+  }
+  void visit(const renderers::Polygon *t_polygon) override
+  {
+    hash = combine(hash, 'P');
+    hash = combine_lineinfo(hash, t_polygon->line);
+    hash = combine(hash, t_polygon->fill);
+    hash = combine(hash, t_polygon->points);
+  }
+  void visit(const renderers::Path *t_path) override
+  {
+    hash = combine(hash, 'p');
+    hash = combine_lineinfo(hash, t_path->line);
+    hash = combine(hash, t_path->fill);
+    hash = combine(hash, t_path->points);
+    hash = combine(hash, t_path->nper);
+    hash = combine(hash, t_path->winding);
+  }
+  void visit(const renderers::Raster *t_raster) override
+  {
+    hash = combine(hash, 'r');
+    hash = combine(hash, t_raster->raster);
+    hash = combine(hash, t_raster->wh);
+    hash = combine(hash, t_raster->rect);
+    hash = combine(hash, t_raster->rot);
+    hash = combine(hash, t_raster->interpolate);
+  }
+
+  fingerprint_t hash;
+};
+
+template <typename T>
+inline bool same(const T &t_lhs, const T &t_rhs)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "value not trivially copyable");
+  return std::memcmp(&t_lhs, &t_rhs, sizeof(T)) == 0;
+}
+
+inline bool same(const std::string &t_lhs, const std::string &t_rhs)
+{
+  return t_lhs == t_rhs;
+}
+
+template <typename T>
+inline bool same(const std::vector<T> &t_lhs, const std::vector<T> &t_rhs)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "value not trivially copyable");
+  return t_lhs.size() == t_rhs.size() &&
+         std::memcmp(t_lhs.data(), t_rhs.data(), t_lhs.size() * sizeof(T)) == 0;
+}
+
+// Field by field, LineInfo has padding
+inline bool same_lineinfo(const renderers::LineInfo &t_lhs,
+                          const renderers::LineInfo &t_rhs)
+{
+  return same(t_lhs.col, t_rhs.col) && same(t_lhs.lwd, t_rhs.lwd) &&
+         same(t_lhs.lty, t_rhs.lty) && same(t_lhs.lend, t_rhs.lend) &&
+         same(t_lhs.ljoin, t_rhs.ljoin) && same(t_lhs.lmitre, t_rhs.lmitre);
+}
+
+// The visited draw call as its concrete type, the other pointers stay null
+class type_visitor : public renderers::draw_call_visitor
+{
+ public:
+  void visit(const renderers::Rect *t_rect) override { rect = t_rect; }
+  void visit(const renderers::Text *t_text) override { text = t_text; }
+  void visit(const renderers::Circle *t_circle) override { circle = t_circle; }
+  void visit(const renderers::Line *t_line) override { line = t_line; }
+  void visit(const renderers::Polyline *t_polyline) override { polyline = t_polyline; }
+  void visit(const renderers::Polygon *t_polygon) override { polygon = t_polygon; }
+  void visit(const renderers::Path *t_path) override { path = t_path; }
+  void visit(const renderers::Raster *t_raster) override { raster = t_raster; }
+
+  const renderers::Rect *rect{nullptr};
+  const renderers::Text *text{nullptr};
+  const renderers::Circle *circle{nullptr};
+  const renderers::Line *line{nullptr};
+  const renderers::Polyline *polyline{nullptr};
+  const renderers::Polygon *polygon{nullptr};
+  const renderers::Path *path{nullptr};
+  const renderers::Raster *raster{nullptr};
+};
+
+class equal_visitor : public renderers::draw_call_visitor
+{
+ public:
+  explicit equal_visitor(const renderers::DrawCall &t_other) { t_other.visit(&m_other); }
+
+  void visit(const renderers::Rect *t_rect) override
+  {
+    const auto *o = m_other.rect;
+    equal = o && same_lineinfo(t_rect->line, o->line) && same(t_rect->fill, o->fill) &&
+            same(t_rect->rect, o->rect);
+  }
+  void visit(const renderers::Text *t_text) override
+  {
+    const auto *o = m_other.text;
+    equal = o && same(t_text->col, o->col) && same(t_text->pos, o->pos) &&
+            same(t_text->rot, o->rot) && same(t_text->hadj, o->hadj) &&
+            same(t_text->str, o->str) && same(t_text->text.weight, o->text.weight) &&
+            same(t_text->text.features, o->text.features) &&
+            same(t_text->text.font_family, o->text.font_family) &&
+            same(t_text->text.fontsize, o->text.fontsize) &&
+            same(t_text->text.italic, o->text.italic) &&
+            same(t_text->text.txtwidth_px, o->text.txtwidth_px);
+  }
+  void visit(const renderers::Circle *t_circle) override
+  {
+    const auto *o = m_other.circle;
+    equal = o && same_lineinfo(t_circle->line, o->line) &&
+            same(t_circle->fill, o->fill) && same(t_circle->pos, o->pos) &&
+            same(t_circle->radius, o->radius);
+  }
+  void visit(const renderers::Line *t_line) override
+  {
+    const auto *o = m_other.line;
+    equal = o && same_lineinfo(t_line->line, o->line) && same(t_line->orig, o->orig) &&
+            same(t_line->dest, o->dest);
+  }
+  void visit(const renderers::Polyline *t_polyline) override
+  {
+    const auto *o = m_other.polyline;
+    equal = o && same_lineinfo(t_polyline->line, o->line) &&
+            same(t_polyline->points, o->points);
+  }
+  void visit(const renderers::Polygon *t_polygon) override
+  {
+    const auto *o = m_other.polygon;
+    equal = o && same_lineinfo(t_polygon->line, o->line) &&
+            same(t_polygon->fill, o->fill) && same(t_polygon->points, o->points);
+  }
+  void visit(const renderers::Path *t_path) override
+  {
+    const auto *o = m_other.path;
+    equal = o && same_lineinfo(t_path->line, o->line) && same(t_path->fill, o->fill) &&
+            same(t_path->points, o->points) && same(t_path->nper, o->nper) &&
+            same(t_path->winding, o->winding);
+  }
+  void visit(const renderers::Raster *t_raster) override
+  {
+    const auto *o = m_other.raster;
+    equal = o && same(t_raster->raster, o->raster) && same(t_raster->wh, o->wh) &&
+            same(t_raster->rect, o->rect) && same(t_raster->rot, o->rot) &&
+            same(t_raster->interpolate, o->interpolate);
+  }
+
+  bool equal{false};
+
+ private:
+  type_visitor m_other;
+};
+}  // namespace
+
+// Consumes 8 bytes at a time, so large vertex and raster buffers can be hashed at
+// record time without noticeable overhead.
+fingerprint_t combine(fingerprint_t t_hash, const void *t_data, size_t t_size)
+{
+  const auto *bytes = static_cast<const unsigned char *>(t_data);
+  while (t_size >= sizeof(uint64_t))
+  {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(uint64_t));
+    t_hash = mix(t_hash, word);
+    bytes += sizeof(uint64_t);
+    t_size -= sizeof(uint64_t);
+  }
+  while (t_size > 0)
+  {
+    t_hash = mix(t_hash, *bytes);
+    ++bytes;
+    --t_size;
+  }
+  return t_hash;
+}
+
+fingerprint_t draw_call(const renderers::DrawCall &t_dc)
+{
+  hash_visitor visitor(combine(seed, t_dc.clip_id));
+  t_dc.visit(&visitor);
+  return visitor.hash;
+}
+
+bool same_content(const renderers::DrawCall &t_lhs, const renderers::DrawCall &t_rhs)
+{
+  if (t_lhs.clip_id != t_rhs.clip_id)
+  {
+    return false;
+  }
+  equal_visitor visitor(t_rhs);
+  t_lhs.visit(&visitor);
+  return visitor.equal;
+}
+
+}  // namespace fingerprint
+}  // namespace unigd
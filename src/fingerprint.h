@@ -0,0 +1,57 @@
+#ifndef __UNIGD_FINGERPRINT_H__
+#define __UNIGD_FINGERPRINT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Do not include any R headers here!
+
+namespace unigd
+{
+namespace renderers
+{
+class DrawCall;
+}
+
+// Fast non-cryptographic content hashing used to detect identical plot output.
+namespace fingerprint
+{
+using fingerprint_t = uint64_t;
+
+constexpr fingerprint_t seed{0xcbf29ce484222325ULL};
+
+fingerprint_t combine(fingerprint_t t_hash, const void *t_data, size_t t_size);
+
+template <typename T>
+inline fingerprint_t combine(fingerprint_t t_hash, const T &t_value)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "value not trivially copyable");
+  return combine(t_hash, &t_value, sizeof(T));
+}
+
+inline fingerprint_t combine(fingerprint_t t_hash, const std::string &t_str)
+{
+  return combine(combine(t_hash, t_str.data(), t_str.size()), t_str.size());
+}
+
+template <typename T>
+inline fingerprint_t combine(fingerprint_t t_hash, const std::vector<T> &t_vec)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "value not trivially copyable");
+  return combine(combine(t_hash, t_vec.data(), t_vec.size() * sizeof(T)), t_vec.size());
+}
+
+// Hash of the full content of a draw call (including its clip ID).
+fingerprint_t draw_call(const renderers::DrawCall &t_dc);
+
+// Draw calls with the same content as hashed by draw_call(), values are compared
+// bitwise. Used to rule out hash collisions before content is shared.
+bool same_content(const renderers::DrawCall &t_lhs, const renderers::DrawCall &t_rhs);
+
+}  // namespace fingerprint
+}  // namespace unigd
+
+#endif /* __UNIGD_FINGERPRINT_H__ */
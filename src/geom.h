@@ -35,6 +35,46 @@ bool rect_equals(const grect<T> &r0, const grect<T> &r1, T eps)
          (std::fabs(r0.height - r1.height) < eps);
 }
 
+template <class T>
+bool rect_empty(const grect<T> &r)
+{
+  return r.width <= 0 || r.height <= 0;
+}
+
+// Smallest rect containing both, empty rects are ignored
+template <class T>
+grect<T> rect_union(const grect<T> &r0, const grect<T> &r1)
+{
+  if (rect_empty(r0))
+  {
+    return r1;
+  }
+  if (rect_empty(r1))
+  {
+    return r0;
+  }
+  const T x0 = std::min(r0.x, r1.x);
+  const T y0 = std::min(r0.y, r1.y);
+  const T x1 = std::max(r0.x + r0.width, r1.x + r1.width);
+  const T y1 = std::max(r0.y + r0.height, r1.y + r1.height);
+  return {x0, y0, x1 - x0, y1 - y0};
+}
+
+// Overlap of both rects, empty if they do not overlap
+template <class T>
+grect<T> rect_intersect(const grect<T> &r0, const grect<T> &r1)
+{
+  const T x0 = std::max(r0.x, r1.x);
+  const T y0 = std::max(r0.y, r1.y);
+  const T x1 = std::min(r0.x + r0.width, r1.x + r1.width);
+  const T y1 = std::min(r0.y + r0.height, r1.y + r1.height);
+  if (x1 <= x0 || y1 <= y0)
+  {
+    return {x0, y0, 0, 0};
+  }
+  return {x0, y0, x1 - x0, y1 - y0};
+}
+
 }  // namespace unigd
 
 #endif /* __UNIGD_GEOM_H__ */
@@ -0,0 +1,233 @@
+#include "output_sink.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace unigd
+{
+output_sink::output_sink(int t_fd) : m_mode(mode::fd), m_fd(t_fd) {}
+
+output_sink::output_sink(writer_fn t_writer, void *t_user)
+    : m_mode(mode::writer), m_writer(t_writer), m_user(t_user)
+{
+}
+
+output_sink::output_sink(reserve_fn t_reserve, void *t_user, size_t t_offset)
+    : m_mode(mode::external), m_reserve(t_reserve), m_user(t_user),
+      m_external_offset(t_offset)
+{
+}
+
+void output_sink::reserve(size_t t_size)
+{
+  if (m_mode == mode::memory)
+  {
+    m_buffer.reserve(t_size);
+  }
+  else if (m_mode == mode::external && m_ok)
+  {
+    m_ok = m_grow_external(t_size);
+  }
+}
+
+bool output_sink::m_grow_external(size_t t_size)
+{
+  const size_t required = m_external_offset + t_size;
+  if (required <= m_external_capacity)
+  {
+    return true;
+  }
+  const size_t capacity = std::max(required, m_external_capacity * 2);
+  m_external = m_reserve(m_user, capacity);
+  m_external_capacity = m_external ? capacity : 0;
+  return m_external != nullptr;
+}
+
+static bool write_fd(int t_fd, const uint8_t *t_data, size_t t_size)
+{
+  while (t_size > 0)
+  {
+#ifdef _WIN32
+    const auto chunk = static_cast<unsigned int>(std::min<size_t>(t_size, 1 << 30));
+    const auto n = ::_write(t_fd, t_data, chunk);
+#else
+    const auto n = ::write(t_fd, t_data, t_size);
+#endif
+    if (n <= 0)
+    {
+      return false;
+    }
+    t_data += n;
+    t_size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool output_sink::write(const uint8_t *t_data, size_t t_size)
+{
+  if (!m_ok)
+  {
+    return false;
+  }
+  switch (m_mode)
+  {
+    case mode::memory:
+    {
+      const auto required = m_buffer.size() + t_size;
+      if (required > m_buffer.capacity())
+      {
+        m_buffer.reserve(std::max(required, m_buffer.capacity() * 2));
+      }
+      m_buffer.insert(m_buffer.end(), t_data, t_data + t_size);
+      break;
+    }
+    case mode::external:
+      m_ok = m_grow_external(m_written + t_size);
+      if (m_ok)
+      {
+        std::memcpy(m_external + m_external_offset + m_written, t_data, t_size);
+      }
+      break;
+    case mode::fd:
+      m_ok = write_fd(m_fd, t_data, t_size);
+      break;
+    case mode::writer:
+      m_ok = m_writer(m_user, t_data, t_size);
+      break;
+  }
+  if (m_ok)
+  {
+    m_written += t_size;
+  }
+  return m_ok;
+}
+
+static bool patch_fd(int t_fd, size_t t_end, size_t t_offset, const uint8_t *t_data,
+                     size_t t_size)
+{
+#ifdef _WIN32
+  const auto pos = ::_lseeki64(t_fd, 0, SEEK_CUR);
+  if (pos < 0)
+  {
+    return false;
+  }
+  const auto start = pos - static_cast<__int64>(t_end);
+  const bool ok = ::_lseeki64(t_fd, start + t_offset, SEEK_SET) >= 0 &&
+                  write_fd(t_fd, t_data, t_size);
+  return ::_lseeki64(t_fd, pos, SEEK_SET) >= 0 && ok;
+#else
+  const auto pos = ::lseek(t_fd, 0, SEEK_CUR);
+  if (pos < 0)
+  {
+    return false;
+  }
+  auto at = pos - static_cast<off_t>(t_end) + static_cast<off_t>(t_offset);
+  while (t_size > 0)
+  {
+    const auto n = ::pwrite(t_fd, t_data, t_size, at);
+    if (n <= 0)
+    {
+      return false;
+    }
+    t_data += n;
+    t_size -= static_cast<size_t>(n);
+    at += n;
+  }
+  return true;
+#endif
+}
+
+bool output_sink::patch(size_t t_offset, const uint8_t *t_data, size_t t_size)
+{
+  if (!m_ok || t_offset + t_size > m_written)
+  {
+    return false;
+  }
+  switch (m_mode)
+  {
+    case mode::memory:
+      std::memcpy(m_buffer.data() + t_offset, t_data, t_size);
+      break;
+    case mode::external:
+      std::memcpy(m_external + m_external_offset + t_offset, t_data, t_size);
+      break;
+    case mode::fd:
+      m_ok = patch_fd(m_fd, m_written, t_offset, t_data, t_size);
+      break;
+    case mode::writer:
+      m_ok = false;
+      break;
+  }
+  return m_ok;
+}
+
+static bool truncate_fd(int t_fd, size_t t_drop)
+{
+#ifdef _WIN32
+  const auto end = ::_lseeki64(t_fd, 0, SEEK_CUR) - static_cast<__int64>(t_drop);
+  return end >= 0 && ::_chsize_s(t_fd, end) == 0 && ::_lseeki64(t_fd, end, SEEK_SET) >= 0;
+#else
+  const auto end = ::lseek(t_fd, 0, SEEK_CUR) - static_cast<off_t>(t_drop);
+  return end >= 0 && ::ftruncate(t_fd, end) == 0 && ::lseek(t_fd, end, SEEK_SET) >= 0;
+#endif
+}
+
+bool output_sink::truncate(size_t t_size)
+{
+  if (!m_ok || t_size > m_written)
+  {
+    return false;
+  }
+  switch (m_mode)
+  {
+    case mode::memory:
+      m_buffer.resize(t_size);
+      break;
+    case mode::external:
+      break;
+    case mode::fd:
+      m_ok = truncate_fd(m_fd, m_written - t_size);
+      break;
+    case mode::writer:
+      m_ok = false;
+      break;
+  }
+  if (m_ok)
+  {
+    m_written = t_size;
+  }
+  return m_ok;
+}
+
+void output_sink::fail() { m_ok = false; }
+
+bool output_sink::ok() const { return m_ok; }
+
+bool output_sink::is_memory() const
+{
+  return m_mode == mode::memory || m_mode == mode::external;
+}
+
+size_t output_sink::size() const { return m_written; }
+
+const uint8_t *output_sink::data() const
+{
+  switch (m_mode)
+  {
+    case mode::memory:
+      return m_buffer.data();
+    case mode::external:
+      return m_external ? m_external + m_external_offset : nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace unigd
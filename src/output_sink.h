@@ -0,0 +1,78 @@
+#ifndef __UNIGD_OUTPUT_SINK_H__
+#define __UNIGD_OUTPUT_SINK_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace unigd
+{
+// Destination for streamed renderer output. Either an in-memory buffer with
+// exponential growth, an external growable buffer (e.g. shared memory), a file
+// descriptor or a client supplied writer.
+// Bytes are copied at most once into the sink.
+class output_sink
+{
+ public:
+  using writer_fn = bool (*)(void *t_user, const uint8_t *t_data, uint64_t t_size);
+  // Grows an external buffer to at least t_capacity bytes, returns its base address
+  using reserve_fn = uint8_t *(*)(void *t_user, size_t t_capacity);
+
+  output_sink() = default;
+  explicit output_sink(int t_fd);
+  output_sink(writer_fn t_writer, void *t_user);
+  // Output starts at t_offset of the external buffer
+  output_sink(reserve_fn t_reserve, void *t_user, size_t t_offset);
+
+  output_sink(const output_sink &) = delete;
+  output_sink &operator=(const output_sink &) = delete;
+
+  // Size hint for in-memory sinks, has no effect on streaming sinks.
+  void reserve(size_t t_size);
+  bool write(const uint8_t *t_data, size_t t_size);
+  // Overwrite already written bytes. Not supported by writer sinks and file
+  // descriptors that are not seekable (e.g. pipes).
+  bool patch(size_t t_offset, const uint8_t *t_data, size_t t_size);
+  // Drop the output after the first t_size bytes. Writer sinks and file descriptors
+  // that are not seekable can not take output back, the sink fails instead.
+  bool truncate(size_t t_size);
+  // Mark the output as incomplete, e.g. when an encoder gave up half way. Later
+  // writes fail and ok() returns false.
+  void fail();
+
+  bool ok() const;
+  // Is the output accessible with data()
+  bool is_memory() const;
+  // Total number of bytes written
+  size_t size() const;
+  // Buffer of in-memory and external sinks (nullptr otherwise)
+  const uint8_t *data() const;
+
+ private:
+  enum class mode
+  {
+    memory,
+    external,
+    fd,
+    writer
+  };
+
+  mode m_mode{mode::memory};
+  int m_fd{-1};
+  writer_fn m_writer{nullptr};
+  reserve_fn m_reserve{nullptr};
+  void *m_user{nullptr};
+
+  uint8_t *m_external{nullptr};
+  size_t m_external_offset{0};
+  size_t m_external_capacity{0};
+  bool m_grow_external(size_t t_size);
+
+  std::vector<uint8_t> m_buffer;
+  size_t m_written{0};
+  bool m_ok{true};
+};
+
+}  // namespace unigd
+
+#endif /* __UNIGD_OUTPUT_SINK_H__ */
@@ -0,0 +1,647 @@
+#include "page_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Do not include any R headers here!
+
+namespace unigd
+{
+namespace
+{
+const char data_magic[8] = {'U', 'G', 'D', 'P', 'A', 'G', 'E', 'S'};
+const char index_magic[8] = {'U', 'G', 'D', 'I', 'N', 'D', 'E', 'X'};
+const uint32_t format_version = 2;
+// Files are only readable on machines with the same byte order
+const uint32_t byte_order_mark = 0x01020304;
+const std::size_t header_size = 16;
+
+const uint32_t entry_page = 1;
+const uint32_t entry_removed = 2;
+const std::size_t entry_size = 120;
+
+enum dc_type : uint8_t
+{
+  dc_rect = 1,
+  dc_text,
+  dc_circle,
+  dc_line,
+  dc_polyline,
+  dc_polygon,
+  dc_path,
+  dc_raster
+};
+
+class byte_writer
+{
+ public:
+  explicit byte_writer(std::vector<uint8_t> *t_out) : m_out(t_out) {}
+
+  template <typename T>
+  void put(const T &t_value)
+  {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&t_value);
+    m_out->insert(m_out->end(), bytes, bytes + sizeof(T));
+  }
+  void put(const std::string &t_str)
+  {
+    put(static_cast<uint32_t>(t_str.size()));
+    m_out->insert(m_out->end(), t_str.begin(), t_str.end());
+  }
+  template <typename T>
+  void put(const std::vector<T> &t_vec)
+  {
+    put(static_cast<uint32_t>(t_vec.size()));
+    const auto *bytes = reinterpret_cast<const uint8_t *>(t_vec.data());
+    m_out->insert(m_out->end(), bytes, bytes + t_vec.size() * sizeof(T));
+  }
+  void put(const renderers::LineInfo &t_line)
+  {
+    put(t_line.col);
+    put(t_line.lwd);
+    put(t_line.lty);
+    put(static_cast<int32_t>(t_line.lend));
+    put(static_cast<int32_t>(t_line.ljoin));
+    put(t_line.lmitre);
+  }
+
+ private:
+  std::vector<uint8_t> *m_out;
+};
+
+class byte_reader
+{
+ public:
+  byte_reader(const uint8_t *t_data, std::size_t t_size) : m_data(t_data), m_size(t_size)
+  {
+  }
+
+  bool ok() const { return m_ok; }
+
+  template <typename T>
+  T get()
+  {
+    T value{};
+    if (!m_take(sizeof(T)))
+    {
+      return value;
+    }
+    std::memcpy(&value, m_data + m_pos - sizeof(T), sizeof(T));
+    return value;
+  }
+  std::string get_string()
+  {
+    const auto n = get<uint32_t>();
+    if (!m_take(n))
+    {
+      return {};
+    }
+    return std::string(reinterpret_cast<const char *>(m_data + m_pos - n), n);
+  }
+  template <typename T>
+  std::vector<T> get_vector()
+  {
+    const auto n = get<uint32_t>();
+    if (n > (m_size - m_pos) / sizeof(T) || !m_take(n * sizeof(T)))
+    {
+      m_ok = false;
+      return {};
+    }
+    std::vector<T> vec(n);
+    std::memcpy(vec.data(), m_data + m_pos - n * sizeof(T), n * sizeof(T));
+    return vec;
+  }
+  renderers::LineInfo get_line()
+  {
+    renderers::LineInfo line;
+    line.col = get<color_t>();
+    line.lwd = get<double>();
+    line.lty = get<int>();
+    line.lend = static_cast<renderers::LineInfo::GC_lineend>(get<int32_t>());
+    line.ljoin = static_cast<renderers::LineInfo::GC_linejoin>(get<int32_t>());
+    line.lmitre = get<double>();
+    return line;
+  }
+
+ private:
+  const uint8_t *m_data;
+  std::size_t m_size;
+  std::size_t m_pos{0};
+  bool m_ok{true};
+
+  bool m_take(std::size_t t_n)
+  {
+    if (!m_ok || t_n > m_size - m_pos)
+    {
+      m_ok = false;
+      return false;
+    }
+    m_pos += t_n;
+    return true;
+  }
+};
+
+class encode_visitor : public renderers::draw_call_visitor
+{
+ public:
+  explicit encode_visitor(byte_writer *t_out) : m_out(t_out) {}
+
+  void visit(const renderers::Rect *t_rect) override
+  {
+    m_head(dc_rect, t_rect);
+    m_out->put(t_rect->line);
+    m_out->put(t_rect->fill);
+    m_out->put(t_rect->rect);
+  }
+  void visit(const renderers::Text *t_text) override
+  {
+    m_head(dc_text, t_text);
+    m_out->put(t_text->col);
+    m_out->put(t_text->pos);
+    m_out->put(t_text->rot);
+    m_out->put(t_text->hadj);
+    m_out->put(t_text->str);
+    m_out->put(t_text->text.weight);
+    m_out->put(t_text->text.features);
+    m_out->put(t_text->text.font_family);
+    m_out->put(t_text->text.fontsize);
+    m_out->put(static_cast<uint8_t>(t_text->text.italic));
+    m_out->put(t_text->text.txtwidth_px);
+  }
+  void visit(const renderers::Circle *t_circle) override
+  {
+    m_head(dc_circle, t_circle);
+    m_out->put(t_circle->line);
+    m_out->put(t_circle->fill);
+    m_out->put(t_circle->pos);
+    m_out->put(t_circle->radius);
+  }
+  void visit(const renderers::Line *t_line) override
+  {
+    m_head(dc_line, t_line);
+    m_out->put(t_line->line);
+    m_out->put(t_line->orig);
+    m_out->put(t_line->dest);
+  }
+  void visit(const renderers::Polyline *t_polyline) override
+  {
+    m_head(dc_polyline, t_polyline);
+    m_out->put(t_polyline->line);
+    m_out->put(t_polyline->points);
+  }
+  void visit(const renderers::Polygon *t_polygon) override
+  {
+    m_head(dc_polygon, t_polygon);
+    m_out->put(t_polygon->line);
+    m_out->put(t_polygon->fill);
+    m_out->put(t_polygon->points);
+  }
+  void visit(const renderers::Path *t_path) override
+  {
+    m_head(dc_path, t_path);
+    m_out->put(t_path->line);
+    m_out->put(t_path->fill);
+    m_out->put(t_path->points);
+    m_out->put(t_path->nper);
+    m_out->put(static_cast<uint8_t>(t_path->winding));
+  }
+  void visit(const renderers::Raster *t_raster) override
+  {
+    m_head(dc_raster, t_raster);
+    m_out->put(t_raster->raster);
+    m_out->put(t_raster->wh);
+    m_out->put(t_raster->rect);
+    m_out->put(t_raster->rot);
+    m_out->put(static_cast<uint8_t>(t_raster->interpolate));
+  }
+
+ private:
+  byte_writer *m_out;
+
+  void m_head(dc_type t_type, const renderers::DrawCall *t_dc)
+  {
+    m_out->put(t_type);
+    m_out->put(t_dc->clip_id);
+  }
+};
+
+std::vector<uint8_t> encode(const renderers::Page &t_page)
+{
+  std::vector<uint8_t> buf;
+  byte_writer out(&buf);
+  out.put(static_cast<uint32_t>(t_page.cps.size()));
+  for (const auto &cp : t_page.cps)
+  {
+    out.put(cp.id);
+    out.put(cp.rect);
+  }
+  out.put(static_cast<uint32_t>(t_page.dcs.size()));
+  encode_visitor visitor(&out);
+  for (const auto &dc : t_page.dcs)
+  {
+    dc->visit(&visitor);
+  }
+  return buf;
+}
+
+std::unique_ptr<renderers::DrawCall> decode_dc(byte_reader *t_in)
+{
+  using namespace renderers;
+  const auto type = t_in->get<uint8_t>();
+  const auto clip_id = t_in->get<clip_id_t>();
+  std::unique_ptr<DrawCall> dc;
+  switch (type)
+  {
+    case dc_rect:
+    {
+      auto line = t_in->get_line();
+      const auto fill = t_in->get<color_t>();
+      dc = std::make_unique<Rect>(std::move(line), fill, t_in->get<grect<double>>());
+      break;
+    }
+    case dc_text:
+    {
+      const auto col = t_in->get<color_t>();
+      const auto pos = t_in->get<gvertex<double>>();
+      const auto rot = t_in->get<double>();
+      const auto hadj = t_in->get<double>();
+      auto str = t_in->get_string();
+      TextInfo text;
+      text.weight = t_in->get<int>();
+      text.features = t_in->get_string();
+      text.font_family = t_in->get_string();
+      text.fontsize = t_in->get<double>();
+      text.italic = t_in->get<uint8_t>() != 0;
+      text.txtwidth_px = t_in->get<double>();
+      dc = std::make_unique<Text>(col, pos, std::move(str), rot, hadj, std::move(text));
+      break;
+    }
+    case dc_circle:
+    {
+      auto line = t_in->get_line();
+      const auto fill = t_in->get<color_t>();
+      const auto pos = t_in->get<gvertex<double>>();
+      dc = std::make_unique<Circle>(std::move(line), fill, pos, t_in->get<double>());
+      break;
+    }
+    case dc_line:
+    {
+      auto line = t_in->get_line();
+      const auto orig = t_in->get<gvertex<double>>();
+      dc = std::make_unique<Line>(std::move(line), orig, t_in->get<gvertex<double>>());
+      break;
+    }
+    case dc_polyline:
+    {
+      auto line = t_in->get_line();
+      dc = std::make_unique<Polyline>(std::move(line),
+                                      t_in->get_vector<gvertex<double>>());
+      break;
+    }
+    case dc_polygon:
+    {
+      auto line = t_in->get_line();
+      const auto fill = t_in->get<color_t>();
+      dc = std::make_unique<Polygon>(std::move(line), fill,
+                                     t_in->get_vector<gvertex<double>>());
+      break;
+    }
+    case dc_path:
+    {
+      auto line = t_in->get_line();
+      const auto fill = t_in->get<color_t>();
+      auto points = t_in->get_vector<gvertex<double>>();
+      auto nper = t_in->get_vector<int>();
+      const bool winding = t_in->get<uint8_t>() != 0;
+      dc = std::make_unique<Path>(std::move(line), fill, std::move(points),
+                                  std::move(nper), winding);
+      break;
+    }
+    case dc_raster:
+    {
+      auto raster = t_in->get_vector<unsigned int>();
+      const auto wh = t_in->get<gvertex<int>>();
+      const auto rect = t_in->get<grect<double>>();
+      const auto rot = t_in->get<double>();
+      const bool interpolate = t_in->get<uint8_t>() != 0;
+      dc = std::make_unique<Raster>(std::move(raster), wh, rect, rot, interpolate);
+      break;
+    }
+    default:
+      return nullptr;
+  }
+  dc->clip_id = clip_id;
+  return dc;
+}
+
+bool decode(const uint8_t *t_data, std::size_t t_size, renderers::Page *t_page)
+{
+  byte_reader in(t_data, t_size);
+  std::vector<renderers::Clip> cps(in.get<uint32_t>());
+  for (auto &cp : cps)
+  {
+    cp.id = in.get<renderers::clip_id_t>();
+    cp.rect = in.get<grect<double>>();
+  }
+  const auto dc_count = in.get<uint32_t>();
+  if (!in.ok())
+  {
+    return false;
+  }
+  std::vector<std::unique_ptr<renderers::DrawCall>> dcs;
+  dcs.reserve(dc_count);
+  for (uint32_t i = 0; i < dc_count; ++i)
+  {
+    auto dc = decode_dc(&in);
+    if (!dc || !in.ok())
+    {
+      return false;
+    }
+    dcs.emplace_back(std::move(dc));
+  }
+  t_page->cps = std::move(cps);
+  t_page->dcs.assign(std::make_move_iterator(dcs.begin()),
+                     std::make_move_iterator(dcs.end()));
+  return true;
+}
+
+bool write_header(std::FILE *t_file, const char *t_magic)
+{
+  return std::fwrite(t_magic, 1, 8, t_file) == 8 &&
+         std::fwrite(&format_version, sizeof(format_version), 1, t_file) == 1 &&
+         std::fwrite(&byte_order_mark, sizeof(byte_order_mark), 1, t_file) == 1 &&
+         std::fflush(t_file) == 0;
+}
+
+bool check_header(std::FILE *t_file, const char *t_magic)
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t bom;
+  return std::fread(magic, 1, 8, t_file) == 8 && std::memcmp(magic, t_magic, 8) == 0 &&
+         std::fread(&version, sizeof(version), 1, t_file) == 1 &&
+         version == format_version && std::fread(&bom, sizeof(bom), 1, t_file) == 1 &&
+         bom == byte_order_mark;
+}
+
+// Open an existing file or create a new one with a header
+std::FILE *open_file(const std::string &t_path, const char *t_magic)
+{
+  std::FILE *f = std::fopen(t_path.c_str(), "r+b");
+  if (f)
+  {
+    std::fseek(f, 0, SEEK_END);
+    if (std::ftell(f) > 0)
+    {
+      std::rewind(f);
+      if (!check_header(f, t_magic))
+      {
+        std::fclose(f);
+        return nullptr;
+      }
+      return f;
+    }
+    std::fclose(f);
+  }
+  f = std::fopen(t_path.c_str(), "w+b");
+  if (f && !write_header(f, t_magic))
+  {
+    std::fclose(f);
+    return nullptr;
+  }
+  return f;
+}
+}  // namespace
+
+// Read-only view of the page data that existed when the file was opened
+struct page_file::mapping
+{
+  const uint8_t *data{nullptr};
+  std::size_t size{0};
+#ifdef _WIN32
+  std::vector<uint8_t> buffer;
+#endif
+
+  bool map(const std::string &t_path, std::size_t t_size)
+  {
+    size = t_size;
+#ifndef _WIN32
+    const int fd = ::open(t_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return false;
+    }
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+      return false;
+    }
+    data = static_cast<const uint8_t *>(mapped);
+#else
+    // No memory mapping, read the file
+    std::FILE *f = std::fopen(t_path.c_str(), "rb");
+    if (!f)
+    {
+      return false;
+    }
+    buffer.resize(size);
+    const bool ok = std::fread(buffer.data(), 1, size, f) == size;
+    std::fclose(f);
+    data = buffer.data();
+    return ok;
+#endif
+    return true;
+  }
+
+  ~mapping()
+  {
+#ifndef _WIN32
+    if (data)
+    {
+      munmap(const_cast<uint8_t *>(data), size);
+    }
+#endif
+  }
+};
+
+page_file::page_file() = default;
+
+page_file::~page_file()
+{
+  if (m_data)
+  {
+    std::fclose(m_data);
+  }
+  if (m_index)
+  {
+    std::fclose(m_index);
+  }
+}
+
+bool page_file::open(const std::string &t_path, std::vector<stored_page> *t_pages)
+{
+  m_data = open_file(t_path, data_magic);
+  m_index = open_file(t_path + ".idx", index_magic);
+  if (!m_data || !m_index)
+  {
+    return false;
+  }
+  std::fseek(m_data, 0, SEEK_END);
+  m_data_size = static_cast<uint64_t>(std::ftell(m_data));
+
+  // Read all complete index entries, a torn entry at the end is overwritten
+  std::vector<stored_page> pages;
+  std::fseek(m_index, static_cast<long>(header_size), SEEK_SET);
+  uint8_t entry[entry_size];
+  long end = static_cast<long>(header_size);
+  while (std::fread(entry, 1, entry_size, m_index) == entry_size)
+  {
+    end += static_cast<long>(entry_size);
+    byte_reader in(entry, entry_size);
+    const auto kind = in.get<uint32_t>();
+    const auto fill = in.get<color_t>();
+    const auto seq = in.get<uint64_t>();
+    location loc;
+    loc.offset = in.get<uint64_t>();
+    loc.length = in.get<uint64_t>();
+    loc.checksum = in.get<fingerprint::fingerprint_t>();
+    const auto size = in.get<gvertex<double>>();
+    renderers::PageStats stats;
+    stats.draw_calls = in.get<uint64_t>();
+    stats.clips = in.get<uint64_t>();
+    stats.shapes = in.get<uint64_t>();
+    stats.vertices = in.get<uint64_t>();
+    stats.texts = in.get<uint64_t>();
+    stats.text_chars = in.get<uint64_t>();
+    stats.rasters = in.get<uint64_t>();
+    stats.raster_bytes = in.get<uint64_t>();
+
+    m_seq = std::max(m_seq, seq);
+    if (kind == entry_page && loc.offset >= header_size && loc.length <= m_data_size &&
+        loc.offset <= m_data_size - loc.length)
+    {
+      pages.push_back({seq, size, fill, loc.checksum, stats});
+      m_locations.emplace_back(seq, loc);
+    }
+    else if (kind == entry_removed)
+    {
+      pages.erase(std::remove_if(pages.begin(), pages.end(),
+                                 [&](const stored_page &p) { return p.seq == seq; }),
+                  pages.end());
+      m_locations.erase(
+          std::remove_if(m_locations.begin(), m_locations.end(),
+                         [&](const std::pair<uint64_t, location> &l)
+                         { return l.first == seq; }),
+          m_locations.end());
+    }
+  }
+  std::fseek(m_index, end, SEEK_SET);
+
+  if (!m_locations.empty())
+  {
+    m_mapping = std::make_unique<mapping>();
+    if (!m_mapping->map(t_path, static_cast<std::size_t>(m_data_size)))
+    {
+      m_mapping.reset();
+      m_locations.clear();
+      pages.clear();
+    }
+  }
+  *t_pages = std::move(pages);
+  return true;
+}
+
+uint64_t page_file::append(const renderers::Page &t_page)
+{
+  if (!m_data || !m_index)
+  {
+    return 0;
+  }
+  const auto payload = encode(t_page);
+  const location loc{m_data_size, payload.size(),
+                     fingerprint::combine(fingerprint::seed, payload.data(),
+                                          payload.size())};
+
+  std::fseek(m_data, 0, SEEK_END);
+  if (std::fwrite(payload.data(), 1, payload.size(), m_data) != payload.size() ||
+      std::fflush(m_data) != 0)
+  {
+    return 0;
+  }
+  m_data_size += payload.size();
+
+  const auto seq = m_seq + 1;
+  if (!write_index(entry_page, seq, loc, &t_page))
+  {
+    return 0;
+  }
+  m_seq = seq;
+  return seq;
+}
+
+void page_file::remove(uint64_t t_seq)
+{
+  if (!m_index)
+  {
+    return;
+  }
+  write_index(entry_removed, t_seq, {0, 0, 0}, nullptr);
+}
+
+bool page_file::load(uint64_t t_seq, renderers::Page *t_page) const
+{
+  const auto it =
+      std::lower_bound(m_locations.begin(), m_locations.end(), t_seq,
+                       [](const std::pair<uint64_t, location> &l, uint64_t seq)
+                       { return l.first < seq; });
+  if (!m_mapping || it == m_locations.end() || it->first != t_seq)
+  {
+    return false;
+  }
+  const auto &loc = it->second;
+  const auto *data = m_mapping->data + loc.offset;
+  if (fingerprint::combine(fingerprint::seed, data, loc.length) != loc.checksum)
+  {
+    return false;
+  }
+  return decode(data, loc.length, t_page);
+}
+
+bool page_file::write_index(uint32_t t_kind, uint64_t t_seq, const location &t_location,
+                            const renderers::Page *t_page)
+{
+  std::vector<uint8_t> entry;
+  entry.reserve(entry_size);
+  byte_writer out(&entry);
+  out.put(t_kind);
+  out.put(t_page ? t_page->fill : color_t{0});
+  out.put(t_seq);
+  out.put(t_location.offset);
+  out.put(t_location.length);
+  out.put(t_location.checksum);
+  out.put(t_page ? t_page->size : gvertex<double>{0, 0});
+  const auto stats = t_page ? t_page->stats : renderers::PageStats{};
+  out.put(static_cast<uint64_t>(stats.draw_calls));
+  out.put(static_cast<uint64_t>(stats.clips));
+  out.put(static_cast<uint64_t>(stats.shapes));
+  out.put(static_cast<uint64_t>(stats.vertices));
+  out.put(static_cast<uint64_t>(stats.texts));
+  out.put(static_cast<uint64_t>(stats.text_chars));
+  out.put(static_cast<uint64_t>(stats.rasters));
+  out.put(static_cast<uint64_t>(stats.raster_bytes));
+
+  return std::fwrite(entry.data(), 1, entry.size(), m_index) == entry.size() &&
+         std::fflush(m_index) == 0;
+}
+
+}  // namespace unigd
@@ -0,0 +1,71 @@
+#ifndef __UNIGD_PAGE_FILE_H__
+#define __UNIGD_PAGE_FILE_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "draw_data.h"
+
+namespace unigd
+{
+// Append-only file of serialized pages and an index file ("<path>.idx") that allow
+// restoring plots of previous sessions. Pages are decoded from a read-only mapping of
+// the file when they are needed.
+class page_file
+{
+ public:
+  // Index entry of a page, pages are identified by their sequence number
+  struct stored_page
+  {
+    uint64_t seq;
+    gvertex<double> size;
+    color_t fill;
+    fingerprint::fingerprint_t checksum;
+    renderers::PageStats stats;
+  };
+
+  page_file();
+  ~page_file();
+
+  page_file(const page_file &) = delete;
+  page_file &operator=(const page_file &) = delete;
+
+  // Open or create the files. Pages that have not been removed are written to
+  // t_pages.
+  bool open(const std::string &t_path, std::vector<stored_page> *t_pages);
+
+  // Append a page, returns its sequence number or 0 on failure
+  uint64_t append(const renderers::Page &t_page);
+  void remove(uint64_t t_seq);
+
+  // Decode a page that was stored before the file was opened. Draw calls and clip
+  // regions are restored, the other page fields are left untouched.
+  bool load(uint64_t t_seq, renderers::Page *t_page) const;
+
+ private:
+  struct mapping;
+  struct location
+  {
+    uint64_t offset;
+    uint64_t length;
+    fingerprint::fingerprint_t checksum;
+  };
+
+  std::FILE *m_data{nullptr};
+  std::FILE *m_index{nullptr};
+  uint64_t m_data_size{0};
+  uint64_t m_seq{0};
+  std::unique_ptr<mapping> m_mapping;
+  // Locations of the pages in the mapping by sequence number
+  std::vector<std::pair<uint64_t, location>> m_locations;
+
+  bool write_index(uint32_t t_kind, uint64_t t_seq, const location &t_location,
+                   const renderers::Page *t_page);
+};
+
+}  // namespace unigd
+
+#endif /* __UNIGD_PAGE_FILE_H__ */
@@ -1,8 +1,11 @@
 
 #include "page_store.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <unordered_map>
 
 #include "unigd_commons.h"
 
@@ -31,9 +34,17 @@ std::experimental::optional<ex::plot_relative_t> page_store::normalize_index(
   return m_index_to_pos(t_index);
 }
 
+page_store::~page_store() = default;
+
 ex::plot_index_t page_store::append(gvertex<double> t_size)
 {
   const std::unique_lock<std::shared_timed_mutex> w_lock(m_store_mutex);
+  // The previous page is complete
+  if (!m_pages.empty())
+  {
+    m_blocks.dedupe(&m_pages.back());
+    m_store_page(m_pages.back());
+  }
   m_pages.emplace_back(unigd::renderers::Page{m_id_counter, t_size});
 
   m_id_counter = incwrap(m_id_counter);
@@ -49,7 +60,9 @@ void page_store::add_dc(ex::plot_relative_t t_index,
     return;
   }
   auto index = m_index_to_pos(t_index);
-  m_pages[index].put(std::move(t_dc));
+  auto &page = m_pages[index];
+  page.put(std::move(t_dc));
+  m_text_index.add(page.id, page.dcs, page.dcs.size() - 1);
   if (!t_silent)
   {
     m_inc_upid();
@@ -67,7 +80,10 @@ void page_store::add_dc(ex::plot_relative_t t_index,
   }
   auto index = m_index_to_pos(t_index);
 
-  m_pages[index].put(std::move(t_dcs));
+  auto &page = m_pages[index];
+  const auto offset = page.dcs.size();
+  page.put(std::move(t_dcs));
+  m_text_index.add(page.id, page.dcs, offset);
   if (!t_silent)
   {
     m_inc_upid();
@@ -81,6 +97,7 @@ void page_store::clear(ex::plot_relative_t t_index, bool t_silent)
     return;
   }
   auto index = m_index_to_pos(t_index);
+  m_text_index.remove(m_pages[index].id);
   m_pages[index].clear();
   if (!t_silent)
   {
@@ -97,6 +114,11 @@ bool page_store::remove(ex::plot_relative_t t_index, bool t_silent)
   }
   auto index = m_index_to_pos(t_index);
 
+  if (m_file && m_pages[index].stored_seq != 0)
+  {
+    m_file->remove(m_pages[index].stored_seq);
+  }
+  m_text_index.remove(m_pages[index].id);
   m_pages.erase(m_pages.begin() + index);
   if (!t_silent)  // if it was the last page
   {
@@ -116,7 +138,19 @@ bool page_store::remove_all()
   {
     p.clear();
   }*/
+  if (m_file)
+  {
+    for (const auto &p : m_pages)
+    {
+      if (p.stored_seq != 0)
+      {
+        m_file->remove(p.stored_seq);
+      }
+    }
+  }
   m_pages.clear();
+  m_text_index.clear();
+  m_blocks.clear();
   m_inc_upid();
   return true;
 }
@@ -128,7 +162,12 @@ void page_store::fill(ex::plot_relative_t t_index, color_t t_fill)
     return;
   }
   auto index = m_index_to_pos(t_index);
-  m_pages[index].fill = t_fill;
+  if (m_pages[index].fill != t_fill)
+  {
+    m_pages[index].fill = t_fill;
+    m_pages[index].version = incwrap(m_pages[index].version);
+    m_pages[index].damage_all();
+  }
 }
 void page_store::resize(ex::plot_relative_t t_index, gvertex<double> t_size)
 {
@@ -138,7 +177,12 @@ void page_store::resize(ex::plot_relative_t t_index, gvertex<double> t_size)
     return;
   }
   auto index = m_index_to_pos(t_index);
+  if (m_pages[index].restored)
+  {
+    return;
+  }
   m_pages[index].size = t_size;
+  m_text_index.remove(m_pages[index].id);
   m_pages[index].clear();
 }
 unigd::gvertex<double> page_store::size(ex::plot_relative_t t_index)
@@ -162,6 +206,151 @@ void page_store::clip(ex::plot_relative_t t_index, grect<double> t_rect)
   m_pages[index].clip(t_rect);
 }
 
+namespace
+{
+// Every primitive becomes a draw call of about 100 bytes, larger batches are a client
+// error rather than a plot
+const uint64_t max_batch_size = uint64_t{1} << 24;
+
+bool valid_batch(const ex::primitive_batch &t_batch)
+{
+  if (t_batch.type < UNIGD_PRIMITIVE_CIRCLE || t_batch.type > UNIGD_PRIMITIVE_RECT ||
+      t_batch.size > max_batch_size)
+  {
+    return false;
+  }
+  if (t_batch.size == 0)
+  {
+    return true;
+  }
+  if (!t_batch.x0 || !t_batch.y0 || !t_batch.x1 ||
+      (!t_batch.y1 && t_batch.type != UNIGD_PRIMITIVE_CIRCLE))
+  {
+    return false;
+  }
+  if (!t_batch.styles || t_batch.styles_size == 0)
+  {
+    return false;
+  }
+  if (t_batch.style)
+  {
+    for (uint64_t i = 0; i < t_batch.size; ++i)
+    {
+      if (t_batch.style[i] >= t_batch.styles_size)
+      {
+        return false;
+      }
+    }
+  }
+  if ((t_batch.clip || t_batch.clips_size > 0) && !t_batch.clips)
+  {
+    return false;
+  }
+  if (t_batch.clip)
+  {
+    for (uint64_t i = 0; i < t_batch.size; ++i)
+    {
+      if (t_batch.clip[i] >= t_batch.clips_size)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<renderers::DrawCall> batch_draw_call(const ex::primitive_batch &t_batch,
+                                                     uint64_t t_i)
+{
+  const auto &style = t_batch.styles[t_batch.style ? t_batch.style[t_i] : 0];
+  renderers::LineInfo line{static_cast<color_t>(style.col),
+                           style.lwd,
+                           style.lty,
+                           renderers::LineInfo::GC_ROUND_CAP,
+                           renderers::LineInfo::GC_ROUND_JOIN,
+                           10.0};
+  const double x0 = t_batch.x0[t_i];
+  const double y0 = t_batch.y0[t_i];
+  const double x1 = t_batch.x1[t_i];
+  switch (t_batch.type)
+  {
+    case UNIGD_PRIMITIVE_CIRCLE:
+      return std::make_unique<renderers::Circle>(
+          std::move(line), static_cast<color_t>(style.fill), gvertex<double>{x0, y0}, x1);
+    case UNIGD_PRIMITIVE_LINE:
+      return std::make_unique<renderers::Line>(std::move(line), gvertex<double>{x0, y0},
+                                               gvertex<double>{x1, t_batch.y1[t_i]});
+    default:
+      return std::make_unique<renderers::Rect>(
+          std::move(line), static_cast<color_t>(style.fill),
+          normalize_rect(x0, y0, x1, t_batch.y1[t_i]));
+  }
+}
+
+grect<double> batch_clip(const ex::primitive_batch &t_batch, uint64_t t_i)
+{
+  const auto &c = t_batch.clips[t_batch.clip ? t_batch.clip[t_i] : 0];
+  return {c.x, c.y, c.width, c.height};
+}
+}  // namespace
+
+bool page_store::append_batch(ex::plot_relative_t t_index,
+                              const ex::primitive_batch &t_batch)
+{
+  if (!valid_batch(t_batch))
+  {
+    return false;
+  }
+  const std::unique_lock<std::shared_timed_mutex> w_lock(m_store_mutex);
+  if (!m_valid_index(t_index))
+  {
+    return false;
+  }
+  auto &page = m_pages[m_index_to_pos(t_index)];
+  if (page.restored)
+  {
+    return false;
+  }
+  if (t_batch.size == 0)
+  {
+    return true;
+  }
+
+  // Draw calls are added in one run per clipping region
+  const auto restore_clip = page.cps.back().rect;
+  const bool clipped = t_batch.clips_size > 0;
+  page.dcs.reserve(page.dcs.size() + t_batch.size);
+  std::vector<std::unique_ptr<renderers::DrawCall>> run;
+  run.reserve(t_batch.size);
+  for (uint64_t i = 0; i < t_batch.size; ++i)
+  {
+    if (clipped && (i == 0 || (t_batch.clip && t_batch.clip[i] != t_batch.clip[i - 1])))
+    {
+      if (!run.empty())
+      {
+        page.put(std::move(run));
+        run.clear();
+      }
+      page.clip(batch_clip(t_batch, i));
+    }
+    run.emplace_back(batch_draw_call(t_batch, i));
+  }
+  page.put(std::move(run));
+  if (clipped)
+  {
+    page.clip(restore_clip);
+  }
+  // Pages already written to the page file are written again with the primitives
+  if (m_file && page.stored_seq != 0)
+  {
+    m_file->remove(page.stored_seq);
+    page.stored_seq = 0;
+    m_store_page(page);
+  }
+  m_inc_upid();
+  return true;
+}
+
 bool page_store::render(ex::plot_relative_t t_index, renderers::render_target *t_renderer,
                         double t_scale)
 {
@@ -171,7 +360,14 @@ bool page_store::render(ex::plot_relative_t t_index, renderers::render_target *t
     return false;
   }
   auto index = m_index_to_pos(t_index);
-  t_renderer->render(m_pages[index], std::fabs(t_scale));
+  renderers::Page buffer{0, {0, 0}};
+  const auto *page = m_renderable(m_pages[index], &buffer);
+  if (!page)
+  {
+    return false;
+  }
+  t_renderer->render(*page, std::fabs(t_scale));
+  m_touch_render_time(m_pages[index]);
   return true;
 }
 
@@ -205,7 +401,155 @@ bool page_store::render_if_size(ex::plot_relative_t t_index,
     return false;
   }
 
-  t_renderer->render(m_pages[index], std::fabs(t_scale));
+  renderers::Page buffer{0, {0, 0}};
+  const auto *page = m_renderable(m_pages[index], &buffer);
+  if (!page)
+  {
+    return false;
+  }
+  t_renderer->render(*page, std::fabs(t_scale));
+  m_touch_render_time(m_pages[index]);
+  return true;
+}
+
+bool page_store::render_document(ex::plot_relative_t t_from, ex::plot_relative_t t_to,
+                                 renderers::document_target *t_renderer, double t_scale)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  if (!m_valid_index(t_from) || !m_valid_index(t_to))
+  {
+    return false;
+  }
+  const auto from = m_index_to_pos(t_from);
+  const auto to = m_index_to_pos(t_to);
+  if (from > to)
+  {
+    return false;
+  }
+  for (auto index = from; index <= to; ++index)
+  {
+    renderers::Page buffer{0, {0, 0}};
+    const auto *page = m_renderable(m_pages[index], &buffer);
+    if (!page)
+    {
+      return false;
+    }
+    t_renderer->add_page(*page, std::fabs(t_scale));
+    m_touch_render_time(m_pages[index]);
+  }
+  t_renderer->finish();
+  return true;
+}
+
+bool page_store::render_patch(ex::plot_relative_t t_index, ex::plot_version_t t_since,
+                              renderers::render_target *t_renderer, double t_scale,
+                              ex::render_patch *t_patch)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  if (!m_valid_index(t_index))
+  {
+    return false;
+  }
+  auto &stored = m_pages[m_index_to_pos(t_index)];
+  t_scale = std::fabs(t_scale);
+  // Truncated like the image size of the raster renderers
+  const int width = stored.size.x * t_scale;
+  const int height = stored.size.y * t_scale;
+
+  *t_patch = {stored.version, 0, 0, 0, 0, false};
+  grect<double> damaged;
+  if (stored.damage(t_since, &damaged))
+  {
+    const int x0 = std::max(0, static_cast<int>(std::floor(damaged.x * t_scale)));
+    const int y0 = std::max(0, static_cast<int>(std::floor(damaged.y * t_scale)));
+    const int x1 =
+        std::min(width, static_cast<int>(std::ceil((damaged.x + damaged.width) * t_scale)));
+    const int y1 = std::min(
+        height, static_cast<int>(std::ceil((damaged.y + damaged.height) * t_scale)));
+    if (rect_empty(damaged) || x1 <= x0 || y1 <= y0)
+    {
+      return true;
+    }
+    const grect<int> region{x0, y0, x1 - x0, y1 - y0};
+    if (t_renderer->set_region(region))
+    {
+      *t_patch = {stored.version,
+                  static_cast<uint32_t>(x0),
+                  static_cast<uint32_t>(y0),
+                  static_cast<uint32_t>(region.width),
+                  static_cast<uint32_t>(region.height),
+                  false};
+    }
+  }
+  if (t_patch->width == 0)
+  {
+    *t_patch = {stored.version, 0, 0, static_cast<uint32_t>(std::max(width, 0)),
+                static_cast<uint32_t>(std::max(height, 0)), true};
+  }
+
+  renderers::Page buffer{0, {0, 0}};
+  const auto *page = m_renderable(stored, &buffer);
+  if (!page)
+  {
+    return false;
+  }
+  t_renderer->render(*page, t_scale);
+  m_touch_render_time(stored);
+  return true;
+}
+
+bool page_store::fingerprint(ex::plot_relative_t t_index, const std::string &t_renderer_id,
+                             double t_scale, gvertex<double> t_target_size,
+                             fingerprint::fingerprint_t *t_fingerprint)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  if (!m_valid_index(t_index))
+  {
+    return false;
+  }
+  const auto &page = m_pages[m_index_to_pos(t_index)];
+
+  if (t_target_size.x < 0.1)
+  {
+    t_target_size.x = page.size.x;
+  }
+  if (t_target_size.y < 0.1)
+  {
+    t_target_size.y = page.size.y;
+  }
+
+  // Output at a different size is only known after a replay
+  if (std::fabs(t_target_size.x - page.size.x) > 0.1 ||
+      std::fabs(t_target_size.y - page.size.y) > 0.1)
+  {
+    return false;
+  }
+
+  // JSON and meta output contain the plot ID, so identical plots do not share output
+  auto hash = fingerprint::combine(page.content_hash, page.id);
+  hash = fingerprint::combine(hash, t_renderer_id);
+  hash = fingerprint::combine(hash, page.size);
+  hash = fingerprint::combine(hash, page.fill);
+  hash = fingerprint::combine(hash, std::fabs(t_scale));
+  if (m_extra_css)
+  {
+    hash = fingerprint::combine(hash, *m_extra_css);
+  }
+  *t_fingerprint = hash;
+  return true;
+}
+
+bool page_store::stats(ex::plot_relative_t t_index, renderers::PageStats *t_stats,
+                       gvertex<double> *t_size)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  if (!m_valid_index(t_index))
+  {
+    return false;
+  }
+  const auto &page = m_pages[m_index_to_pos(t_index)];
+  *t_stats = page.stats;
+  *t_size = page.size;
   return true;
 }
 
@@ -223,6 +567,92 @@ std::experimental::optional<ex::plot_index_t> page_store::find_index(ex::plot_id
 }
 
 void page_store::m_inc_upid() { m_upid = incwrap(m_upid); }
+
+void page_store::m_store_page(renderers::Page &t_page)
+{
+  if (m_file && !t_page.restored && t_page.stored_seq == 0)
+  {
+    t_page.stored_seq = m_file->append(t_page);
+  }
+}
+
+const renderers::Page *page_store::m_renderable(const renderers::Page &t_page,
+                                                renderers::Page *t_buffer)
+{
+  if (!t_page.restored)
+  {
+    return &t_page;
+  }
+  if (!m_file || !m_file->load(t_page.stored_seq, t_buffer))
+  {
+    return nullptr;
+  }
+  t_buffer->id = t_page.id;
+  t_buffer->size = t_page.size;
+  t_buffer->fill = t_page.fill;
+  t_buffer->version = t_page.version;
+  t_buffer->content_hash = t_page.content_hash;
+  t_buffer->stats = t_page.stats;
+  return t_buffer;
+}
+
+bool page_store::open_file(const std::string &t_path)
+{
+  const std::unique_lock<std::shared_timed_mutex> w_lock(m_store_mutex);
+  auto file = std::make_unique<page_file>();
+  std::vector<page_file::stored_page> stored;
+  if (!file->open(t_path, &stored))
+  {
+    return false;
+  }
+  for (const auto &s : stored)
+  {
+    renderers::Page page{m_id_counter, s.size};
+    m_id_counter = incwrap(m_id_counter);
+    page.fill = s.fill;
+    page.content_hash = s.checksum;
+    page.stats = s.stats;
+    page.stored_seq = s.seq;
+    page.restored = true;
+    m_pages.emplace_back(std::move(page));
+  }
+  m_file = std::move(file);
+  if (!stored.empty())
+  {
+    m_inc_upid();
+  }
+  return true;
+}
+
+void page_store::flush()
+{
+  const std::unique_lock<std::shared_timed_mutex> w_lock(m_store_mutex);
+  if (!m_pages.empty())
+  {
+    m_store_page(m_pages.back());
+  }
+}
+
+bool page_store::restored(ex::plot_relative_t t_index)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  return m_valid_index(t_index) && m_pages[m_index_to_pos(t_index)].restored;
+}
+
+block_store::stats page_store::block_stats()
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  return m_blocks.get_stats();
+}
+
+void page_store::m_touch_render_time(renderers::Page &t_page)
+{
+  const auto now = std::chrono::duration_cast<std::chrono::duration<double>>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  const std::lock_guard<std::mutex> t_lock(m_render_time_mutex);
+  t_page.last_render = now;
+}
 unigd_device_state page_store::state()
 {
   const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
@@ -241,7 +671,7 @@ ex::find_results page_store::query(ex::plot_relative_t t_offset, ex::plot_id_t t
 
   if (!m_valid_index(t_offset))
   {
-    return {{m_upid, static_cast<ex::plot_index_t>(m_pages.size()), m_device_active}, {}};
+    return {{m_upid, static_cast<ex::plot_index_t>(m_pages.size()), m_device_active}, {}, {}};
   }
   auto index = m_index_to_pos(t_offset);
   if (t_limit <= 0)
@@ -251,11 +681,86 @@ ex::find_results page_store::query(ex::plot_relative_t t_offset, ex::plot_id_t t
   auto end = std::min(m_pages.size(), index + static_cast<std::size_t>(t_limit));
 
   std::vector<ex::plot_id_t> res(end - index);
+  std::vector<ex::plot_version_t> versions(end - index);
   for (std::size_t i = index; i != end; i++)
   {
     res[i - index] = m_pages[i].id;
+    versions[i - index] = m_pages[i].version;
+  }
+  return {{m_upid, static_cast<ex::plot_index_t>(m_pages.size()), m_device_active},
+          res,
+          versions};
+}
+
+ex::plots_info_results page_store::info(ex::plot_relative_t t_offset,
+                                        ex::plot_index_t t_limit)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  const ex::device_state state{m_upid, static_cast<ex::plot_index_t>(m_pages.size()),
+                               m_device_active};
+
+  if (!m_valid_index(t_offset))
+  {
+    return {state, {}};
+  }
+  auto index = m_index_to_pos(t_offset);
+  if (t_limit <= 0)
+  {
+    t_limit = m_pages.size();
+  }
+  auto end = std::min(m_pages.size(), index + static_cast<std::size_t>(t_limit));
+
+  std::vector<ex::plot_info> res(end - index);
+  const std::lock_guard<std::mutex> t_lock(m_render_time_mutex);
+  for (std::size_t i = index; i != end; i++)
+  {
+    const auto &page = m_pages[i];
+    res[i - index] = {page.id,
+                      static_cast<ex::plot_index_t>(i),
+                      page.version,
+                      page.size.x,
+                      page.size.y,
+                      page.stats.draw_calls,
+                      page.stats.clips,
+                      page.stats.raster_bytes,
+                      page.last_render};
+  }
+  return {state, res};
+}
+
+ex::search_results page_store::search(const std::string &t_query,
+                                      ex::plot_index_t t_limit)
+{
+  const std::shared_lock<std::shared_timed_mutex> r_lock(m_store_mutex);
+  ex::search_results res{
+      {m_upid, static_cast<ex::plot_index_t>(m_pages.size()), m_device_active}, {}, {}};
+
+  auto found = m_text_index.search(t_query);
+  if (found.empty())
+  {
+    return res;
+  }
+  std::unordered_map<renderers::page_id_t, ex::plot_index_t> page_index;
+  for (std::size_t i = 0; i != m_pages.size(); i++)
+  {
+    page_index.emplace(m_pages[i].id, static_cast<ex::plot_index_t>(i));
+  }
+  std::stable_sort(found.begin(), found.end(),
+                   [&](const text_index::match &a, const text_index::match &b)
+                   { return page_index[a.page] < page_index[b.page]; });
+
+  const std::size_t n = t_limit > 0
+                            ? std::min(found.size(), static_cast<std::size_t>(t_limit))
+                            : found.size();
+  res.matches.reserve(n);
+  res.texts.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const auto &m = found[i];
+    res.matches.push_back({m.page, page_index[m.page], m.pos.x, m.pos.y, nullptr});
+    res.texts.push_back(std::move(found[i].str));
   }
-  return {{m_upid, static_cast<ex::plot_index_t>(m_pages.size()), m_device_active}, res};
+  return res;
 }
 
 void page_store::extra_css(std::experimental::optional<std::string> t_extra_css)
@@ -6,13 +6,17 @@
 #include <atomic>
 #include <compat/optional.hpp>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
 #include <vector>
 
+#include "block_store.h"
 #include "geom.h"
+#include "page_file.h"
 #include "renderers.h"
+#include "text_index.h"
 #include "unigd_external.h"
 
 namespace unigd
@@ -21,6 +25,7 @@ class page_store
 {
  public:
   page_store() = default;
+  ~page_store();
 
   page_store(const page_store &) = delete;
   page_store &operator=(page_store &) = delete;
@@ -37,6 +42,21 @@ class page_store
               double t_scale);
   bool render_if_size(ex::plot_relative_t t_index, renderers::render_target *t_renderer,
                       double t_scale, gvertex<double> t_target_size);
+  // Render all pages in [t_from, t_to] into a single document
+  bool render_document(ex::plot_relative_t t_from, ex::plot_relative_t t_to,
+                       renderers::document_target *t_renderer, double t_scale);
+  // Render the area changed after version t_since at the stored size. Nothing is
+  // rendered if the page did not change.
+  bool render_patch(ex::plot_relative_t t_index, ex::plot_version_t t_since,
+                    renderers::render_target *t_renderer, double t_scale,
+                    ex::render_patch *t_patch);
+  bool fingerprint(ex::plot_relative_t t_index, const std::string &t_renderer_id,
+                   double t_scale, gvertex<double> t_target_size,
+                   fingerprint::fingerprint_t *t_fingerprint);
+
+  // Draw call statistics and size of a page
+  bool stats(ex::plot_relative_t t_index, renderers::PageStats *t_stats,
+             gvertex<double> *t_size);
 
   ex::plot_index_t append(gvertex<double> t_size);
   void clear(ex::plot_relative_t t_index, bool t_silent);
@@ -51,16 +71,31 @@ class page_store
   void add_dc(ex::plot_relative_t t_index,
               std::vector<std::unique_ptr<renderers::DrawCall>> &&t_dcs, bool t_silent);
   void clip(ex::plot_relative_t t_index, grect<double> t_rect);
+  // Append primitives from native code, false if the batch is invalid
+  bool append_batch(ex::plot_relative_t t_index, const ex::primitive_batch &t_batch);
+
+  // Back the store with a page file. Pages of previous sessions are added as restored
+  // pages, which can only be rendered at their recorded size.
+  bool open_file(const std::string &t_path);
+  // Write the last page to the page file
+  void flush();
+  bool restored(ex::plot_relative_t t_index);
+  block_store::stats block_stats();
 
   ex::device_state state();
   void set_device_active(bool t_active);
 
   ex::find_results query(ex::plot_relative_t t_offset, ex::plot_index_t t_limit);
+  ex::plots_info_results info(ex::plot_relative_t t_offset, ex::plot_index_t t_limit);
+  // Full-text search over text draw calls, t_limit <= 0 for all matches
+  ex::search_results search(const std::string &t_query, ex::plot_index_t t_limit);
 
   void extra_css(std::experimental::optional<std::string> t_extra_css);
 
  private:
   std::shared_timed_mutex m_store_mutex;
+  // Render timestamps are written while only holding a read lock on the store
+  std::mutex m_render_time_mutex;
 
   ex::plot_id_t m_id_counter = 0;
   std::vector<renderers::Page> m_pages{};
@@ -69,7 +104,16 @@ class page_store
 
   std::experimental::optional<std::string> m_extra_css{};
 
+  std::unique_ptr<page_file> m_file;
+  text_index m_text_index;
+  block_store m_blocks;
+
   void m_inc_upid();
+  void m_touch_render_time(renderers::Page &t_page);
+  void m_store_page(renderers::Page &t_page);
+  // Restored pages are decoded into t_buffer
+  const renderers::Page *m_renderable(const renderers::Page &t_page,
+                                      renderers::Page *t_buffer);
 
   inline bool m_valid_index(ex::plot_relative_t t_index);
   inline size_t m_index_to_pos(ex::plot_relative_t t_index);
@@ -9,8 +9,14 @@
 #include <R_ext/GraphicsDevice.h>
 // clang-format on
 
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "compress.h"
 #include "debug_print.h"
 #include "plot_history.h"
 
@@ -34,14 +40,106 @@ bool PlotHistory::replay_current(pDevDesc dd)
   return true;
 }
 
-PlotHistory::PlotHistory() : m_items() {}
+namespace
+{
+// Snapshots are packed on the R thread, favour speed over size
+const int snapshot_compression_level = 1;
+
+struct ref_table
+{
+  std::vector<SEXP> objects;
+  std::unordered_map<SEXP, std::size_t> index;
+};
+
+void out_char(R_outpstream_t stream, int c)
+{
+  static_cast<std::vector<uint8_t> *>(stream->data)->push_back(static_cast<uint8_t>(c));
+}
+
+void out_bytes(R_outpstream_t stream, void *buf, int length)
+{
+  auto *out = static_cast<std::vector<uint8_t> *>(stream->data);
+  const auto *bytes = static_cast<const uint8_t *>(buf);
+  out->insert(out->end(), bytes, bytes + length);
+}
+
+// Environments and external pointers are stored by reference
+SEXP out_ref_hook(SEXP t_obj, SEXP t_data)
+{
+  auto *table = static_cast<ref_table *>(R_ExternalPtrAddr(t_data));
+  const auto it = table->index.find(t_obj);
+  std::size_t i;
+  if (it != table->index.end())
+  {
+    i = it->second;
+  }
+  else
+  {
+    i = table->objects.size();
+    table->objects.push_back(t_obj);
+    table->index.emplace(t_obj, i);
+  }
+  return Rf_mkString(std::to_string(i).c_str());
+}
+
+struct in_buffer
+{
+  const uint8_t *data;
+  std::size_t size;
+  std::size_t pos;
+};
+
+int in_char(R_inpstream_t stream)
+{
+  auto *in = static_cast<in_buffer *>(stream->data);
+  if (in->pos >= in->size)
+  {
+    Rf_error("Truncated plot snapshot");
+  }
+  return in->data[in->pos++];
+}
+
+void in_bytes(R_inpstream_t stream, void *buf, int length)
+{
+  auto *in = static_cast<in_buffer *>(stream->data);
+  if (in->size - in->pos < static_cast<std::size_t>(length))
+  {
+    Rf_error("Truncated plot snapshot");
+  }
+  std::memcpy(buf, in->data + in->pos, length);
+  in->pos += length;
+}
+
+SEXP in_ref_hook(SEXP t_name, SEXP t_refs)
+{
+  const auto i = std::strtol(CHAR(STRING_ELT(t_name, 0)), nullptr, 10);
+  return VECTOR_ELT(t_refs, i);
+}
+}  // namespace
+
+PlotHistory::PlotHistory() : m_items(), m_refs() {}
+
+void PlotHistory::resize(R_xlen_t t_size)
+{
+  if (m_items.size() < t_size)
+  {
+    m_items.resize(t_size);
+    m_refs.resize(t_size);
+    m_packed.resize(t_size);
+  }
+}
+
 void PlotHistory::put(R_xlen_t t_index, SEXP t_snapshot)
 {
-  if (m_items.size() <= t_index)
+  if (m_live != -1 && m_live != t_index)
   {
-    m_items.resize(t_index + 1);
+    settle(m_live);
   }
+  resize(t_index + 1);
   m_items[t_index] = t_snapshot;
+  m_refs[t_index] = R_NilValue;
+  m_packed[t_index] = {};
+  m_live = t_index;
 }
 bool PlotHistory::put_current(R_xlen_t t_index, pDevDesc dd)
 {
@@ -65,7 +163,13 @@ void PlotHistory::put_last(R_xlen_t t_index, pDevDesc dd)
 {
   put(t_index, desc2GEDesc(dd)->savedSnapshot);
 }
-void PlotHistory::clear() { m_items.clear(); }
+void PlotHistory::clear()
+{
+  m_items.clear();
+  m_refs.clear();
+  m_packed.clear();
+  m_live = -1;
+}
 bool PlotHistory::play(R_xlen_t t_index, pDevDesc dd)
 {
   SEXP snap = R_NilValue;
@@ -86,11 +190,23 @@ bool PlotHistory::play(R_xlen_t t_index, pDevDesc dd)
 }
 bool PlotHistory::get(R_xlen_t t_index, SEXP *t_snapshot)
 {
+  *t_snapshot = R_NilValue;
   if (m_items.size() <= t_index)
   {
-    *t_snapshot = R_NilValue;
     return false;
   }
+  if (static_cast<SEXP>(m_items[t_index]) == R_NilValue)
+  {
+    if (m_packed[t_index].data.empty() || !unpack(t_index))
+    {
+      return false;
+    }
+    if (m_live != -1 && m_live != t_index)
+    {
+      settle(m_live);
+    }
+    m_live = t_index;
+  }
   *t_snapshot = m_items[t_index];
   return *t_snapshot != R_NilValue;
 }
@@ -102,6 +218,109 @@ bool PlotHistory::remove(R_xlen_t t_index)
     return false;
   }
   m_items.erase(t_index);
+  m_refs.erase(t_index);
+  m_packed.erase(m_packed.begin() + t_index);
+  if (m_live == t_index)
+  {
+    m_live = -1;
+  }
+  else if (m_live > t_index)
+  {
+    --m_live;
+  }
+  return true;
+}
+
+snapshot_stats PlotHistory::stats() const
+{
+  snapshot_stats s{0, 0, 0, m_restores, m_restore_seconds};
+  for (const auto &p : m_packed)
+  {
+    if (!p.data.empty())
+    {
+      ++s.packed;
+      s.raw_bytes += p.raw_size;
+      s.compressed_bytes += p.data.size();
+    }
+  }
+  return s;
+}
+
+void PlotHistory::settle(R_xlen_t t_index)
+{
+  if (static_cast<SEXP>(m_items[t_index]) == R_NilValue)
+  {
+    return;
+  }
+  // Snapshots that can not be packed stay R objects
+  if (!m_packed[t_index].data.empty() || pack(t_index))
+  {
+    m_items[t_index] = R_NilValue;
+  }
+}
+
+bool PlotHistory::pack(R_xlen_t t_index)
+{
+  std::vector<uint8_t> raw;
+  ref_table table;
+  try
+  {
+    cpp11::sexp table_ptr(R_MakeExternalPtr(&table, R_NilValue, R_NilValue));
+    R_outpstream_st stream;
+    R_InitOutPStream(&stream, &raw, R_pstream_binary_format, 3, out_char, out_bytes,
+                     out_ref_hook, table_ptr);
+    cpp11::safe[R_Serialize](static_cast<SEXP>(m_items[t_index]), &stream);
+  }
+  catch (...)
+  {
+    debug_print("Snapshot serialization error\n");
+    return false;
+  }
+
+  auto data = compr::compress_raw(raw.data(), raw.size(), snapshot_compression_level);
+  if (data.empty())
+  {
+    return false;
+  }
+
+  cpp11::writable::list refs(static_cast<R_xlen_t>(table.objects.size()));
+  for (std::size_t i = 0; i < table.objects.size(); ++i)
+  {
+    refs[static_cast<R_xlen_t>(i)] = table.objects[i];
+  }
+  m_refs[t_index] = refs;
+  m_packed[t_index] = {std::move(data), raw.size()};
+  return true;
+}
+
+bool PlotHistory::unpack(R_xlen_t t_index)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const auto &packed = m_packed[t_index];
+
+  std::vector<uint8_t> raw(packed.raw_size);
+  if (!compr::decompress_raw(packed.data.data(), packed.data.size(), raw.data(),
+                             raw.size()))
+  {
+    return false;
+  }
+  try
+  {
+    in_buffer in{raw.data(), raw.size(), 0};
+    R_inpstream_st stream;
+    R_InitInPStream(&stream, &in, R_pstream_binary_format, in_char, in_bytes,
+                    in_ref_hook, static_cast<SEXP>(m_refs[t_index]));
+    m_items[t_index] = cpp11::safe[R_Unserialize](&stream);
+  }
+  catch (...)
+  {
+    debug_print("Snapshot unserialization error\n");
+    return false;
+  }
+
+  ++m_restores;
+  m_restore_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
   return true;
 }
 
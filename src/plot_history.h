@@ -5,10 +5,24 @@
 #define R_NO_REMAP
 #include <R_ext/GraphicsEngine.h>
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace unigd
 {
+struct snapshot_stats
+{
+  std::size_t packed;            // number of packed snapshots
+  std::size_t raw_bytes;         // serialized size of packed snapshots
+  std::size_t compressed_bytes;  // compressed size of packed snapshots
+  std::size_t restores;          // number of unpacked snapshots
+  double restore_seconds;        // total time spent unpacking
+};
+
+// Snapshots are serialized and compressed into native memory once they are no longer
+// in use, so they do not stay on the R heap. Only the most recently used snapshot is
+// kept as an R object.
 class PlotHistory
 {
  public:
@@ -27,8 +41,32 @@ class PlotHistory
   void clear();
   bool play(R_xlen_t index, pDevDesc dd);
 
+  snapshot_stats stats() const;
+
  private:
+  struct packed_snapshot
+  {
+    std::vector<uint8_t> data;
+    std::size_t raw_size{0};
+  };
+
+  // Snapshots as R objects, R_NilValue if only the packed version exists
   cpp11::writable::list m_items;
+  // Environments and external pointers referenced by packed snapshots, these are not
+  // serialized to keep their identity
+  cpp11::writable::list m_refs;
+  std::vector<packed_snapshot> m_packed;
+  // Index of the snapshot kept as R object
+  R_xlen_t m_live{-1};
+
+  std::size_t m_restores{0};
+  double m_restore_seconds{0};
+
+  void resize(R_xlen_t size);
+  // Pack a snapshot (if not already) and drop the R object
+  void settle(R_xlen_t index);
+  bool pack(R_xlen_t index);
+  bool unpack(R_xlen_t index);
 };
 
 }  // namespace unigd
@@ -0,0 +1,342 @@
+#include "png_palette.h"
+
+#include <algorithm>
+#include <vector>
+
+extern "C"
+{
+#include <png.h>
+}
+
+namespace unigd
+{
+namespace png_palette
+{
+namespace
+{
+const int max_colors = 256;
+
+// Open addressing with at most 256 entries in 1024 slots, lookups stay short
+class color_table
+{
+ public:
+  color_table() { std::fill(m_index, m_index + table_size, -1); }
+
+  // Palette index of t_key, -1 if the palette is full
+  int insert(uint32_t t_key)
+  {
+    uint32_t slot = (t_key * 2654435761u) >> (32 - table_bits);
+    while (m_index[slot] >= 0)
+    {
+      if (m_keys[slot] == t_key)
+      {
+        return m_index[slot];
+      }
+      slot = (slot + 1) & (table_size - 1);
+    }
+    if (m_count == max_colors)
+    {
+      return -1;
+    }
+    m_keys[slot] = t_key;
+    m_index[slot] = static_cast<int16_t>(m_count);
+    m_colors[m_count] = t_key;
+    return m_count++;
+  }
+
+  std::vector<uint32_t> colors() const { return {m_colors, m_colors + m_count}; }
+
+ private:
+  static const int table_bits = 10;
+  static const int table_size = 1 << table_bits;
+  uint32_t m_keys[table_size];
+  int16_t m_index[table_size];
+  uint32_t m_colors[max_colors];
+  int m_count{0};
+};
+
+inline const uint32_t *row(const uint32_t *t_pixels, size_t t_stride, int y)
+{
+  return reinterpret_cast<const uint32_t *>(reinterpret_cast<const uint8_t *>(t_pixels) +
+                                            t_stride * y);
+}
+
+// Map pixels to palette indices. Returns false when there are more than 256 colours.
+bool index_exact(const uint32_t *t_pixels, int t_width, int t_height, size_t t_stride,
+                 std::vector<uint32_t> *t_palette, uint8_t *t_indices)
+{
+  color_table table;
+  // Plots have long runs of the same colour, most pixels skip the table
+  uint32_t last = t_pixels[0];
+  int last_index = table.insert(last);
+  for (int y = 0; y < t_height; ++y)
+  {
+    const uint32_t *src = row(t_pixels, t_stride, y);
+    for (int x = 0; x < t_width; ++x)
+    {
+      if (src[x] != last)
+      {
+        last = src[x];
+        last_index = table.insert(last);
+        if (last_index < 0)
+        {
+          return false;
+        }
+      }
+      *t_indices++ = static_cast<uint8_t>(last_index);
+    }
+  }
+  *t_palette = table.colors();
+  return true;
+}
+
+// 4 bits per channel
+inline uint32_t bucket(uint32_t t_pixel)
+{
+  return ((t_pixel >> 4) & 0xF) | ((t_pixel >> 8) & 0xF0) | ((t_pixel >> 12) & 0xF00) |
+         ((t_pixel >> 16) & 0xF000);
+}
+
+inline uint32_t channel(uint32_t t_pixel, int t_channel)
+{
+  return (t_pixel >> (8 * t_channel)) & 0xFF;
+}
+
+// Popularity quantization: the 256 most used buckets become the palette (averaged
+// over their pixels), the other buckets are mapped to the nearest entry.
+// Channels are treated alike, so this works on any 32 bit pixel layout.
+void index_quantized(const uint32_t *t_pixels, int t_width, int t_height,
+                     size_t t_stride, std::vector<uint32_t> *t_palette,
+                     uint8_t *t_indices)
+{
+  const size_t bucket_count = 1 << 16;
+  std::vector<uint64_t> counts(bucket_count, 0);
+  std::vector<uint64_t> sums(bucket_count * 4, 0);
+  for (int y = 0; y < t_height; ++y)
+  {
+    const uint32_t *src = row(t_pixels, t_stride, y);
+    for (int x = 0; x < t_width; ++x)
+    {
+      const uint32_t b = bucket(src[x]);
+      counts[b]++;
+      for (int c = 0; c < 4; ++c)
+      {
+        sums[b * 4 + c] += channel(src[x], c);
+      }
+    }
+  }
+
+  std::vector<uint32_t> used;
+  for (uint32_t b = 0; b < bucket_count; ++b)
+  {
+    if (counts[b] > 0)
+    {
+      used.push_back(b);
+    }
+  }
+  auto by_count = [&](uint32_t lhs, uint32_t rhs) { return counts[lhs] > counts[rhs]; };
+  const size_t palette_size = std::min<size_t>(used.size(), max_colors);
+  std::partial_sort(used.begin(), used.begin() + palette_size, used.end(), by_count);
+
+  // Average colour of every used bucket
+  auto average = [&](uint32_t b)
+  {
+    uint32_t px = 0;
+    for (int c = 0; c < 4; ++c)
+    {
+      px |= static_cast<uint32_t>((sums[b * 4 + c] + counts[b] / 2) / counts[b])
+            << (8 * c);
+    }
+    return px;
+  };
+
+  std::vector<uint8_t> map(bucket_count, 0);
+  t_palette->clear();
+  for (size_t i = 0; i < palette_size; ++i)
+  {
+    t_palette->push_back(average(used[i]));
+    map[used[i]] = static_cast<uint8_t>(i);
+  }
+  for (size_t i = palette_size; i < used.size(); ++i)
+  {
+    const uint32_t px = average(used[i]);
+    uint32_t best_distance = UINT32_MAX;
+    for (size_t j = 0; j < palette_size; ++j)
+    {
+      uint32_t distance = 0;
+      for (int c = 0; c < 4; ++c)
+      {
+        const int d = static_cast<int>(channel(px, c)) -
+                      static_cast<int>(channel((*t_palette)[j], c));
+        distance += d * d;
+      }
+      if (distance < best_distance)
+      {
+        best_distance = distance;
+        map[used[i]] = static_cast<uint8_t>(j);
+      }
+    }
+  }
+
+  for (int y = 0; y < t_height; ++y)
+  {
+    const uint32_t *src = row(t_pixels, t_stride, y);
+    for (int x = 0; x < t_width; ++x)
+    {
+      *t_indices++ = map[bucket(src[x])];
+    }
+  }
+}
+
+inline void to_rgba(uint32_t t_pixel, pixel_format t_format, uint8_t *t_dst)
+{
+  if (t_format == pixel_format::r_color)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      t_dst[c] = static_cast<uint8_t>(channel(t_pixel, c));
+    }
+    return;
+  }
+  const uint32_t a = t_pixel >> 24;
+  if (a == 0)
+  {
+    t_dst[0] = t_dst[1] = t_dst[2] = t_dst[3] = 0;
+    return;
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    const uint32_t v = channel(t_pixel, 2 - c);
+    t_dst[c] = static_cast<uint8_t>(a == 0xFF ? v : (v * 255 + a / 2) / a);
+  }
+  t_dst[3] = static_cast<uint8_t>(a);
+}
+
+void sink_write(png_structp png, png_bytep data, png_size_t length)
+{
+  if (!static_cast<output_sink *>(png_get_io_ptr(png))->write(data, length))
+  {
+    png_error(png, "Write failed");
+  }
+}
+
+void sink_flush(png_structp) {}
+
+}  // namespace
+
+bool parse_mode(const std::string &t_value, mode *t_mode)
+{
+  if (t_value == "none")
+  {
+    *t_mode = mode::none;
+  }
+  else if (t_value == "exact")
+  {
+    *t_mode = mode::exact;
+  }
+  else if (t_value == "quantize")
+  {
+    *t_mode = mode::quantize;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool encode(const uint32_t *t_pixels, int t_width, int t_height, size_t t_stride,
+            pixel_format t_format, mode t_mode, output_sink *t_out)
+{
+  if (t_mode == mode::none || t_width <= 0 || t_height <= 0)
+  {
+    return false;
+  }
+
+  std::vector<uint32_t> colors;
+  std::vector<uint8_t> indices(static_cast<size_t>(t_width) * t_height);
+  if (!index_exact(t_pixels, t_width, t_height, t_stride, &colors, indices.data()))
+  {
+    if (t_mode != mode::quantize)
+    {
+      return false;
+    }
+    index_quantized(t_pixels, t_width, t_height, t_stride, &colors, indices.data());
+  }
+
+  // Translucent entries go first, so the tRNS chunk can stop after them
+  const int n = static_cast<int>(colors.size());
+  std::vector<png_color> palette(n);
+  std::vector<png_byte> alpha(n);
+  uint8_t remap[max_colors];
+  int n_trans = 0;
+  for (int pass = 0, next = 0; pass < 2; ++pass)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      uint8_t rgba[4];
+      to_rgba(colors[i], t_format, rgba);
+      if ((rgba[3] != 0xFF) != (pass == 0))
+      {
+        continue;
+      }
+      palette[next] = {rgba[0], rgba[1], rgba[2]};
+      alpha[next] = rgba[3];
+      remap[i] = static_cast<uint8_t>(next++);
+    }
+    if (pass == 0)
+    {
+      n_trans = next;
+    }
+  }
+  if (n_trans > 0)
+  {
+    for (auto &index : indices)
+    {
+      index = remap[index];
+    }
+  }
+
+  const int bit_depth = n <= 2 ? 1 : n <= 4 ? 2 : n <= 16 ? 4 : 8;
+  std::vector<png_bytep> rows(t_height);
+  for (int y = 0; y < t_height; ++y)
+  {
+    rows[y] = indices.data() + static_cast<size_t>(y) * t_width;
+  }
+
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (!png)
+  {
+    return false;
+  }
+  png_infop info = png_create_info_struct(png);
+  if (!info)
+  {
+    png_destroy_write_struct(&png, (png_infopp)NULL);
+    return false;
+  }
+  const size_t written = t_out->size();
+  if (setjmp(png_jmpbuf(png)))
+  {
+    png_destroy_write_struct(&png, &info);
+    // Take back the partial image so the caller can fall back. Sinks that can not
+    // take output back fail, the fallback output is not written then.
+    t_out->truncate(written);
+    return false;
+  }
+  png_set_IHDR(png, info, t_width, t_height, bit_depth, PNG_COLOR_TYPE_PALETTE,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_set_PLTE(png, info, palette.data(), n);
+  if (n_trans > 0)
+  {
+    png_set_tRNS(png, info, alpha.data(), n_trans, NULL);
+  }
+  png_set_rows(png, info, rows.data());
+  png_set_write_fn(png, t_out, sink_write, sink_flush);
+  png_write_png(png, info, PNG_TRANSFORM_PACKING, NULL);
+  png_destroy_write_struct(&png, &info);
+  return true;
+}
+
+}  // namespace png_palette
+}  // namespace unigd
@@ -0,0 +1,43 @@
+#ifndef __UNIGD_PNG_PALETTE_H__
+#define __UNIGD_PNG_PALETTE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "output_sink.h"
+
+namespace unigd
+{
+// Indexed colour PNG for images with few colours (most plots). Colours are counted
+// while the pixels are scanned, alpha is stored in a tRNS chunk and the bit depth is
+// reduced to 1, 2 or 4 bits when the palette is small enough.
+namespace png_palette
+{
+enum class mode
+{
+  none,     // always RGBA
+  exact,    // indexed if the image has at most 256 colours
+  quantize  // indexed, larger palettes are reduced to 256 colours (lossy)
+};
+
+// Layout of the 32 bit pixels
+enum class pixel_format
+{
+  cairo_argb32,  // Cairo image surface: native endian premultiplied ARGB
+  r_color        // R color values: straight RGBA, red in the lowest byte
+};
+
+// Renderer option "palette" (none, exact, quantize). Returns false for unknown values.
+bool parse_mode(const std::string &t_value, mode *t_mode);
+
+// Encode t_height rows of t_width pixels, rows are t_stride bytes apart.
+// Returns false without writing anything when the image is not suitable for the
+// mode or encoding failed, the caller should fall back to RGBA then.
+bool encode(const uint32_t *t_pixels, int t_width, int t_height, size_t t_stride,
+            pixel_format t_format, mode t_mode, output_sink *t_out);
+
+}  // namespace png_palette
+}  // namespace unigd
+
+#endif /* __UNIGD_PNG_PALETTE_H__ */
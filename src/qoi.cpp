@@ -0,0 +1,142 @@
+#include "qoi.h"
+
+#include <cstring>
+#include <vector>
+
+namespace unigd
+{
+namespace qoi
+{
+namespace
+{
+const uint8_t op_index = 0x00;  // 00xxxxxx
+const uint8_t op_diff = 0x40;   // 01xxxxxx
+const uint8_t op_luma = 0x80;   // 10xxxxxx
+const uint8_t op_run = 0xc0;    // 11xxxxxx
+const uint8_t op_rgb = 0xfe;
+const uint8_t op_rgba = 0xff;
+
+const uint8_t end_marker[] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+struct rgba
+{
+  uint8_t r, g, b, a;
+};
+
+inline bool operator==(const rgba &lhs, const rgba &rhs)
+{
+  return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+}
+
+inline int hash(const rgba &px) { return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64; }
+
+inline void put_u32(uint8_t *t_buf, uint32_t t_value)
+{
+  t_buf[0] = static_cast<uint8_t>(t_value >> 24);
+  t_buf[1] = static_cast<uint8_t>(t_value >> 16);
+  t_buf[2] = static_cast<uint8_t>(t_value >> 8);
+  t_buf[3] = static_cast<uint8_t>(t_value);
+}
+}  // namespace
+
+bool encode(const uint8_t *t_rgba, uint32_t t_width, uint32_t t_height, output_sink *t_out)
+{
+  uint8_t header[14] = {'q', 'o', 'i', 'f'};
+  put_u32(header + 4, t_width);
+  put_u32(header + 8, t_height);
+  header[12] = 4;  // channels
+  header[13] = 0;  // sRGB with linear alpha
+  t_out->write(header, sizeof(header));
+
+  const size_t px_count = static_cast<size_t>(t_width) * t_height;
+  // worst case is 5 bytes per pixel, output is flushed in chunks
+  const size_t chunk_size = 64 * 1024;
+  std::vector<uint8_t> buf(chunk_size + 8);
+  size_t pos = 0;
+
+  rgba index[64];
+  std::memset(index, 0, sizeof(index));
+  rgba prev{0, 0, 0, 255};
+  int run = 0;
+
+  for (size_t i = 0; i < px_count; ++i)
+  {
+    const uint8_t *p = t_rgba + i * 4;
+    const rgba px{p[0], p[1], p[2], p[3]};
+
+    if (px == prev)
+    {
+      run++;
+      if (run == 62 || i == px_count - 1)
+      {
+        buf[pos++] = op_run | static_cast<uint8_t>(run - 1);
+        run = 0;
+      }
+    }
+    else
+    {
+      if (run > 0)
+      {
+        buf[pos++] = op_run | static_cast<uint8_t>(run - 1);
+        run = 0;
+      }
+
+      const int index_pos = hash(px);
+      if (index[index_pos] == px)
+      {
+        buf[pos++] = op_index | static_cast<uint8_t>(index_pos);
+      }
+      else
+      {
+        index[index_pos] = px;
+
+        if (px.a == prev.a)
+        {
+          const int8_t vr = static_cast<int8_t>(px.r - prev.r);
+          const int8_t vg = static_cast<int8_t>(px.g - prev.g);
+          const int8_t vb = static_cast<int8_t>(px.b - prev.b);
+          const int8_t vg_r = static_cast<int8_t>(vr - vg);
+          const int8_t vg_b = static_cast<int8_t>(vb - vg);
+
+          if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+          {
+            buf[pos++] = op_diff | static_cast<uint8_t>((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+          }
+          else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+          {
+            buf[pos++] = op_luma | static_cast<uint8_t>(vg + 32);
+            buf[pos++] = static_cast<uint8_t>((vg_r + 8) << 4 | (vg_b + 8));
+          }
+          else
+          {
+            buf[pos++] = op_rgb;
+            buf[pos++] = px.r;
+            buf[pos++] = px.g;
+            buf[pos++] = px.b;
+          }
+        }
+        else
+        {
+          buf[pos++] = op_rgba;
+          buf[pos++] = px.r;
+          buf[pos++] = px.g;
+          buf[pos++] = px.b;
+          buf[pos++] = px.a;
+        }
+      }
+    }
+    prev = px;
+
+    if (pos >= chunk_size)
+    {
+      t_out->write(buf.data(), pos);
+      pos = 0;
+    }
+  }
+  t_out->write(buf.data(), pos);
+  t_out->write(end_marker, sizeof(end_marker));
+  return t_out->ok();
+}
+
+}  // namespace qoi
+}  // namespace unigd
@@ -0,0 +1,21 @@
+#ifndef __UNIGD_QOI_H__
+#define __UNIGD_QOI_H__
+
+#include <cstdint>
+
+#include "output_sink.h"
+
+namespace unigd
+{
+// "Quite OK Image Format" lossless encoder.
+// See: https://qoiformat.org/qoi-specification.pdf
+namespace qoi
+{
+// Encode straight (not premultiplied) 8 bit RGBA pixels.
+bool encode(const uint8_t *t_rgba, uint32_t t_width, uint32_t t_height,
+            output_sink *t_out);
+
+}  // namespace qoi
+}  // namespace unigd
+
+#endif /* __UNIGD_QOI_H__ */
@@ -0,0 +1,139 @@
+#include "render_cache.h"
+
+#include <stdexcept>
+
+#include "compress.h"
+
+namespace unigd
+{
+render_cache_entry::render_cache_entry(fingerprint::fingerprint_t t_fingerprint,
+                                       std::vector<uint8_t> &&t_data)
+    : m_fingerprint(t_fingerprint), m_identity(std::move(t_data))
+{
+}
+
+fingerprint::fingerprint_t render_cache_entry::fingerprint() const
+{
+  return m_fingerprint;
+}
+
+const std::vector<uint8_t> &render_cache_entry::data(
+    ex::render_encoding_t t_encoding) const
+{
+  // Compressors return no output on failure, even empty input compresses to a few
+  // bytes. Throwing leaves the once flag unset, so the next call tries again.
+  if (t_encoding == UNIGD_RENDER_ENCODING_GZIP)
+  {
+    std::call_once(m_gzip_once,
+                   [&]()
+                   {
+                     auto gzip = compr::compress(m_identity.data(), m_identity.size());
+                     if (gzip.empty())
+                     {
+                       throw std::runtime_error("gzip encoding failed");
+                     }
+                     m_gzip = std::move(gzip);
+                   });
+    return m_gzip;
+  }
+  if (t_encoding == UNIGD_RENDER_ENCODING_DEFLATE_DICT)
+  {
+    std::call_once(m_deflate_dict_once,
+                   [&]()
+                   {
+                     auto deflate_dict =
+                         compr::compress_dict(m_identity.data(), m_identity.size());
+                     if (deflate_dict.empty())
+                     {
+                       throw std::runtime_error("deflate dictionary encoding failed");
+                     }
+                     m_deflate_dict = std::move(deflate_dict);
+                   });
+    return m_deflate_dict;
+  }
+  return m_identity;
+}
+
+bool render_cache_entry::encode(ex::render_encoding_t t_encoding) const
+{
+  try
+  {
+    data(t_encoding);
+    return true;
+  }
+  catch (const std::exception &)
+  {
+    return false;
+  }
+}
+
+size_t render_cache_entry::size() const { return m_identity.size(); }
+
+cached_render::cached_render(std::shared_ptr<const render_cache_entry> t_entry,
+                             ex::render_encoding_t t_encoding)
+    : m_entry(std::move(t_entry)), m_encoding(t_encoding)
+{
+}
+
+void cached_render::get_data(const uint8_t **t_buf, size_t *t_size) const
+{
+  const auto &buf = m_entry->data(m_encoding);
+  *t_buf = buf.data();
+  *t_size = buf.size();
+}
+
+render_cache::render_cache(size_t t_max_bytes) : m_max_bytes(t_max_bytes) {}
+
+std::shared_ptr<const render_cache_entry> render_cache::get(
+    fingerprint::fingerprint_t t_fingerprint)
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if ((*it)->fingerprint() == t_fingerprint)
+    {
+      m_entries.splice(m_entries.begin(), m_entries, it);
+      return m_entries.front();
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const render_cache_entry> render_cache::put(
+    fingerprint::fingerprint_t t_fingerprint, std::vector<uint8_t> &&t_data)
+{
+  auto entry = std::make_shared<const render_cache_entry>(t_fingerprint, std::move(t_data));
+
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if ((*it)->fingerprint() == t_fingerprint)
+    {
+      m_bytes -= (*it)->size();
+      m_entries.erase(it);
+      break;
+    }
+  }
+  // Too large to be cached, still handed out to the caller
+  if (entry->size() > m_max_bytes)
+  {
+    return entry;
+  }
+  m_entries.push_front(entry);
+  m_bytes += entry->size();
+  while (m_bytes > m_max_bytes)
+  {
+    m_bytes -= m_entries.back()->size();
+    m_entries.pop_back();
+  }
+  return entry;
+}
+
+void render_cache::clear()
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_bytes = 0;
+}
+
+}  // namespace unigd
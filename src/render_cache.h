@@ -0,0 +1,82 @@
+#ifndef __UNIGD_RENDER_CACHE_H__
+#define __UNIGD_RENDER_CACHE_H__
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fingerprint.h"
+#include "unigd_external.h"
+
+namespace unigd
+{
+// Rendered output of a single plot, identified by its render fingerprint.
+// Encoded variants are computed on first access and then kept with the entry.
+class render_cache_entry
+{
+ public:
+  render_cache_entry(fingerprint::fingerprint_t t_fingerprint,
+                     std::vector<uint8_t> &&t_data);
+
+  fingerprint::fingerprint_t fingerprint() const;
+  // Throws if the output can not be encoded, see encode().
+  const std::vector<uint8_t> &data(ex::render_encoding_t t_encoding) const;
+  // Computes the encoded variant, returns false if compression failed.
+  bool encode(ex::render_encoding_t t_encoding) const;
+  size_t size() const;
+
+ private:
+  fingerprint::fingerprint_t m_fingerprint;
+  std::vector<uint8_t> m_identity;
+
+  mutable std::once_flag m_gzip_once;
+  mutable std::vector<uint8_t> m_gzip;
+  mutable std::once_flag m_deflate_dict_once;
+  mutable std::vector<uint8_t> m_deflate_dict;
+};
+
+// Render data handed out to API clients, keeps the entry alive.
+class cached_render : public ex::render_data
+{
+ public:
+  cached_render(std::shared_ptr<const render_cache_entry> t_entry,
+                ex::render_encoding_t t_encoding);
+
+  void get_data(const uint8_t **t_buf, size_t *t_size) const override;
+
+ private:
+  std::shared_ptr<const render_cache_entry> m_entry;
+  ex::render_encoding_t m_encoding;
+};
+
+// Small LRU cache of rendered plots. Entries are looked up by render
+// fingerprint, which already covers plot ID, renderer, size, scale and plot content.
+// The size is limited by the bytes of uncompressed output, encoded variants are
+// kept with their entry on top of that.
+class render_cache
+{
+ public:
+  explicit render_cache(size_t t_max_bytes);
+
+  render_cache(const render_cache &) = delete;
+  render_cache &operator=(render_cache &) = delete;
+  render_cache &operator=(const render_cache &) = delete;
+
+  std::shared_ptr<const render_cache_entry> get(fingerprint::fingerprint_t t_fingerprint);
+  std::shared_ptr<const render_cache_entry> put(fingerprint::fingerprint_t t_fingerprint,
+                                                std::vector<uint8_t> &&t_data);
+  void clear();
+
+ private:
+  std::mutex m_mutex;
+  size_t m_max_bytes;
+  size_t m_bytes{0};
+  // most recently used first
+  std::list<std::shared_ptr<const render_cache_entry>> m_entries;
+};
+
+}  // namespace unigd
+
+#endif /* __UNIGD_RENDER_CACHE_H__ */
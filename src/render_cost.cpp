@@ -0,0 +1,224 @@
+#include "render_cost.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
+#include "renderers.h"
+
+namespace unigd
+{
+namespace render_cost
+{
+namespace
+{
+struct coefficients
+{
+  double base;
+  double per_shape;
+  double per_vertex;
+  double per_text;
+  double per_text_char;
+  double per_raster_byte;
+  double per_pixel;
+
+  double apply(const renderers::PageStats &t_stats, double t_pixels) const
+  {
+    return base + per_shape * t_stats.shapes + per_vertex * t_stats.vertices +
+           per_text * t_stats.texts + per_text_char * t_stats.text_chars +
+           per_raster_byte * t_stats.raster_bytes + per_pixel * t_pixels;
+  }
+};
+
+struct model
+{
+  coefficients bytes;
+  coefficients seconds;
+};
+
+// Rough priors for typical plots, corrected by the calibration. Vector formats scale
+// with the draw calls, raster formats mostly with the pixel count.
+const std::unordered_map<std::string, model> models = {
+    {"svg",
+     {{600, 95, 14, 140, 1, 0.7, 0}, {2e-4, 1.2e-6, 0.1e-6, 2e-6, 0, 6e-9, 0}}},
+    {"svgp",
+     {{600, 95, 14, 140, 1, 0.7, 0}, {2e-4, 1.2e-6, 0.1e-6, 2e-6, 0, 6e-9, 0}}},
+    {"svgz",
+     {{300, 12, 4, 30, 0.5, 0.5, 0}, {3e-4, 2e-6, 0.25e-6, 3e-6, 0, 8e-9, 0}}},
+    {"json",
+     {{200, 160, 30, 220, 1, 1.4, 0}, {2e-4, 1.5e-6, 0.15e-6, 2e-6, 0, 5e-9, 0}}},
+    {"pdf",
+     {{6000, 25, 9, 40, 1, 0.5, 0}, {2e-3, 2e-6, 0.2e-6, 10e-6, 0, 10e-9, 0}}},
+    {"png",
+     {{800, 3, 0.5, 20, 0, 0.1, 0.06}, {1e-3, 3e-6, 0.2e-6, 15e-6, 0, 4e-9, 10e-9}}},
+    {"qoi",
+     {{14, 3, 0.5, 20, 0, 0.2, 0.12}, {5e-4, 3e-6, 0.2e-6, 15e-6, 0, 4e-9, 4e-9}}},
+    {"rgba",
+     {{12, 0, 0, 0, 0, 0, 4}, {3e-4, 3e-6, 0.2e-6, 15e-6, 0, 4e-9, 3e-9}}}};
+
+const char *auto_candidates[] = {"svg", "png"};
+const double default_max_bytes = 1024 * 1024;
+const double default_max_seconds = 0.25;
+
+// Weight of a new observation
+const double ewma_alpha = 0.2;
+
+struct correction
+{
+  double bytes = 1;
+  double seconds = 1;
+};
+
+std::mutex corrections_mutex;
+std::unordered_map<std::string, correction> corrections;
+
+std::string base_id(const std::string &t_renderer_id)
+{
+  return t_renderer_id.substr(0, t_renderer_id.find(':'));
+}
+
+inline double update(double t_factor, double t_ratio)
+{
+  t_ratio = std::min(std::max(t_ratio, 0.01), 100.0);
+  return t_factor * (1 - ewma_alpha) + t_ratio * ewma_alpha;
+}
+
+bool parse_budget(const std::string &t_auto_id, double *t_max_bytes,
+                  double *t_max_seconds)
+{
+  *t_max_bytes = default_max_bytes;
+  *t_max_seconds = default_max_seconds;
+
+  const auto sep = t_auto_id.find(':');
+  if (sep == std::string::npos)
+  {
+    return true;
+  }
+  std::size_t begin = sep + 1;
+  while (begin <= t_auto_id.size())
+  {
+    auto end = t_auto_id.find(',', begin);
+    if (end == std::string::npos)
+    {
+      end = t_auto_id.size();
+    }
+    const auto eq = t_auto_id.find('=', begin);
+    if (eq == std::string::npos || eq >= end)
+    {
+      return false;
+    }
+    const auto key = t_auto_id.substr(begin, eq - begin);
+    const auto value = t_auto_id.substr(eq + 1, end - eq - 1);
+    char *parsed_end;
+    const double v = std::strtod(value.c_str(), &parsed_end);
+    if (value.empty() || *parsed_end != '\0' || v <= 0)
+    {
+      return false;
+    }
+    if (key == "bytes")
+    {
+      *t_max_bytes = v;
+    }
+    else if (key == "ms")
+    {
+      *t_max_seconds = v / 1000.0;
+    }
+    else
+    {
+      return false;
+    }
+    begin = end + 1;
+  }
+  return true;
+}
+}  // namespace
+
+bool predict(const std::string &t_renderer_id, const renderers::PageStats &t_stats,
+             double t_pixels, estimate *t_estimate)
+{
+  const auto id = base_id(t_renderer_id);
+  const auto it = models.find(id);
+  if (it == models.end())
+  {
+    return false;
+  }
+  correction corr;
+  {
+    const std::lock_guard<std::mutex> lock(corrections_mutex);
+    const auto cit = corrections.find(id);
+    if (cit != corrections.end())
+    {
+      corr = cit->second;
+    }
+  }
+  t_estimate->bytes = it->second.bytes.apply(t_stats, t_pixels) * corr.bytes;
+  t_estimate->seconds = it->second.seconds.apply(t_stats, t_pixels) * corr.seconds;
+  return true;
+}
+
+void observe(const std::string &t_renderer_id, const renderers::PageStats &t_stats,
+             double t_pixels, double t_seconds, std::size_t t_bytes)
+{
+  const auto id = base_id(t_renderer_id);
+  const auto it = models.find(id);
+  if (it == models.end())
+  {
+    return;
+  }
+  const double bytes = it->second.bytes.apply(t_stats, t_pixels);
+  const double seconds = it->second.seconds.apply(t_stats, t_pixels);
+
+  const std::lock_guard<std::mutex> lock(corrections_mutex);
+  auto &corr = corrections[id];
+  if (t_bytes > 0)
+  {
+    corr.bytes = update(corr.bytes, t_bytes / bytes);
+  }
+  corr.seconds = update(corr.seconds, t_seconds / seconds);
+}
+
+bool is_auto(const std::string &t_renderer_id)
+{
+  return base_id(t_renderer_id) == "auto";
+}
+
+bool select(const std::string &t_auto_id, const renderers::PageStats &t_stats,
+            double t_pixels, const char **t_renderer_id, estimate *t_estimate)
+{
+  double max_bytes;
+  double max_seconds;
+  if (!parse_budget(t_auto_id, &max_bytes, &max_seconds))
+  {
+    return false;
+  }
+
+  double best_excess = 0;
+  bool found = false;
+  for (const auto *candidate : auto_candidates)
+  {
+    estimate e;
+    unigd_renderer_info info;
+    if (!renderers::find_info(candidate, &info) ||
+        !predict(candidate, t_stats, t_pixels, &e))
+    {
+      continue;
+    }
+    const double excess = std::max(e.bytes / max_bytes, e.seconds / max_seconds);
+    if (!found || excess < best_excess)
+    {
+      found = true;
+      best_excess = excess;
+      *t_renderer_id = candidate;
+      *t_estimate = e;
+    }
+    if (excess <= 1)
+    {
+      break;
+    }
+  }
+  return found;
+}
+
+}  // namespace render_cost
+}  // namespace unigd
@@ -0,0 +1,42 @@
+#ifndef __UNIGD_RENDER_COST_H__
+#define __UNIGD_RENDER_COST_H__
+
+#include <string>
+
+#include "draw_data.h"
+
+namespace unigd
+{
+// Predicts output size and render time of a page per renderer. The model is linear in
+// the page statistics and the output pixel count, with per renderer correction factors
+// that are calibrated from timed renders.
+namespace render_cost
+{
+struct estimate
+{
+  double bytes;
+  double seconds;
+};
+
+// Renderer options ("<id>:...") are ignored. Returns false for renderers without a
+// model.
+bool predict(const std::string &t_renderer_id, const renderers::PageStats &t_stats,
+             double t_pixels, estimate *t_estimate);
+
+// Feed a measured render into the calibration (exponentially weighted moving average
+// of actual / predicted).
+void observe(const std::string &t_renderer_id, const renderers::PageStats &t_stats,
+             double t_pixels, double t_seconds, std::size_t t_bytes);
+
+// Automatic format selection: "auto" or "auto:bytes=<max bytes>,ms=<max milliseconds>"
+bool is_auto(const std::string &t_renderer_id);
+
+// Picks the first candidate (SVG, then PNG) that stays within the budget, or the one
+// that exceeds it the least. Returns false if the ID could not be parsed.
+bool select(const std::string &t_auto_id, const renderers::PageStats &t_stats,
+            double t_pixels, const char **t_renderer_id, estimate *t_estimate);
+
+}  // namespace render_cost
+}  // namespace unigd
+
+#endif /* __UNIGD_RENDER_COST_H__ */
@@ -0,0 +1,167 @@
+#include "render_limiter.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace unigd
+{
+namespace
+{
+thread_local uint64_t current_client{0};
+thread_local bool rejected{false};
+
+const unsigned default_queue = 256;
+}  // namespace
+
+render_limiter::ticket::ticket(std::shared_ptr<render_limiter> t_limiter)
+    : m_limiter(std::move(t_limiter))
+{
+}
+
+render_limiter::ticket &render_limiter::ticket::operator=(ticket &&other)
+{
+  if (this != &other)
+  {
+    if (m_limiter)
+    {
+      m_limiter->release();
+    }
+    m_limiter = std::move(other.m_limiter);
+  }
+  return *this;
+}
+
+render_limiter::ticket::~ticket()
+{
+  if (m_limiter)
+  {
+    m_limiter->release();
+  }
+}
+
+render_limiter::render_limiter()
+    : m_limits{std::max(1U, std::thread::hardware_concurrency()), default_queue, 0}
+{
+}
+
+render_limiter::ticket render_limiter::acquire()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (admit())
+  {
+    return ticket(shared_from_this());
+  }
+
+  auto &queue = m_waiting[current_client];
+  if (m_queued >= m_limits.queue ||
+      (m_limits.client_queue > 0 && queue.size() >= m_limits.client_queue))
+  {
+    if (queue.empty())
+    {
+      m_waiting.erase(current_client);
+    }
+    ++m_rejected;
+    rejected = true;
+    return ticket();
+  }
+
+  waiter w;
+  if (queue.empty())
+  {
+    m_turns.push_back(current_client);
+  }
+  queue.push_back(&w);
+  m_peak_queued = std::max(m_peak_queued, ++m_queued);
+
+  // The slot is handed over by release(), m_running already counts it
+  w.cv.wait(lock, [&w] { return w.granted; });
+  ++m_admitted;
+  rejected = false;
+  return ticket(shared_from_this());
+}
+
+render_limiter::ticket render_limiter::try_acquire()
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  if (admit())
+  {
+    return ticket(shared_from_this());
+  }
+  ++m_rejected;
+  rejected = true;
+  return ticket();
+}
+
+bool render_limiter::admit()
+{
+  if (m_running >= m_limits.workers || m_queued > 0)
+  {
+    return false;
+  }
+  ++m_running;
+  ++m_admitted;
+  rejected = false;
+  return true;
+}
+
+void render_limiter::release()
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  --m_running;
+  dispatch();
+}
+
+void render_limiter::dispatch()
+{
+  while (m_running < m_limits.workers && !m_turns.empty())
+  {
+    const uint64_t client = m_turns.front();
+    m_turns.pop_front();
+    auto it = m_waiting.find(client);
+    waiter *w = it->second.front();
+    it->second.pop_front();
+    if (it->second.empty())
+    {
+      m_waiting.erase(it);
+    }
+    else
+    {
+      m_turns.push_back(client);
+    }
+    --m_queued;
+    ++m_running;
+    w->granted = true;
+    w->cv.notify_one();
+  }
+}
+
+void render_limiter::set_limits(limits t_limits)
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  t_limits.workers = std::max(1U, t_limits.workers);
+  m_limits = t_limits;
+  // Waiting renders stay queued even if the new queue limits are lower
+  dispatch();
+}
+
+render_limiter::stats render_limiter::get_stats()
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return {m_limits,
+          m_running,
+          m_queued,
+          static_cast<unsigned>(m_turns.size()),
+          m_peak_queued,
+          m_admitted,
+          m_rejected};
+}
+
+void render_limiter::set_client(uint64_t t_client) { current_client = t_client; }
+
+uint64_t render_limiter::client() { return current_client; }
+
+bool render_limiter::last_rejected() { return rejected; }
+
+void render_limiter::reset_rejected() { rejected = false; }
+
+}  // namespace unigd
@@ -0,0 +1,105 @@
+#ifndef __UNIGD_RENDER_LIMITER_H__
+#define __UNIGD_RENDER_LIMITER_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace unigd
+{
+// Admission control for render requests of clients. At most `workers` renders run at
+// the same time, further requests wait in per-client queues which are served round
+// robin. Requests are rejected right away when the queues are full, so a burst of
+// requests can not pile up unbounded work (and replays on the R thread).
+class render_limiter : public std::enable_shared_from_this<render_limiter>
+{
+ public:
+  struct limits
+  {
+    unsigned workers;       // concurrent renders, at least 1
+    unsigned queue;         // waiting renders of all clients
+    unsigned client_queue;  // waiting renders per client, 0 for no extra limit
+  };
+
+  struct stats
+  {
+    limits limit;
+    unsigned running;
+    unsigned queued;
+    unsigned clients;  // clients with waiting renders
+    unsigned peak_queued;
+    uint64_t admitted;
+    uint64_t rejected;
+  };
+
+  // A render slot, released on destruction. Converts to false if the request was
+  // rejected.
+  class ticket
+  {
+   public:
+    ticket() = default;
+    ticket(ticket &&) = default;
+    ticket &operator=(ticket &&other);
+    ~ticket();
+
+    explicit operator bool() const { return m_limiter != nullptr; }
+
+   private:
+    friend class render_limiter;
+    explicit ticket(std::shared_ptr<render_limiter> t_limiter);
+    std::shared_ptr<render_limiter> m_limiter;
+  };
+
+  render_limiter();
+
+  render_limiter(const render_limiter &) = delete;
+  render_limiter &operator=(const render_limiter &) = delete;
+
+  // Blocks until a slot is free. Must not be called from the R thread, running
+  // renders may wait for it to replay plots.
+  ticket acquire();
+  // Takes a free slot without waiting. Rejected if all slots are busy or other
+  // renders are waiting for one.
+  ticket try_acquire();
+
+  void set_limits(limits t_limits);
+  stats get_stats();
+
+  // Queue key for renders of the calling thread (e.g. a connection ID), default 0
+  static void set_client(uint64_t t_client);
+  static uint64_t client();
+  // The last acquire() of the calling thread since reset_rejected() was rejected
+  static bool last_rejected();
+  static void reset_rejected();
+
+ private:
+  struct waiter
+  {
+    std::condition_variable cv;
+    bool granted{false};
+  };
+
+  std::mutex m_mutex;
+  limits m_limits;
+  unsigned m_running{0};
+  unsigned m_queued{0};
+  unsigned m_peak_queued{0};
+  uint64_t m_admitted{0};
+  uint64_t m_rejected{0};
+  std::unordered_map<uint64_t, std::deque<waiter *>> m_waiting;
+  // Clients with waiting renders, in the order they are served
+  std::deque<uint64_t> m_turns;
+
+  void release();
+  // Hand free slots to waiting renders
+  void dispatch();
+  // Take a free slot if nobody is waiting, called with m_mutex held
+  bool admit();
+};
+
+}  // namespace unigd
+
+#endif /* __UNIGD_RENDER_LIMITER_H__ */
@@ -5,9 +5,13 @@
 #include <cairo-pdf.h>
 #include <cairo-ps.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include "base_64.h"  // for RendererCairoPngBase64
+#include "debug_print.h"
+#include "qoi.h"
+#include "tiled_tiff.h"
 
 #ifndef UNIGD_NO_TIFF
 #include <tiffio.hxx>
@@ -106,8 +110,13 @@ void RendererCairo::render_page(const Page *t_page)
                   first_clip.rect.height);
   cairo_clip(cr);
   auto last_clip_id = first_clip.id;
+  const bool cull = !rect_empty(m_cull);
   for (const auto &dc : t_page->dcs)
   {
+    if (cull && rect_empty(rect_intersect(bounds(*dc), m_cull)))
+    {
+      continue;
+    }
     if (dc->clip_id != last_clip_id)
     {
       const auto &next_clip =
@@ -127,6 +136,33 @@ void RendererCairo::render_page(const Page *t_page)
   }
 }
 
+bool RendererCairo::set_image_region(grect<int> t_region)
+{
+  m_region = t_region;
+  return true;
+}
+
+void RendererCairo::create_image_surface(const Page &t_page, double t_scale)
+{
+  if (rect_empty(m_region))
+  {
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, t_page.size.x * t_scale,
+                                         t_page.size.y * t_scale);
+    cr = cairo_create(surface);
+    m_cull = {0, 0, 0, 0};
+  }
+  else
+  {
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, m_region.width,
+                                         m_region.height);
+    cr = cairo_create(surface);
+    cairo_translate(cr, -m_region.x, -m_region.y);
+    m_cull = {m_region.x / t_scale, m_region.y / t_scale, m_region.width / t_scale,
+              m_region.height / t_scale};
+  }
+  cairo_scale(cr, t_scale, t_scale);
+}
+
 void RendererCairo::visit(const Rect *t_rect)
 {
   cairo_new_path(cr);
@@ -367,48 +403,63 @@ void RendererCairo::visit(const Raster *t_raster)
 
 // TARGETS
 
-static cairo_status_t cairowrite_fmt(void *closure, unsigned char const *data,
-                                     unsigned int length)
+static cairo_status_t cairowrite_sink(void *closure, unsigned char const *data,
+                                      unsigned int length)
 {
-  auto *os = static_cast<fmt::memory_buffer *>(closure);
-  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-  std::string s(reinterpret_cast<char const *>(data), length);
-  fmt::format_to(std::back_inserter(*os), "{}", s);
-  return CAIRO_STATUS_SUCCESS;
+  auto *sink = static_cast<output_sink *>(closure);
+  return sink->write(data, length) ? CAIRO_STATUS_SUCCESS : CAIRO_STATUS_WRITE_ERROR;
 }
 
-static cairo_status_t cairowrite_ucvec(void *closure, unsigned char const *data,
-                                       unsigned int length)
+// Rough estimate of vector output size to avoid most buffer reallocations
+static inline size_t vector_size_hint(const Page &t_page)
 {
-  auto *render_data = static_cast<std::vector<unsigned char> *>(closure);
-  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-  render_data->insert(render_data->end(), data, data + length);
-  return CAIRO_STATUS_SUCCESS;
+  return (t_page.dcs.size() + t_page.cps.size()) * 96 + 8192;
 }
 
-void RendererCairoPng::render(const Page &t_page, double t_scale)
+void RendererCairoStream::get_data(const uint8_t **t_buf, size_t *t_size) const
 {
-  surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, t_page.size.x * t_scale,
-                                       t_page.size.y * t_scale);
+  *t_buf = m_out->data();
+  *t_size = m_out->is_memory() && m_out->ok() ? m_out->size() : 0;
+}
 
-  cr = cairo_create(surface);
+bool RendererCairoStream::set_sink(output_sink *t_sink)
+{
+  m_out = t_sink;
+  return true;
+}
 
-  cairo_scale(cr, t_scale, t_scale);
+bool RendererCairoPng::set_region(grect<int> t_region)
+{
+  return set_image_region(t_region);
+}
 
-  render_page(&t_page);
+bool RendererCairoPng::set_option(const std::string &t_key, const std::string &t_value)
+{
+  return t_key == "palette" && png_palette::parse_mode(t_value, &m_palette);
+}
 
-  cairo_surface_write_to_png_stream(surface, cairowrite_ucvec, &m_render_data);
+void RendererCairoPng::render(const Page &t_page, double t_scale)
+{
+  create_image_surface(t_page, t_scale);
+
+  render_page(&t_page);
+  cairo_surface_flush(surface);
+
+  const int stride = cairo_image_surface_get_stride(surface);
+  const int height = cairo_image_surface_get_height(surface);
+  m_out->reserve(static_cast<size_t>(stride) * height / 4);
+  if (!png_palette::encode(
+          reinterpret_cast<const uint32_t *>(cairo_image_surface_get_data(surface)),
+          cairo_image_surface_get_width(surface), height, stride,
+          png_palette::pixel_format::cairo_argb32, m_palette, m_out))
+  {
+    cairo_surface_write_to_png_stream(surface, cairowrite_sink, m_out);
+  }
 
   cairo_destroy(cr);
   cairo_surface_destroy(surface);
 }
 
-void RendererCairoPng::get_data(const uint8_t **t_buf, size_t *t_size) const
-{
-  *t_buf = &m_render_data[0];
-  *t_size = m_render_data.size();
-}
-
 void RendererCairoPngBase64::render(const Page &t_page, double t_scale)
 {
   surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, t_page.size.x * t_scale,
@@ -420,8 +471,8 @@ void RendererCairoPngBase64::render(const Page &t_page, double t_scale)
 
   render_page(&t_page);
 
-  std::vector<unsigned char> png_buf;
-  cairo_surface_write_to_png_stream(surface, cairowrite_ucvec, &png_buf);
+  output_sink png_buf;
+  cairo_surface_write_to_png_stream(surface, cairowrite_sink, &png_buf);
   m_buf = base64_encode(png_buf.data(), png_buf.size());
   m_buf.insert(0, "data:image/png;base64,");  // potentially very expensive
 
@@ -437,8 +488,9 @@ void RendererCairoPngBase64::get_data(const uint8_t **t_buf, size_t *t_size) con
 
 void RendererCairoPdf::render(const Page &t_page, double t_scale)
 {
+  m_out->reserve(vector_size_hint(t_page));
   surface = cairo_pdf_surface_create_for_stream(
-      cairowrite_ucvec, &m_render_data, t_page.size.x * t_scale, t_page.size.y * t_scale);
+      cairowrite_sink, m_out, t_page.size.x * t_scale, t_page.size.y * t_scale);
 
   cr = cairo_create(surface);
 
@@ -450,16 +502,11 @@ void RendererCairoPdf::render(const Page &t_page, double t_scale)
   cairo_surface_destroy(surface);
 }
 
-void RendererCairoPdf::get_data(const uint8_t **t_buf, size_t *t_size) const
-{
-  *t_buf = &m_render_data[0];
-  *t_size = m_render_data.size();
-}
-
 void RendererCairoPs::render(const Page &t_page, double t_scale)
 {
+  m_out->reserve(vector_size_hint(t_page));
   surface = cairo_ps_surface_create_for_stream(
-      cairowrite_fmt, &m_os, t_page.size.x * t_scale, t_page.size.y * t_scale);
+      cairowrite_sink, m_out, t_page.size.x * t_scale, t_page.size.y * t_scale);
 
   cr = cairo_create(surface);
 
@@ -471,16 +518,12 @@ void RendererCairoPs::render(const Page &t_page, double t_scale)
   cairo_surface_destroy(surface);
 }
 
-void RendererCairoPs::get_data(const uint8_t **t_buf, size_t *t_size) const
-{
-  *t_buf = reinterpret_cast<const uint8_t *>(m_os.begin());
-  *t_size = m_os.size();
-}
 
 void RendererCairoEps::render(const Page &t_page, double t_scale)
 {
+  m_out->reserve(vector_size_hint(t_page));
   surface = cairo_ps_surface_create_for_stream(
-      cairowrite_fmt, &m_os, t_page.size.x * t_scale, t_page.size.y * t_scale);
+      cairowrite_sink, m_out, t_page.size.x * t_scale, t_page.size.y * t_scale);
   cairo_ps_surface_set_eps(surface, true);
 
   cr = cairo_create(surface);
@@ -493,32 +536,321 @@ void RendererCairoEps::render(const Page &t_page, double t_scale)
   cairo_surface_destroy(surface);
 }
 
-void RendererCairoEps::get_data(const uint8_t **t_buf, size_t *t_size) const
+
+RendererCairoDocument::~RendererCairoDocument() { RendererCairoDocument::finish(); }
+
+void RendererCairoDocument::get_data(const uint8_t **t_buf, size_t *t_size) const
 {
-  *t_buf = reinterpret_cast<const uint8_t *>(m_os.begin());
-  *t_size = m_os.size();
+  *t_buf = m_out->data();
+  *t_size = m_out->is_memory() ? m_out->size() : 0;
 }
 
-#ifndef UNIGD_NO_TIFF
+bool RendererCairoDocument::set_sink(output_sink *t_sink)
+{
+  m_out = t_sink;
+  return true;
+}
 
-// see: https://research.cs.wisc.edu/graphics/Courses/638-f1999/libtiff_tutorial.htm
-void RendererCairoTiff::render(const Page &t_page, double t_scale)
+void RendererCairoDocument::finish()
+{
+  // destroying the surface flushes the document to the sink
+  if (cr)
+  {
+    cairo_destroy(cr);
+    cr = nullptr;
+  }
+  if (surface)
+  {
+    cairo_surface_destroy(surface);
+    surface = nullptr;
+  }
+}
+
+void RendererCairoDocument::add_vector_page(const Page &t_page, double t_scale)
+{
+  cairo_save(cr);
+  cairo_scale(cr, t_scale, t_scale);
+  render_page(&t_page);
+  cairo_restore(cr);
+  cairo_show_page(cr);
+}
+
+void RendererCairoPdfDocument::add_page(const Page &t_page, double t_scale)
+{
+  if (!surface)
+  {
+    m_out->reserve(vector_size_hint(t_page));
+    surface = cairo_pdf_surface_create_for_stream(
+        cairowrite_sink, m_out, t_page.size.x * t_scale, t_page.size.y * t_scale);
+    cr = cairo_create(surface);
+  }
+  else
+  {
+    cairo_pdf_surface_set_size(surface, t_page.size.x * t_scale, t_page.size.y * t_scale);
+  }
+  add_vector_page(t_page, t_scale);
+}
+
+void RendererCairoPsDocument::add_page(const Page &t_page, double t_scale)
+{
+  if (!surface)
+  {
+    m_out->reserve(vector_size_hint(t_page));
+    surface = cairo_ps_surface_create_for_stream(
+        cairowrite_sink, m_out, t_page.size.x * t_scale, t_page.size.y * t_scale);
+    cr = cairo_create(surface);
+  }
+  else
+  {
+    cairo_ps_surface_set_size(surface, t_page.size.x * t_scale, t_page.size.y * t_scale);
+  }
+  add_vector_page(t_page, t_scale);
+}
+
+// Convert rows of a Cairo image surface (native endian premultiplied ARGB) to straight
+// RGBA bytes.
+static void argb32_to_rgba(cairo_surface_t *t_surface, int t_row_begin, int t_row_end,
+                           uint8_t *t_dst)
+{
+  const unsigned char *data = cairo_image_surface_get_data(t_surface);
+  const int stride = cairo_image_surface_get_stride(t_surface);
+  const int width = cairo_image_surface_get_width(t_surface);
+
+  for (int y = t_row_begin; y < t_row_end; ++y)
+  {
+    const auto *row = reinterpret_cast<const uint32_t *>(data + y * stride);
+    for (int x = 0; x < width; ++x)
+    {
+      const uint32_t argb = row[x];
+      const uint32_t a = argb >> 24;
+      if (a == 0xFF)
+      {
+        t_dst[0] = static_cast<uint8_t>(argb >> 16);
+        t_dst[1] = static_cast<uint8_t>(argb >> 8);
+        t_dst[2] = static_cast<uint8_t>(argb);
+        t_dst[3] = 0xFF;
+      }
+      else if (a != 0)
+      {
+        t_dst[0] = static_cast<uint8_t>((((argb >> 16) & 0xFF) * 255 + a / 2) / a);
+        t_dst[1] = static_cast<uint8_t>((((argb >> 8) & 0xFF) * 255 + a / 2) / a);
+        t_dst[2] = static_cast<uint8_t>(((argb & 0xFF) * 255 + a / 2) / a);
+        t_dst[3] = static_cast<uint8_t>(a);
+      }
+      else
+      {
+        t_dst[0] = t_dst[1] = t_dst[2] = t_dst[3] = 0;
+      }
+      t_dst += 4;
+    }
+  }
+}
+
+bool RendererCairoRgba::set_region(grect<int> t_region)
+{
+  return set_image_region(t_region);
+}
+
+void RendererCairoRgba::render(const Page &t_page, double t_scale)
+{
+  create_image_surface(t_page, t_scale);
+  render_page(&t_page);
+  cairo_surface_flush(surface);
+
+  const int width = cairo_image_surface_get_width(surface);
+  const int height = cairo_image_surface_get_height(surface);
+  const size_t row_size = static_cast<size_t>(width) * 4;
+
+  uint8_t header[12] = {'r', 'g', 'b', 'a'};
+  for (int i = 0; i < 4; ++i)
+  {
+    header[4 + i] = static_cast<uint8_t>(static_cast<uint32_t>(width) >> (24 - 8 * i));
+    header[8 + i] = static_cast<uint8_t>(static_cast<uint32_t>(height) >> (24 - 8 * i));
+  }
+  m_out->reserve(sizeof(header) + row_size * height);
+  m_out->write(header, sizeof(header));
+
+  std::vector<uint8_t> row(row_size);
+  for (int y = 0; y < height; ++y)
+  {
+    argb32_to_rgba(surface, y, y + 1, row.data());
+    m_out->write(row.data(), row_size);
+  }
+
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+}
+
+bool RendererCairoQoi::set_region(grect<int> t_region)
+{
+  return set_image_region(t_region);
+}
+
+void RendererCairoQoi::render(const Page &t_page, double t_scale)
+{
+  create_image_surface(t_page, t_scale);
+  render_page(&t_page);
+  cairo_surface_flush(surface);
+
+  const int width = cairo_image_surface_get_width(surface);
+  const int height = cairo_image_surface_get_height(surface);
+  std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+  argb32_to_rgba(surface, 0, height, rgba.data());
+
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+
+  m_out->reserve(rgba.size() / 4);
+  qoi::encode(rgba.data(), width, height, m_out);
+}
+
+bool TiffCompression::set_compression_option(const std::string &t_key,
+                                             const std::string &t_value)
+{
+  return tiff_codec::set_option(&m_options, t_key, t_value);
+}
+
+bool RendererCairoTiffTiled::set_option(const std::string &t_key,
+                                        const std::string &t_value)
+{
+  return set_compression_option(t_key, t_value);
+}
+
+void RendererCairoTiffTiled::render(const Page &t_page, double t_scale)
 {
-  const int argb_size = 4;
   const int width = t_page.size.x * t_scale;
   const int height = t_page.size.y * t_scale;
-  const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+  if (width <= 0 || height <= 0)
+  {
+    return;
+  }
+  const int band_height = tiled_tiff::tile_size;
 
-  std::vector<unsigned char> raw_buffer(stride * height);
-  surface = cairo_image_surface_create_for_data(raw_buffer.data(), CAIRO_FORMAT_ARGB32,
-                                                width, height, stride);
+  // Double buffered: one band is compressed while the next one is drawn. Each band
+  // only draws the draw calls that touch it.
+  cairo_surface_t *bands[2] = {nullptr, nullptr};
+  bool ok = true;
+  {
+    tiled_tiff::encoder encoder(m_out, width, height, m_options, async::worker_pool());
+    for (int y = 0, i = 0; ok && y < height; y += band_height, ++i)
+    {
+      // The tiles of band i - 2 were written by the last add_band()
+      if (bands[i % 2])
+      {
+        cairo_surface_destroy(bands[i % 2]);
+      }
+      set_image_region({0, y, width, band_height});
+      create_image_surface(t_page, t_scale);
+      render_page(&t_page);
+      cairo_surface_flush(surface);
+      cairo_destroy(cr);
+      cr = nullptr;
+      bands[i % 2] = surface;
+      surface = nullptr;
+
+      // Bands wider than cairo image surfaces allow fail here
+      ok = cairo_surface_status(bands[i % 2]) == CAIRO_STATUS_SUCCESS &&
+           encoder.add_band(cairo_image_surface_get_data(bands[i % 2]),
+                            cairo_image_surface_get_stride(bands[i % 2]));
+    }
+    ok = ok && encoder.finish();
+  }
+  set_image_region({0, 0, 0, 0});
+  for (auto *band : bands)
+  {
+    if (band)
+    {
+      cairo_surface_destroy(band);
+    }
+  }
+  if (!ok)
+  {
+    m_out->fail();
+  }
+}
 
-  cr = cairo_create(surface);
-  cairo_scale(cr, t_scale, t_scale);
-  render_page(&t_page);
+namespace
+{
+// Rasterizes a page into straight RGBA pixels, one instance per thread
+class CairoRasterizer : public RendererCairo
+{
+ public:
+  apng::frame rasterize(const Page &t_page, double t_scale)
+  {
+    const int width = t_page.size.x * t_scale;
+    const int height = t_page.size.y * t_scale;
+
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cr = cairo_create(surface);
+    cairo_scale(cr, t_scale, t_scale);
+    render_page(&t_page);
+    cairo_surface_flush(surface);
+
+    apng::frame f{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4)};
+    argb32_to_rgba(surface, 0, height, f.rgba.data());
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    cr = nullptr;
+    surface = nullptr;
+    return f;
+  }
+};
 
-  std::ostringstream tiff_ostream;
-  TIFF *tiff = TIFFStreamOpen("memory", &tiff_ostream);  // filename is ignored
+// 10 frames per second
+const uint16_t apng_delay_num = 1;
+const uint16_t apng_delay_den = 10;
+}  // namespace
+
+RendererCairoApngDocument::RendererCairoApngDocument()
+    : m_pool(async::worker_pool()), m_encoder(apng_delay_num, apng_delay_den, m_pool)
+{
+}
+
+void RendererCairoApngDocument::add_page(const Page &t_page, double t_scale)
+{
+  // The page store keeps the pages locked until finish() returns
+  const Page *page = &t_page;
+  m_frames.push_back(m_pool->submit(
+      [page, t_scale]()
+      {
+        CairoRasterizer rasterizer;
+        return rasterizer.rasterize(*page, t_scale);
+      }));
+  // Only a few frames are rasterized ahead of the encoder
+  while (m_frames.size() > m_pool->size())
+  {
+    m_encoder.add(std::make_shared<const apng::frame>(m_pool->get(m_frames.front())));
+    m_frames.pop_front();
+  }
+}
+
+void RendererCairoApngDocument::finish()
+{
+  for (; !m_frames.empty(); m_frames.pop_front())
+  {
+    m_encoder.add(std::make_shared<const apng::frame>(m_pool->get(m_frames.front())));
+  }
+
+  apng::encode_stats stats;
+  if (m_encoder.finish(m_out, &stats))
+  {
+    debug_print("[apng] %zu frames encoded in %.3fs\n", stats.frames, stats.seconds);
+  }
+}
+
+#ifndef UNIGD_NO_TIFF
+
+// see: https://research.cs.wisc.edu/graphics/Courses/638-f1999/libtiff_tutorial.htm
+// Strips are converted and compressed on the thread pool and written in order.
+static bool tiff_write_image(TIFF *tiff, const std::vector<unsigned char> &raw_buffer,
+                             int width, int height, int stride,
+                             const tiff_codec::options &options,
+                             async::thread_pool *pool)
+{
+  const int argb_size = 4;
+  // Large enough strips for good compression and little scheduling overhead
+  const size_t strip_target_bytes = 256 * 1024;
 
   TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, width);
   TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, height);
@@ -528,44 +860,142 @@ void RendererCairoTiff::render(const Page &t_page, double t_scale)
   TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
   TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 
-  // Used to be COMPRESSION_DEFLATE but:
+  // Deflate uses COMPRESSION_ADOBE_DEFLATE instead of COMPRESSION_DEFLATE:
   // TIFFWriteDirectorySec: Warning, Creating TIFF with legacy Deflate codec identifier,
   // COMPRESSION_ADOBE_DEFLATE is more widely supported.
-  TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+  TIFFSetField(tiff, TIFFTAG_COMPRESSION, tiff_codec::compression_tag(options));
+  if (tiff_codec::uses_predictor(options))
+  {
+    TIFFSetField(tiff, TIFFTAG_PREDICTOR, tiff_codec::predictor_tag(options));
+  }
   const uint16_t extras[] = {EXTRASAMPLE_ASSOCALPHA};
   TIFFSetField(tiff, TIFFTAG_EXTRASAMPLES, EXTRASAMPLE_ASSOCALPHA, extras);
-  TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tiff, width * argb_size));
 
-  std::vector<unsigned char> line(width * argb_size);
-  for (int row = 0; row < height; ++row)
+  const size_t row_bytes = static_cast<size_t>(width) * argb_size;
+  const int rows_per_strip =
+      static_cast<int>(std::max<size_t>(1, strip_target_bytes / row_bytes));
+  TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+
+  std::vector<std::future<std::vector<uint8_t>>> strips;
+  for (int y = 0; y < height; y += rows_per_strip)
   {
-    for (int x = 0; x < width * argb_size; x += argb_size)
-    {
-      const int raw_offset = stride * row + x;
-      line[x] = raw_buffer[raw_offset + 2];
-      line[x + 1] = raw_buffer[raw_offset + 1];
-      line[x + 2] = raw_buffer[raw_offset];
-      line[x + 3] = raw_buffer[raw_offset + 3];
-    }
-    if (TIFFWriteScanline(tiff, line.data(), row) < 0)
-    {
-      break;
-    }
+    const int rows = std::min(rows_per_strip, height - y);
+    strips.push_back(pool->submit(
+        [&, y, rows]()
+        {
+          std::vector<uint8_t> strip(row_bytes * rows);
+          for (int row = 0; row < rows; ++row)
+          {
+            const unsigned char *src =
+                raw_buffer.data() + static_cast<size_t>(stride) * (y + row);
+            uint8_t *dst = strip.data() + row_bytes * row;
+            for (size_t x = 0; x < row_bytes; x += argb_size)
+            {
+              dst[x] = src[x + 2];
+              dst[x + 1] = src[x + 1];
+              dst[x + 2] = src[x];
+              dst[x + 3] = src[x + 3];
+            }
+          }
+          return tiff_codec::encode(strip.data(), row_bytes, rows, argb_size, options);
+        }));
   }
 
+  // All strips are awaited, they reference raw_buffer
+  bool ok = true;
+  for (size_t i = 0; i < strips.size(); ++i)
+  {
+    auto data = pool->get(strips[i]);
+    ok = ok && TIFFWriteRawStrip(tiff, static_cast<uint32_t>(i), data.data(),
+                                 static_cast<tmsize_t>(data.size())) >= 0;
+  }
+  return ok;
+}
+
+bool RendererCairoTiff::set_option(const std::string &t_key, const std::string &t_value)
+{
+  return set_compression_option(t_key, t_value);
+}
+
+bool RendererCairoTiffDocument::set_option(const std::string &t_key,
+                                           const std::string &t_value)
+{
+  return set_compression_option(t_key, t_value);
+}
+
+void RendererCairoTiff::render(const Page &t_page, double t_scale)
+{
+  const int width = t_page.size.x * t_scale;
+  const int height = t_page.size.y * t_scale;
+  const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+
+  std::vector<unsigned char> raw_buffer(stride * height);
+  surface = cairo_image_surface_create_for_data(raw_buffer.data(), CAIRO_FORMAT_ARGB32,
+                                                width, height, stride);
+
+  cr = cairo_create(surface);
+  cairo_scale(cr, t_scale, t_scale);
+  render_page(&t_page);
+
+  std::ostringstream tiff_ostream;
+  TIFF *tiff = TIFFStreamOpen("memory", &tiff_ostream);  // filename is ignored
+  tiff_write_image(tiff, raw_buffer, width, height, stride, m_options,
+                   async::worker_pool());
   TIFFClose(tiff);
 
   cairo_destroy(cr);
   cairo_surface_destroy(surface);
 
+  // libtiff needs a seekable stream, so the result is written out in one piece
   const auto out = tiff_ostream.str();
-  m_render_data.assign(out.begin(), out.end());
+  m_out->write(reinterpret_cast<const uint8_t *>(out.data()), out.size());
+}
+
+RendererCairoTiffDocument::~RendererCairoTiffDocument()
+{
+  if (m_tiff)
+  {
+    TIFFClose(m_tiff);
+  }
+}
+
+void RendererCairoTiffDocument::add_page(const Page &t_page, double t_scale)
+{
+  const int width = t_page.size.x * t_scale;
+  const int height = t_page.size.y * t_scale;
+  const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+
+  std::vector<unsigned char> raw_buffer(stride * height);
+  surface = cairo_image_surface_create_for_data(raw_buffer.data(), CAIRO_FORMAT_ARGB32,
+                                                width, height, stride);
+
+  cr = cairo_create(surface);
+  cairo_scale(cr, t_scale, t_scale);
+  render_page(&t_page);
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+  cr = nullptr;
+  surface = nullptr;
+
+  if (!m_tiff)
+  {
+    m_tiff = TIFFStreamOpen("memory", &m_tiff_ostream);
+  }
+  tiff_write_image(m_tiff, raw_buffer, width, height, stride, m_options,
+                   async::worker_pool());
+  TIFFWriteDirectory(m_tiff);
 }
 
-void RendererCairoTiff::get_data(const uint8_t **t_buf, size_t *t_size) const
+void RendererCairoTiffDocument::finish()
 {
-  *t_buf = &m_render_data[0];
-  *t_size = m_render_data.size();
+  if (!m_tiff)
+  {
+    return;
+  }
+  TIFFClose(m_tiff);
+  m_tiff = nullptr;
+  const auto out = m_tiff_ostream.str();
+  m_out->write(reinterpret_cast<const uint8_t *>(out.data()), out.size());
 }
 
 #endif
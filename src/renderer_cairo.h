@@ -6,10 +6,22 @@
 #include <cairo.h>
 #include <fmt/format.h>
 
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#ifndef UNIGD_NO_TIFF
+typedef struct tiff TIFF;
+#endif
+
+#include "apng.h"
+#include "async_utils.h"
 #include "draw_data.h"
+#include "png_palette.h"
 #include "renderers.h"
+#include "tiff_codec.h"
 
 namespace unigd
 {
@@ -29,19 +41,83 @@ class RendererCairo : public draw_call_visitor
 
   void render_page(const Page *t_page);
 
+  // Only rasterize a region of image outputs, see render_target::set_region
+  bool set_image_region(grect<int> t_region);
+
  protected:
   cairo_surface_t *surface = nullptr;
   cairo_t *cr = nullptr;
+
+  // Create an image surface of the page or the region and set up cr
+  void create_image_surface(const Page &t_page, double t_scale);
+
+ private:
+  grect<int> m_region{0, 0, 0, 0};
+  // Region in page coordinates, draw calls outside of it are skipped
+  grect<double> m_cull{0, 0, 0, 0};
 };
 
-class RendererCairoPng : public render_target, public RendererCairo
+// Cairo targets that write a byte stream
+class RendererCairoStream : public render_target, public RendererCairo
 {
  public:
-  void render(const Page &t_page, double t_scale) override;
   void get_data(const uint8_t **t_buf, size_t *t_size) const override;
+  bool set_sink(output_sink *t_sink) override;
+
+ protected:
+  output_sink *m_out = &m_sink;
+
+ private:
+  output_sink m_sink;
+};
+
+// Indexed colour when the plot has few colours, see png_palette.h. Option "palette"
+// (exact, quantize, none).
+class RendererCairoPng : public RendererCairoStream
+{
+ public:
+  void render(const Page &t_page, double t_scale) override;
+  bool set_region(grect<int> t_region) override;
+  bool set_option(const std::string &t_key, const std::string &t_value) override;
 
  private:
-  std::vector<unsigned char> m_render_data{};
+  png_palette::mode m_palette{png_palette::mode::exact};
+};
+
+// Uncompressed straight RGBA. 12 byte header: "rgba", width and height as big
+// endian uint32.
+class RendererCairoRgba : public RendererCairoStream
+{
+ public:
+  void render(const Page &t_page, double t_scale) override;
+  bool set_region(grect<int> t_region) override;
+};
+
+class RendererCairoQoi : public RendererCairoStream
+{
+ public:
+  void render(const Page &t_page, double t_scale) override;
+  bool set_region(grect<int> t_region) override;
+};
+
+// Compression options of the TIFF renderers, segments are compressed on the package
+// worker pool.
+class TiffCompression
+{
+ protected:
+  tiff_codec::options m_options;
+
+  bool set_compression_option(const std::string &t_key, const std::string &t_value);
+};
+
+// Tiled TIFF for large exports. The page is rasterized in bands of tiles, so the
+// memory needed does not grow with the image height. Needs a seekable output, the
+// output fails if the image can not be encoded.
+class RendererCairoTiffTiled : public RendererCairoStream, TiffCompression
+{
+ public:
+  void render(const Page &t_page, double t_scale) override;
+  bool set_option(const std::string &t_key, const std::string &t_value) override;
 };
 
 class RendererCairoPngBase64 : public render_target, public RendererCairo
@@ -54,46 +130,91 @@ class RendererCairoPngBase64 : public render_target, public RendererCairo
   std::string m_buf;
 };
 
-class RendererCairoPdf : public render_target, public RendererCairo
+class RendererCairoPdf : public RendererCairoStream
 {
  public:
   void render(const Page &t_page, double t_scale) override;
-  void get_data(const uint8_t **t_buf, size_t *t_size) const override;
+};
 
- private:
-  std::vector<unsigned char> m_render_data{};
+class RendererCairoPs : public RendererCairoStream
+{
+ public:
+  void render(const Page &t_page, double t_scale) override;
 };
 
-class RendererCairoPs : public render_target, public RendererCairo
+class RendererCairoEps : public RendererCairoStream
 {
  public:
   void render(const Page &t_page, double t_scale) override;
+};
+
+// Multi-page documents
+
+class RendererCairoDocument : public document_target, public RendererCairo
+{
+ public:
+  ~RendererCairoDocument() override;
   void get_data(const uint8_t **t_buf, size_t *t_size) const override;
+  bool set_sink(output_sink *t_sink) override;
+  void finish() override;
+
+ protected:
+  output_sink *m_out = &m_sink;
+  void add_vector_page(const Page &t_page, double t_scale);
 
  private:
-  fmt::memory_buffer m_os;
+  output_sink m_sink;
 };
 
-class RendererCairoEps : public render_target, public RendererCairo
+class RendererCairoPdfDocument : public RendererCairoDocument
 {
  public:
-  void render(const Page &t_page, double t_scale) override;
-  void get_data(const uint8_t **t_buf, size_t *t_size) const override;
+  void add_page(const Page &t_page, double t_scale) override;
+};
+
+class RendererCairoPsDocument : public RendererCairoDocument
+{
+ public:
+  void add_page(const Page &t_page, double t_scale) override;
+};
+
+// Animated PNG with one frame per page. Frames are rasterized in parallel on the
+// shared worker pool and only the changed region of each frame is stored.
+class RendererCairoApngDocument : public RendererCairoDocument
+{
+ public:
+  RendererCairoApngDocument();
+  void add_page(const Page &t_page, double t_scale) override;
+  void finish() override;
 
  private:
-  fmt::memory_buffer m_os;
+  async::thread_pool *m_pool;
+  apng::encoder m_encoder;
+  // Frames being rasterized, in page order
+  std::deque<std::future<apng::frame>> m_frames;
 };
 
 #ifndef UNIGD_NO_TIFF
 
-class RendererCairoTiff : public render_target, public RendererCairo
+class RendererCairoTiff : public RendererCairoStream, TiffCompression
 {
  public:
   void render(const Page &t_page, double t_scale) override;
-  void get_data(const uint8_t **t_buf, size_t *t_size) const override;
+  bool set_option(const std::string &t_key, const std::string &t_value) override;
+};
+
+// One TIFF directory per page
+class RendererCairoTiffDocument : public RendererCairoDocument, TiffCompression
+{
+ public:
+  ~RendererCairoTiffDocument() override;
+  void add_page(const Page &t_page, double t_scale) override;
+  void finish() override;
+  bool set_option(const std::string &t_key, const std::string &t_value) override;
 
  private:
-  std::vector<unsigned char> m_render_data{};
+  std::ostringstream m_tiff_ostream;
+  TIFF *m_tiff = nullptr;
 };
 
 #endif /* UNIGD_NO_TIFF */
@@ -7,7 +7,6 @@
 
 #include "base_64.h"
 #include "compress.h"
-#include "uuid.h"
 
 namespace unigd
 {
@@ -556,7 +555,8 @@ RendererSVGPortable::RendererSVGPortable() : os() {}
 
 void RendererSVGPortable::render(const Page &t_page, double t_scale)
 {
-  m_unique_id = unigd::uuid::uuid();
+  // Identical clip IDs can only clash with identical clip regions
+  m_unique_id = fmt::format("{:016x}", t_page.content_hash);
   m_scale = t_scale;
   this->page(t_page);
 }
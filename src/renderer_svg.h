@@ -40,7 +40,8 @@ class RendererSVG : public render_target, public draw_call_visitor
  * Produces SVG that can directly be embedded in HTML documents
  * without causing ID conflicts at the expense of larger file size.
  * - Does not use style tags or CDATA embedded CSS.
- * - Appends random UUID to document-wide (clipPath) IDs.
+ * - Appends an ID derived from the page content to document-wide (clipPath) IDs.
+ *   Pages with identical content produce byte-identical output.
  */
 class RendererSVGPortable : public render_target, public draw_call_visitor
 {
@@ -1,6 +1,9 @@
 
 #include "renderers.h"
 
+#include <utility>
+#include <vector>
+
 #include "renderer_cairo.h"
 #include "renderer_json.h"
 #include "renderer_meta.h"
@@ -65,6 +68,18 @@ static std::unordered_map<std::string, renderer_map_entry> renderer_map = {
        false},
       []() { return std::make_unique<renderers::RendererCairoPng>(); }}},
 
+    {"rgba",
+     {{"rgba", "application/octet-stream", ".rgba", "RGBA", "plot",
+       "Uncompressed RGBA pixels with a 12 byte header ('rgba', big endian uint32 width "
+       "and height).",
+       false},
+      []() { return std::make_unique<renderers::RendererCairoRgba>(); }}},
+
+    {"qoi",
+     {{"qoi", "image/qoi", ".qoi", "QOI", "plot",
+       "Quite OK Image Format (QOI), fast lossless compression.", false},
+      []() { return std::make_unique<renderers::RendererCairoQoi>(); }}},
+
     {"png-base64",
      {{"png-base64", "text/plain", ".txt", "Base64 PNG", "plot",
        "Base64 encoded Portable Network Graphics (PNG).", true},
@@ -75,6 +90,12 @@ static std::unordered_map<std::string, renderer_map_entry> renderer_map = {
        "Adobe Portable Document Format (PDF).", false},
       []() { return std::make_unique<renderers::RendererCairoPdf>(); }}},
 
+    {"tiff-tiled",
+     {{"tiff-tiled", "image/tiff", ".tiff", "Tiled TIFF", "plot",
+       "Tiled Tagged Image File Format (TIFF) for large high resolution exports.",
+       false},
+      []() { return std::make_unique<renderers::RendererCairoTiffTiled>(); }}},
+
 #ifndef UNIGD_NO_TIFF
     {"tiff",
      {{"tiff", "image/tiff", ".tiff", "TIFF", "plot", "Tagged Image File Format (TIFF).",
@@ -85,15 +106,81 @@ static std::unordered_map<std::string, renderer_map_entry> renderer_map = {
 #endif /* UNIGD_NO_CAIRO */
 };
 
+namespace
+{
+using renderer_options = std::vector<std::pair<std::string, std::string>>;
+
+bool parse_options(const std::string &t_options, renderer_options *t_parsed)
+{
+  std::size_t begin = 0;
+  while (begin <= t_options.size())
+  {
+    auto end = t_options.find(',', begin);
+    if (end == std::string::npos)
+    {
+      end = t_options.size();
+    }
+    const auto eq = t_options.find('=', begin);
+    if (eq == std::string::npos || eq >= end || eq == begin)
+    {
+      return false;
+    }
+    t_parsed->emplace_back(t_options.substr(begin, eq - begin),
+                           t_options.substr(eq + 1, end - eq - 1));
+    begin = end + 1;
+  }
+  return true;
+}
+
+template <typename T>
+bool apply_options(T *t_renderer, const renderer_options &t_options)
+{
+  for (const auto &opt : t_options)
+  {
+    if (!t_renderer->set_option(opt.first, opt.second))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Splits the options from the ID and wraps the generator to apply them
+template <typename Gen>
+bool with_options(const std::string &t_options, Gen *t_generator)
+{
+  renderer_options options;
+  if (!parse_options(t_options, &options))
+  {
+    return false;
+  }
+  // Fail early on unsupported options
+  if (!apply_options((*t_generator)().get(), options))
+  {
+    return false;
+  }
+  const Gen generator = *t_generator;
+  *t_generator = [generator, options]()
+  {
+    auto renderer = generator();
+    apply_options(renderer.get(), options);
+    return renderer;
+  };
+  return true;
+}
+}  // namespace
+
 bool find(const std::string &id, renderer_map_entry *renderer)
 {
-  const auto it = renderer_map.find(id);
-  if (it != renderer_map.end())
+  const auto sep = id.find(':');
+  const auto it = renderer_map.find(id.substr(0, sep));
+  if (it == renderer_map.end())
   {
-    *renderer = it->second;
-    return true;
+    return false;
   }
-  return false;
+  *renderer = it->second;
+  return sep == std::string::npos ||
+         with_options(id.substr(sep + 1), &renderer->generator);
 }
 
 bool find_generator(const std::string &id, renderer_gen *renderer)
@@ -118,6 +205,29 @@ bool find_info(const std::string &id, unigd_renderer_info *renderer)
   return false;
 }
 
+static std::unordered_map<std::string, document_gen> document_map = {
+#ifndef UNIGD_NO_CAIRO
+    {"pdf", []() { return std::make_unique<renderers::RendererCairoPdfDocument>(); }},
+    {"ps", []() { return std::make_unique<renderers::RendererCairoPsDocument>(); }},
+    {"apng", []() { return std::make_unique<renderers::RendererCairoApngDocument>(); }},
+#ifndef UNIGD_NO_TIFF
+    {"tiff", []() { return std::make_unique<renderers::RendererCairoTiffDocument>(); }},
+#endif /* UNIGD_NO_TIFF */
+#endif /* UNIGD_NO_CAIRO */
+};
+
+bool find_document(const std::string &id, document_gen *renderer)
+{
+  const auto sep = id.find(':');
+  const auto it = document_map.find(id.substr(0, sep));
+  if (it == document_map.end())
+  {
+    return false;
+  }
+  *renderer = it->second;
+  return sep == std::string::npos || with_options(id.substr(sep + 1), renderer);
+}
+
 const std::unordered_map<std::string, renderer_map_entry> *renderers()
 {
   return &renderer_map;
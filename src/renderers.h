@@ -7,6 +7,7 @@
 #include <unordered_map>
 
 #include "draw_data.h"
+#include "output_sink.h"
 #include "unigd_external.h"
 
 namespace unigd
@@ -20,18 +21,51 @@ class render_target : public ex::render_data
 {
  public:
   virtual void render(const Page &t_page, double t_scale) = 0;
+
+  // Stream output directly to a sink instead of buffering it. Returns false if the
+  // renderer does not support streaming. get_data() is empty afterwards.
+  virtual bool set_sink(output_sink *t_sink) { return false; }
+
+  // Renderer specific option, returns false if the option is not supported.
+  virtual bool set_option(const std::string &t_key, const std::string &t_value)
+  {
+    return false;
+  }
+
+  // Rasterize only a region of the page, in output pixels. Returns false if the
+  // renderer does not support regions.
+  virtual bool set_region(grect<int> t_region) { return false; }
+};
+
+// Renders a sequence of pages into a single multi-page document.
+class document_target : public ex::render_data
+{
+ public:
+  virtual void add_page(const Page &t_page, double t_scale) = 0;
+  // Has to be called after the last page to complete the document.
+  virtual void finish() = 0;
+  virtual bool set_sink(output_sink *t_sink) { return false; }
+  virtual bool set_option(const std::string &t_key, const std::string &t_value)
+  {
+    return false;
+  }
 };
 
 using renderer_gen = std::function<std::unique_ptr<render_target>()>;
+using document_gen = std::function<std::unique_ptr<document_target>()>;
 struct renderer_map_entry
 {
   unigd_renderer_info info;
   renderer_gen generator;
 };
 
+// Renderer IDs can carry options: "<id>:<key>=<value>,<key>=<value>", for example
+// "tiff:compression=lzw,predictor=horizontal". Unsupported options fail the lookup.
 bool find(const std::string &id, renderer_map_entry *renderer);
 bool find_generator(const std::string &id, renderer_gen *renderer);
 bool find_info(const std::string &id, unigd_renderer_info *renderer);
+// Renderers that support multi-page documents
+bool find_document(const std::string &id, document_gen *renderer);
 const std::unordered_map<std::string, renderer_map_entry> *renderers();
 }  // namespace renderers
 
@@ -0,0 +1,154 @@
+#include "shm_region.h"
+
+#ifndef UNIGD_NO_SHM
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+
+namespace unigd
+{
+namespace
+{
+// Names are not predictable, so other users can not create the segment first.
+// Kept short, macOS allows at most 31 characters.
+std::string random_name()
+{
+  static std::mutex mutex;
+  static std::mt19937_64 rng{(static_cast<uint64_t>(std::random_device{}()) << 32) ^
+                             std::random_device{}()};
+  const std::lock_guard<std::mutex> lock(mutex);
+  char name[32];
+  std::snprintf(name, sizeof(name), "/unigd-%016llx",
+                static_cast<unsigned long long>(rng()));
+  return name;
+}
+
+std::atomic<uint64_t> *generation_of(uint8_t *t_data)
+{
+  return reinterpret_cast<std::atomic<uint64_t> *>(t_data);
+}
+
+std::atomic<uint64_t> *dropped_of(uint8_t *t_data)
+{
+  return reinterpret_cast<std::atomic<uint64_t> *>(t_data + 2 * sizeof(uint64_t));
+}
+}  // namespace
+
+constexpr size_t shm_region::header_size;
+
+shm_region::shm_region()
+{
+  const int attempts = 16;
+  for (int i = 0; i < attempts && m_fd < 0; ++i)
+  {
+    std::string name = random_name();
+    m_fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (m_fd >= 0)
+    {
+      m_name = std::move(name);
+    }
+    else if (errno != EEXIST)
+    {
+      break;
+    }
+  }
+  if (m_fd >= 0 && !reserve(header_size))
+  {
+    close(m_fd);
+    shm_unlink(m_name.c_str());
+    m_fd = -1;
+    m_name.clear();
+  }
+}
+
+shm_region::~shm_region()
+{
+  if (m_data)
+  {
+    dropped_of(m_data)->store(1, std::memory_order_release);
+    munmap(m_data, m_capacity);
+  }
+  if (m_fd >= 0)
+  {
+    close(m_fd);
+    shm_unlink(m_name.c_str());
+  }
+}
+
+uint8_t *shm_region::reserve(size_t t_capacity)
+{
+  if (m_fd < 0)
+  {
+    return nullptr;
+  }
+  if (t_capacity <= m_capacity)
+  {
+    return m_data;
+  }
+
+  // round up to whole pages
+  const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t capacity = (t_capacity + page_size - 1) / page_size * page_size;
+
+  if (ftruncate(m_fd, static_cast<off_t>(capacity)) != 0)
+  {
+    return nullptr;
+  }
+  if (m_data)
+  {
+    munmap(m_data, m_capacity);
+    m_data = nullptr;
+    m_capacity = 0;
+  }
+  void *mapped = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (mapped == MAP_FAILED)
+  {
+    return nullptr;
+  }
+  m_data = static_cast<uint8_t *>(mapped);
+  m_capacity = capacity;
+  return m_data;
+}
+
+void shm_region::begin_write()
+{
+  m_generation |= 1;
+  if (!m_data)
+  {
+    return;
+  }
+  generation_of(m_data)->store(m_generation, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+uint64_t shm_region::end_write(uint64_t t_size)
+{
+  if (!m_data)
+  {
+    return m_generation;
+  }
+  // The output may have moved the mapping, the header is written last
+  std::memcpy(m_data + sizeof(uint64_t), &t_size, sizeof(t_size));
+  m_generation++;
+  generation_of(m_data)->store(m_generation, std::memory_order_release);
+  return m_generation;
+}
+
+const std::string &shm_region::name() const { return m_name; }
+
+uint8_t *shm_region::data() const { return m_data; }
+
+size_t shm_region::capacity() const { return m_capacity; }
+
+}  // namespace unigd
+
+#endif /* UNIGD_NO_SHM */
@@ -0,0 +1,62 @@
+#ifndef __UNIGD_SHM_REGION_H__
+#define __UNIGD_SHM_REGION_H__
+
+#if defined(_WIN32) && !defined(UNIGD_NO_SHM)
+#define UNIGD_NO_SHM
+#endif
+
+#ifndef UNIGD_NO_SHM
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace unigd
+{
+// Named POSIX shared memory segment that can be grown. Other processes on the
+// same machine can map it by name. The segment is unlinked on destruction.
+//
+// Layout: generation (uint64), size (uint64), dropped flag (uint64), padding up to
+// header_size, output. The dropped flag is set to 1 before the segment is unlinked.
+// The generation is a sequence lock: it is odd while output is written and even
+// when the output is complete. Readers read the generation, copy the output and
+// read the generation again, the copy is valid if both are equal and even.
+class shm_region
+{
+ public:
+  static constexpr size_t header_size = 64;
+
+  // Creates a new segment with a random name, check name().empty() for failure
+  shm_region();
+  ~shm_region();
+
+  shm_region(const shm_region &) = delete;
+  shm_region &operator=(const shm_region &) = delete;
+
+  // Grow the segment to at least t_capacity bytes, returns the (possibly moved)
+  // mapping or nullptr on failure.
+  uint8_t *reserve(size_t t_capacity);
+
+  // Mark the output as being written (generation becomes odd)
+  void begin_write();
+  // Publish t_size bytes of output after the header, returns the new (even)
+  // generation.
+  uint64_t end_write(uint64_t t_size);
+
+  const std::string &name() const;
+  uint8_t *data() const;
+  size_t capacity() const;
+
+ private:
+  std::string m_name;
+  int m_fd{-1};
+  uint8_t *m_data{nullptr};
+  size_t m_capacity{0};
+  uint64_t m_generation{0};
+};
+
+}  // namespace unigd
+
+#endif /* UNIGD_NO_SHM */
+
+#endif /* __UNIGD_SHM_REGION_H__ */
@@ -0,0 +1,7 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+int main() {
+    int fd = shm_open("/unigd-sysdep", O_RDWR | O_CREAT, 0600);
+    shm_unlink("/unigd-sysdep");
+    return fd < 0;
+}
@@ -0,0 +1,211 @@
+#include "text_index.h"
+
+#include <algorithm>
+
+// Do not include any R headers here!
+
+namespace unigd
+{
+namespace
+{
+inline bool token_char(unsigned char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+         c == '_' || c >= 0x80;
+}
+
+inline char lower(unsigned char c)
+{
+  return static_cast<char>((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+}
+
+class text_collector : public renderers::draw_call_visitor
+{
+ public:
+  explicit text_collector(std::vector<const renderers::Text *> *t_texts) : m_texts(t_texts)
+  {
+  }
+
+  void visit(const renderers::Rect *) override {}
+  void visit(const renderers::Text *t_text) override { m_texts->push_back(t_text); }
+  void visit(const renderers::Circle *) override {}
+  void visit(const renderers::Line *) override {}
+  void visit(const renderers::Polyline *) override {}
+  void visit(const renderers::Polygon *) override {}
+  void visit(const renderers::Path *) override {}
+  void visit(const renderers::Raster *) override {}
+
+ private:
+  std::vector<const renderers::Text *> *m_texts;
+};
+}  // namespace
+
+std::vector<std::string> text_index::tokenize(const std::string &t_str)
+{
+  std::vector<std::string> tokens;
+  std::string token;
+  for (const unsigned char c : t_str)
+  {
+    if (token_char(c))
+    {
+      token.push_back(lower(c));
+    }
+    else if (!token.empty())
+    {
+      tokens.push_back(std::move(token));
+      token.clear();
+    }
+  }
+  if (!token.empty())
+  {
+    tokens.push_back(std::move(token));
+  }
+  return tokens;
+}
+
+void text_index::add(
+    renderers::page_id_t t_page,
+    const std::vector<std::shared_ptr<const renderers::DrawCall>> &t_dcs,
+    std::size_t t_offset)
+{
+  std::vector<const renderers::Text *> texts;
+  text_collector collector(&texts);
+  for (auto i = t_offset; i < t_dcs.size(); ++i)
+  {
+    t_dcs[i]->visit(&collector);
+  }
+  if (texts.empty())
+  {
+    return;
+  }
+
+  auto &page_entries = m_pages[t_page];
+  for (const auto *text : texts)
+  {
+    const auto pos = static_cast<uint32_t>(m_entries.size());
+    auto tokens = tokenize(text->str);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    if (tokens.empty())
+    {
+      continue;
+    }
+    m_entries.push_back({{t_page, text->pos, text->str}, true});
+    page_entries.push_back(pos);
+    for (const auto &token : tokens)
+    {
+      m_postings[token].push_back(pos);
+    }
+  }
+}
+
+void text_index::remove(renderers::page_id_t t_page)
+{
+  const auto it = m_pages.find(t_page);
+  if (it == m_pages.end())
+  {
+    return;
+  }
+  for (const auto pos : it->second)
+  {
+    m_entries[pos].alive = false;
+  }
+  m_dead += it->second.size();
+  m_pages.erase(it);
+
+  if (m_dead > 1024 && m_dead * 2 > m_entries.size())
+  {
+    m_compact();
+  }
+}
+
+void text_index::clear()
+{
+  m_entries.clear();
+  m_postings.clear();
+  m_pages.clear();
+  m_dead = 0;
+}
+
+std::vector<text_index::match> text_index::search(const std::string &t_query) const
+{
+  auto tokens = tokenize(t_query);
+  if (tokens.empty())
+  {
+    return {};
+  }
+
+  // Intersect starting with the rarest token
+  std::vector<const std::vector<uint32_t> *> lists;
+  for (const auto &token : tokens)
+  {
+    const auto it = m_postings.find(token);
+    if (it == m_postings.end())
+    {
+      return {};
+    }
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b)
+            { return a->size() < b->size(); });
+
+  std::vector<match> res;
+  for (const auto pos : *lists.front())
+  {
+    if (!m_entries[pos].alive)
+    {
+      continue;
+    }
+    const bool all = std::all_of(lists.begin() + 1, lists.end(),
+                                 [pos](const std::vector<uint32_t> *list)
+                                 { return std::binary_search(list->begin(), list->end(), pos); });
+    if (all)
+    {
+      res.push_back(m_entries[pos].m);
+    }
+  }
+  return res;
+}
+
+void text_index::m_compact()
+{
+  std::vector<uint32_t> remap(m_entries.size());
+  std::vector<entry> entries;
+  entries.reserve(m_entries.size() - m_dead);
+  for (std::size_t i = 0; i < m_entries.size(); ++i)
+  {
+    if (m_entries[i].alive)
+    {
+      remap[i] = static_cast<uint32_t>(entries.size());
+      entries.push_back(std::move(m_entries[i]));
+    }
+  }
+
+  const auto update = [&](std::vector<uint32_t> &list)
+  {
+    std::size_t n = 0;
+    for (const auto pos : list)
+    {
+      if (m_entries[pos].alive)
+      {
+        list[n++] = remap[pos];
+      }
+    }
+    list.resize(n);
+  };
+  for (auto it = m_postings.begin(); it != m_postings.end();)
+  {
+    update(it->second);
+    it = it->second.empty() ? m_postings.erase(it) : std::next(it);
+  }
+  for (auto &p : m_pages)
+  {
+    update(p.second);
+  }
+
+  m_entries = std::move(entries);
+  m_dead = 0;
+}
+
+}  // namespace unigd
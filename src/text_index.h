@@ -0,0 +1,55 @@
+#ifndef __UNIGD_TEXT_INDEX_H__
+#define __UNIGD_TEXT_INDEX_H__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "draw_data.h"
+
+namespace unigd
+{
+// Inverted index of the strings of text draw calls. Tokens are runs of letters,
+// digits, '_' and non-ASCII characters, matched case-insensitively (ASCII only).
+class text_index
+{
+ public:
+  struct match
+  {
+    renderers::page_id_t page;
+    gvertex<double> pos;
+    std::string str;
+  };
+
+  // Index the text draw calls of t_dcs
+  void add(renderers::page_id_t t_page,
+           const std::vector<std::shared_ptr<const renderers::DrawCall>> &t_dcs,
+           std::size_t t_offset);
+  void remove(renderers::page_id_t t_page);
+  void clear();
+
+  // Text draw calls that contain all tokens of t_query, in insertion order
+  std::vector<match> search(const std::string &t_query) const;
+
+  static std::vector<std::string> tokenize(const std::string &t_str);
+
+ private:
+  struct entry
+  {
+    match m;
+    bool alive;
+  };
+
+  std::vector<entry> m_entries;
+  // Token to entry positions (ascending)
+  std::unordered_map<std::string, std::vector<uint32_t>> m_postings;
+  std::unordered_map<renderers::page_id_t, std::vector<uint32_t>> m_pages;
+  std::size_t m_dead{0};
+
+  void m_compact();
+};
+
+}  // namespace unigd
+
+#endif /* __UNIGD_TEXT_INDEX_H__ */
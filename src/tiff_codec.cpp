@@ -0,0 +1,286 @@
+#include "tiff_codec.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+
+namespace unigd
+{
+namespace tiff_codec
+{
+namespace
+{
+const uint16_t compression_none = 1;
+const uint16_t compression_lzw = 5;
+const uint16_t compression_adobe_deflate = 8;
+const uint16_t compression_packbits = 32773;
+
+void apply_predictor(uint8_t *t_data, std::size_t t_row_bytes, std::size_t t_rows,
+                     int t_samples_per_pixel)
+{
+  for (std::size_t y = 0; y < t_rows; ++y)
+  {
+    uint8_t *row = t_data + y * t_row_bytes;
+    for (std::size_t i = t_row_bytes - 1; i >= static_cast<std::size_t>(t_samples_per_pixel);
+         --i)
+    {
+      row[i] = static_cast<uint8_t>(row[i] - row[i - t_samples_per_pixel]);
+    }
+  }
+}
+
+// Runs do not cross rows
+void packbits_row(const uint8_t *t_row, std::size_t t_size, std::vector<uint8_t> *t_out)
+{
+  std::size_t i = 0;
+  while (i < t_size)
+  {
+    std::size_t run = 1;
+    while (i + run < t_size && run < 128 && t_row[i + run] == t_row[i])
+    {
+      run++;
+    }
+    if (run >= 2)
+    {
+      t_out->push_back(static_cast<uint8_t>(1 - static_cast<int>(run)));
+      t_out->push_back(t_row[i]);
+      i += run;
+      continue;
+    }
+
+    // Literals until the next run of at least three bytes
+    std::size_t len = 1;
+    while (i + len < t_size && len < 128)
+    {
+      if (i + len + 2 < t_size && t_row[i + len] == t_row[i + len + 1] &&
+          t_row[i + len] == t_row[i + len + 2])
+      {
+        break;
+      }
+      len++;
+    }
+    t_out->push_back(static_cast<uint8_t>(len - 1));
+    t_out->insert(t_out->end(), t_row + i, t_row + i + len);
+    i += len;
+  }
+}
+
+// LZW as written by libtiff: MSB first codes of 9 to 12 bits, starts with a clear
+// code and the code width grows as soon as the next free code does not fit.
+class lzw_encoder
+{
+ public:
+  explicit lzw_encoder(std::vector<uint8_t> *t_out) : m_out(t_out) { m_reset(); }
+
+  void encode(const uint8_t *t_data, std::size_t t_size)
+  {
+    if (t_size == 0)
+    {
+      return;
+    }
+    m_put(code_clear);
+    uint32_t ent = t_data[0];
+    for (std::size_t i = 1; i < t_size; ++i)
+    {
+      const uint8_t c = t_data[i];
+      const uint32_t key = (ent << 8 | c) + 1;
+      std::size_t h = hash(key);
+      while (m_keys[h] != 0 && m_keys[h] != key)
+      {
+        h = (h + 1) & (table_size - 1);
+      }
+      if (m_keys[h] == key)
+      {
+        ent = m_codes[h];
+        continue;
+      }
+      m_put(ent);
+      ent = c;
+      m_keys[h] = key;
+      m_codes[h] = static_cast<uint16_t>(m_free++);
+      m_grow();
+    }
+    m_put(ent);
+    m_free++;
+    m_grow();
+    m_put(code_eoi);
+    if (m_nbits_pending > 0)
+    {
+      m_out->push_back(static_cast<uint8_t>(m_pending << (8 - m_nbits_pending)));
+    }
+  }
+
+ private:
+  static constexpr uint32_t code_clear = 256;
+  static constexpr uint32_t code_eoi = 257;
+  static constexpr uint32_t code_first = 258;
+  static constexpr uint32_t code_max = 4095;
+  static constexpr int bits_min = 9;
+  static constexpr std::size_t table_size = 8192;
+
+  std::vector<uint8_t> *m_out;
+  std::array<uint32_t, table_size> m_keys;
+  std::array<uint16_t, table_size> m_codes;
+  uint32_t m_free;
+  int m_nbits;
+  uint32_t m_pending{0};
+  int m_nbits_pending{0};
+
+  static std::size_t hash(uint32_t t_key)
+  {
+    return (t_key * 2654435761U >> 19) & (table_size - 1);
+  }
+
+  void m_reset()
+  {
+    m_keys.fill(0);
+    m_free = code_first;
+    m_nbits = bits_min;
+  }
+
+  void m_grow()
+  {
+    if (m_free == code_max - 1)
+    {
+      m_put(code_clear);
+      m_reset();
+    }
+    else if (m_free > (1U << m_nbits) - 1)
+    {
+      m_nbits++;
+    }
+  }
+
+  void m_put(uint32_t t_code)
+  {
+    m_pending = (m_pending << m_nbits) | t_code;
+    m_nbits_pending += m_nbits;
+    while (m_nbits_pending >= 8)
+    {
+      m_nbits_pending -= 8;
+      m_out->push_back(static_cast<uint8_t>(m_pending >> m_nbits_pending));
+    }
+    m_pending &= (1U << m_nbits_pending) - 1;
+  }
+};
+}  // namespace
+
+bool set_option(options *t_options, const std::string &t_key, const std::string &t_value)
+{
+  if (t_key == "compression")
+  {
+    if (t_value == "none")
+    {
+      t_options->codec = compression::none;
+    }
+    else if (t_value == "lzw")
+    {
+      t_options->codec = compression::lzw;
+    }
+    else if (t_value == "packbits")
+    {
+      t_options->codec = compression::packbits;
+    }
+    else if (t_value == "deflate")
+    {
+      t_options->codec = compression::deflate;
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+  if (t_key == "level")
+  {
+    if (t_value.size() != 1 || t_value[0] < '1' || t_value[0] > '9')
+    {
+      return false;
+    }
+    t_options->level = t_value[0] - '0';
+    return true;
+  }
+  if (t_key == "predictor")
+  {
+    if (t_value != "none" && t_value != "horizontal")
+    {
+      return false;
+    }
+    t_options->predictor = t_value == "horizontal";
+    return true;
+  }
+  return false;
+}
+
+uint16_t compression_tag(const options &t_options)
+{
+  switch (t_options.codec)
+  {
+    case compression::none:
+      return compression_none;
+    case compression::lzw:
+      return compression_lzw;
+    case compression::packbits:
+      return compression_packbits;
+    case compression::deflate:
+    default:
+      return compression_adobe_deflate;
+  }
+}
+
+bool uses_predictor(const options &t_options)
+{
+  return t_options.predictor && (t_options.codec == compression::lzw ||
+                                 t_options.codec == compression::deflate);
+}
+
+uint16_t predictor_tag(const options &t_options) { return uses_predictor(t_options) ? 2 : 1; }
+
+std::size_t max_encoded_size(std::size_t t_size) { return t_size + t_size / 2 + 64; }
+
+std::vector<uint8_t> encode(uint8_t *t_data, std::size_t t_row_bytes, std::size_t t_rows,
+                            int t_samples_per_pixel, const options &t_options)
+{
+  const std::size_t size = t_row_bytes * t_rows;
+  if (uses_predictor(t_options))
+  {
+    apply_predictor(t_data, t_row_bytes, t_rows, t_samples_per_pixel);
+  }
+
+  std::vector<uint8_t> out;
+  switch (t_options.codec)
+  {
+    case compression::none:
+      out.assign(t_data, t_data + size);
+      break;
+    case compression::lzw:
+    {
+      out.reserve(size / 2);
+      lzw_encoder(&out).encode(t_data, size);
+      break;
+    }
+    case compression::packbits:
+      out.reserve(size / 4);
+      for (std::size_t y = 0; y < t_rows; ++y)
+      {
+        packbits_row(t_data + y * t_row_bytes, t_row_bytes, &out);
+      }
+      break;
+    case compression::deflate:
+    {
+      uLongf out_size = compressBound(size);
+      out.resize(out_size);
+      if (compress2(out.data(), &out_size, t_data, size, t_options.level) != Z_OK)
+      {
+        return {};
+      }
+      out.resize(out_size);
+      break;
+    }
+  }
+  return out;
+}
+
+}  // namespace tiff_codec
+}  // namespace unigd
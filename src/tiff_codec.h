@@ -0,0 +1,50 @@
+#ifndef __UNIGD_TIFF_CODEC_H__
+#define __UNIGD_TIFF_CODEC_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace unigd
+{
+// Compression of TIFF strips and tiles. Segments are encoded independently, so they
+// can be compressed concurrently and written with TIFFWriteRawStrip() or similar.
+namespace tiff_codec
+{
+enum class compression
+{
+  none,
+  lzw,
+  packbits,
+  deflate
+};
+
+struct options
+{
+  compression codec{compression::deflate};
+  int level{-1};           // deflate level 1-9, -1 is the zlib default
+  bool predictor{false};  // horizontal differencing (LZW and deflate only)
+};
+
+// Renderer options: "compression" (none, lzw, packbits, deflate), "level" (1-9) and
+// "predictor" (none, horizontal). Returns false for unknown keys or values.
+bool set_option(options *t_options, const std::string &t_key, const std::string &t_value);
+
+// Values of TIFFTAG_COMPRESSION and TIFFTAG_PREDICTOR
+uint16_t compression_tag(const options &t_options);
+uint16_t predictor_tag(const options &t_options);
+bool uses_predictor(const options &t_options);
+
+// Upper bound of the encoded size of t_size bytes
+std::size_t max_encoded_size(std::size_t t_size);
+
+// Encode a segment of t_rows rows with 8 bit samples. When a predictor is used
+// t_data is overwritten with the differences.
+std::vector<uint8_t> encode(uint8_t *t_data, std::size_t t_row_bytes, std::size_t t_rows,
+                            int t_samples_per_pixel, const options &t_options);
+
+}  // namespace tiff_codec
+}  // namespace unigd
+
+#endif /* __UNIGD_TIFF_CODEC_H__ */
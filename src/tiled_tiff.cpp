@@ -0,0 +1,254 @@
+#include "tiled_tiff.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace unigd
+{
+namespace tiled_tiff
+{
+namespace
+{
+const int bytes_per_pixel = 4;
+const std::size_t tile_bytes = tile_size * tile_size * bytes_per_pixel;
+
+// Field types
+const uint16_t type_short = 3;
+const uint16_t type_long = 4;
+const uint16_t type_long8 = 16;
+
+// Tags
+const uint16_t tag_image_width = 256;
+const uint16_t tag_image_length = 257;
+const uint16_t tag_bits_per_sample = 258;
+const uint16_t tag_compression = 259;
+const uint16_t tag_photometric = 262;
+const uint16_t tag_orientation = 274;
+const uint16_t tag_samples_per_pixel = 277;
+const uint16_t tag_planar_config = 284;
+const uint16_t tag_predictor = 317;
+const uint16_t tag_tile_width = 322;
+const uint16_t tag_tile_length = 323;
+const uint16_t tag_tile_offsets = 324;
+const uint16_t tag_tile_byte_counts = 325;
+const uint16_t tag_extra_samples = 338;
+
+const uint16_t photometric_rgb = 2;
+const uint16_t orientation_topleft = 1;
+const uint16_t planar_config_contig = 1;
+const uint16_t extra_samples_assoc_alpha = 1;
+
+inline void put_le(std::vector<uint8_t> *t_buf, uint64_t t_value, int t_bytes)
+{
+  for (int i = 0; i < t_bytes; ++i)
+  {
+    t_buf->push_back(static_cast<uint8_t>(t_value >> (8 * i)));
+  }
+}
+
+inline int type_size(uint16_t t_type)
+{
+  return t_type == type_short ? 2 : (t_type == type_long ? 4 : 8);
+}
+
+struct entry
+{
+  uint16_t tag;
+  uint16_t type;
+  std::vector<uint64_t> values;
+};
+
+// Converts a tile to RGBA and compresses it. Tiles at the right and bottom edge are
+// padded with transparent pixels.
+std::vector<uint8_t> compress_tile(const uint8_t *t_argb, std::size_t t_stride,
+                                   uint32_t t_x, uint32_t t_width, uint32_t t_height,
+                                   const tiff_codec::options &t_options)
+{
+  std::vector<uint8_t> tile(tile_bytes, 0);
+  for (uint32_t y = 0; y < t_height; ++y)
+  {
+    const uint8_t *src = t_argb + y * t_stride + t_x * bytes_per_pixel;
+    uint8_t *dst = tile.data() + y * tile_size * bytes_per_pixel;
+    for (uint32_t x = 0; x < t_width; ++x)
+    {
+      uint32_t px;
+      std::memcpy(&px, src + x * bytes_per_pixel, sizeof(px));
+      dst[x * bytes_per_pixel] = static_cast<uint8_t>(px >> 16);
+      dst[x * bytes_per_pixel + 1] = static_cast<uint8_t>(px >> 8);
+      dst[x * bytes_per_pixel + 2] = static_cast<uint8_t>(px);
+      dst[x * bytes_per_pixel + 3] = static_cast<uint8_t>(px >> 24);
+    }
+  }
+  return tiff_codec::encode(tile.data(), tile_size * bytes_per_pixel, tile_size,
+                            bytes_per_pixel, t_options);
+}
+}  // namespace
+
+encoder::encoder(output_sink *t_out, uint32_t t_width, uint32_t t_height,
+                 const tiff_codec::options &t_options, async::thread_pool *t_pool)
+    : m_out(t_out),
+      m_pool(t_pool),
+      m_options(t_options),
+      m_width(t_width),
+      m_height(t_height),
+      m_tiles_across((t_width + tile_size - 1) / tile_size),
+      m_tiles_down((t_height + tile_size - 1) / tile_size)
+{
+  const uint64_t tiles = static_cast<uint64_t>(m_tiles_across) * m_tiles_down;
+  const uint64_t max_size = tiles * (tiff_codec::max_encoded_size(tile_bytes) + 16) + 4096;
+  m_bigtiff = max_size > std::numeric_limits<uint32_t>::max();
+
+  m_tile_offsets.reserve(tiles);
+  m_tile_byte_counts.reserve(tiles);
+
+  // First directory offset is patched in finish()
+  std::vector<uint8_t> header = {'I', 'I'};
+  if (m_bigtiff)
+  {
+    put_le(&header, 43, 2);
+    put_le(&header, 8, 2);
+    put_le(&header, 0, 2);
+    put_le(&header, 0, 8);
+  }
+  else
+  {
+    put_le(&header, 42, 2);
+    put_le(&header, 0, 4);
+  }
+  m_out->write(header.data(), header.size());
+}
+
+encoder::~encoder()
+{
+  // Pending tasks still reference the last band
+  for (auto &f : m_pending)
+  {
+    m_pool->get(f);
+  }
+}
+
+bool encoder::bigtiff() const { return m_bigtiff; }
+
+bool encoder::add_band(const uint8_t *t_argb, std::size_t t_stride)
+{
+  if (m_band >= m_tiles_down)
+  {
+    return false;
+  }
+  const uint32_t rows = std::min(tile_size, m_height - m_band * tile_size);
+
+  std::vector<std::future<std::vector<uint8_t>>> band;
+  band.reserve(m_tiles_across);
+  for (uint32_t tx = 0; tx < m_tiles_across; ++tx)
+  {
+    const uint32_t x = tx * tile_size;
+    const uint32_t width = std::min(tile_size, m_width - x);
+    const auto &options = m_options;
+    band.push_back(m_pool->submit(
+        [=, &options]()
+        { return compress_tile(t_argb, t_stride, x, width, rows, options); }));
+  }
+
+  // Previous band is written while this one is compressed
+  const bool ok = m_write_pending();
+  m_pending = std::move(band);
+  m_band++;
+  return ok;
+}
+
+bool encoder::m_write_pending()
+{
+  bool ok = true;
+  for (auto &f : m_pending)
+  {
+    const auto data = m_pool->get(f);
+    ok = ok && !data.empty();
+    m_tile_offsets.push_back(m_out->size());
+    m_tile_byte_counts.push_back(data.size());
+    m_out->write(data.data(), data.size());
+  }
+  m_pending.clear();
+  return ok && m_out->ok();
+}
+
+bool encoder::finish()
+{
+  if (!m_write_pending() || m_band != m_tiles_down)
+  {
+    return false;
+  }
+
+  // Values and directory start on 8 byte boundaries
+  std::vector<uint8_t> tail((8 - m_out->size() % 8) % 8, 0);
+
+  const uint16_t offset_type = m_bigtiff ? type_long8 : type_long;
+  const std::vector<entry> entries = {
+      {tag_image_width, type_long, {m_width}},
+      {tag_image_length, type_long, {m_height}},
+      {tag_bits_per_sample, type_short, {8, 8, 8, 8}},
+      {tag_compression, type_short, {tiff_codec::compression_tag(m_options)}},
+      {tag_photometric, type_short, {photometric_rgb}},
+      {tag_orientation, type_short, {orientation_topleft}},
+      {tag_samples_per_pixel, type_short, {bytes_per_pixel}},
+      {tag_planar_config, type_short, {planar_config_contig}},
+      {tag_predictor, type_short, {tiff_codec::predictor_tag(m_options)}},
+      {tag_tile_width, type_long, {tile_size}},
+      {tag_tile_length, type_long, {tile_size}},
+      {tag_tile_offsets, offset_type, m_tile_offsets},
+      {tag_tile_byte_counts, offset_type, m_tile_byte_counts},
+      {tag_extra_samples, type_short, {extra_samples_assoc_alpha}}};
+
+  const int value_size = m_bigtiff ? 8 : 4;
+  const int offset_size = m_bigtiff ? 8 : 4;
+
+  // Values that do not fit into the directory entry are stored before the directory
+  std::vector<uint64_t> value_offsets(entries.size(), 0);
+  for (std::size_t i = 0; i < entries.size(); ++i)
+  {
+    const auto &e = entries[i];
+    const std::size_t size = e.values.size() * type_size(e.type);
+    if (size <= static_cast<std::size_t>(value_size))
+    {
+      continue;
+    }
+    value_offsets[i] = m_out->size() + tail.size();
+    for (const auto v : e.values)
+    {
+      put_le(&tail, v, type_size(e.type));
+    }
+    tail.resize(tail.size() + (8 - tail.size() % 8) % 8, 0);
+  }
+
+  const uint64_t ifd_offset = m_out->size() + tail.size();
+  put_le(&tail, entries.size(), m_bigtiff ? 8 : 2);
+  for (std::size_t i = 0; i < entries.size(); ++i)
+  {
+    const auto &e = entries[i];
+    put_le(&tail, e.tag, 2);
+    put_le(&tail, e.type, 2);
+    put_le(&tail, e.values.size(), offset_size);
+    const std::size_t size = e.values.size() * type_size(e.type);
+    if (size <= static_cast<std::size_t>(value_size))
+    {
+      for (const auto v : e.values)
+      {
+        put_le(&tail, v, type_size(e.type));
+      }
+      tail.resize(tail.size() + value_size - size, 0);
+    }
+    else
+    {
+      put_le(&tail, value_offsets[i], offset_size);
+    }
+  }
+  put_le(&tail, 0, offset_size);  // no next directory
+  m_out->write(tail.data(), tail.size());
+
+  std::vector<uint8_t> first_ifd;
+  put_le(&first_ifd, ifd_offset, offset_size);
+  return m_out->patch(m_bigtiff ? 8 : 4, first_ifd.data(), first_ifd.size());
+}
+
+}  // namespace tiled_tiff
+}  // namespace unigd
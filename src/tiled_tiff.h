@@ -0,0 +1,64 @@
+#ifndef __UNIGD_TILED_TIFF_H__
+#define __UNIGD_TILED_TIFF_H__
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "async_utils.h"
+#include "output_sink.h"
+#include "tiff_codec.h"
+
+namespace unigd
+{
+// Streaming encoder for tiled RGBA TIFF images.
+// See: https://www.itu.int/itudoc/itu-t/com16/tiff-fx/docs/tiff6.pdf
+namespace tiled_tiff
+{
+constexpr uint32_t tile_size = 256;
+
+// The image is passed in bands of tile_size rows. Tiles of a band are compressed on
+// the thread pool while the caller produces the next band, so at most two bands are
+// held in memory. BigTIFF is written when the output could exceed 4 GB.
+// The image directory follows the tile data and the header is patched when
+// finished, the sink needs to support output_sink::patch().
+class encoder
+{
+ public:
+  encoder(output_sink *t_out, uint32_t t_width, uint32_t t_height,
+          const tiff_codec::options &t_options, async::thread_pool *t_pool);
+  ~encoder();
+
+  encoder(const encoder &) = delete;
+  encoder &operator=(const encoder &) = delete;
+
+  // Premultiplied 32 bit ARGB pixels in native byte order (as in cairo image
+  // surfaces). The band has to stay valid until the next call to add_band() or
+  // finish() returns.
+  bool add_band(const uint8_t *t_argb, std::size_t t_stride);
+  bool finish();
+
+  bool bigtiff() const;
+
+ private:
+  output_sink *m_out;
+  async::thread_pool *m_pool;
+  tiff_codec::options m_options;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_tiles_across;
+  uint32_t m_tiles_down;
+  uint32_t m_band{0};
+  bool m_bigtiff;
+
+  std::vector<std::future<std::vector<uint8_t>>> m_pending;
+  std::vector<uint64_t> m_tile_offsets;
+  std::vector<uint64_t> m_tile_byte_counts;
+
+  bool m_write_pending();
+};
+
+}  // namespace tiled_tiff
+}  // namespace unigd
+
+#endif /* __UNIGD_TILED_TIFF_H__ */
@@ -1,6 +1,8 @@
 #include <algorithm>  // std::max
+#include <cstdio>
 #include <cpp11/as.hpp>
 #include <cpp11/data_frame.hpp>
+#include <cpp11/doubles.hpp>
 #include <cpp11/function.hpp>
 #include <cpp11/integers.hpp>
 #include <cpp11/list.hpp>
@@ -12,7 +14,9 @@
 #include <vector>
 
 #include "debug_print.h"
+#include "device_pool.h"
 #include "generic_dev.h"
+#include "output_sink.h"
 #include "r_thread.h"
 #include "renderer_svg.h"
 #include "renderers.h"
@@ -32,18 +36,45 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
   return a;
 }
 
+// Without history, plots can not be replayed at a different size
+[[noreturn]] inline void stop_render_failed(
+    const std::shared_ptr<unigd::unigd_device> &t_dev)
+{
+  if (!t_dev->history_enabled())
+  {
+    cpp11::stop(
+        "Plot does not exist or can not be resized (device started with `history = "
+        "FALSE`).");
+  }
+  cpp11::stop("Plot does not exist.");
+}
+
 }  // namespace
 
 [[cpp11::register]] int unigd_ugd_(std::string bg, double width, double height,
-                                   double pointsize, cpp11::list aliases, bool reset_par)
+                                   double pointsize, cpp11::list aliases, bool reset_par,
+                                   bool history, std::string store_file)
 {
   int ibg = R_GE_str2col(bg.c_str());
 
-  const unigd::device_params dparams{ibg, width, height, pointsize, aliases, reset_par};
+  const unigd::device_params dparams{ibg,     width,     height,  pointsize,
+                                     aliases, reset_par, history, store_file};
 
   return std::make_shared<unigd::unigd_device>(dparams)->create("unigd");
 }
 
+[[cpp11::register]] int unigd_ugd_inline_(std::string bg, double width, double height,
+                                          double pointsize, cpp11::list aliases,
+                                          bool reset_par, bool history, std::string key)
+{
+  int ibg = R_GE_str2col(bg.c_str());
+
+  const unigd::device_params dparams{ibg,     width,     height, pointsize,
+                                     aliases, reset_par, history, ""};
+
+  return unigd::device_pool::open(key, dparams);
+}
+
 [[cpp11::register]] cpp11::list unigd_state_(int devnum)
 {
   auto dev = validate_unigddev(devnum);
@@ -62,9 +93,33 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
     client_info = R_NilValue;
   }
 
+  const auto snapshots = dev->plt_snapshot_stats();
+  const auto blocks = dev->plt_block_stats();
+  const auto render_queue = dev->plt_render_queue_stats();
+
   using namespace cpp11::literals;
-  return cpp11::writable::list{"hsize"_nm = state.hsize, "upid"_nm = state.upid,
-                               "active"_nm = state.active, "client"_nm = client_info};
+  return cpp11::writable::list{
+      "hsize"_nm = state.hsize, "upid"_nm = state.upid, "active"_nm = state.active,
+      "client"_nm = client_info,
+      "snapshots"_nm = cpp11::writable::list{
+          "packed"_nm = static_cast<double>(snapshots.packed),
+          "raw_bytes"_nm = static_cast<double>(snapshots.raw_bytes),
+          "compressed_bytes"_nm = static_cast<double>(snapshots.compressed_bytes),
+          "restores"_nm = static_cast<double>(snapshots.restores),
+          "restore_seconds"_nm = snapshots.restore_seconds},
+      "blocks"_nm = cpp11::writable::list{
+          "blocks"_nm = static_cast<double>(blocks.blocks),
+          "deduplicated"_nm = static_cast<double>(blocks.deduplicated)},
+      "render_queue"_nm = cpp11::writable::list{
+          "workers"_nm = static_cast<int>(render_queue.limit.workers),
+          "queue"_nm = static_cast<int>(render_queue.limit.queue),
+          "client_queue"_nm = static_cast<int>(render_queue.limit.client_queue),
+          "running"_nm = static_cast<int>(render_queue.running),
+          "queued"_nm = static_cast<int>(render_queue.queued),
+          "clients"_nm = static_cast<int>(render_queue.clients),
+          "peak_queued"_nm = static_cast<int>(render_queue.peak_queued),
+          "admitted"_nm = static_cast<double>(render_queue.admitted),
+          "rejected"_nm = static_cast<double>(render_queue.rejected)}};
 }
 
 [[cpp11::register]] cpp11::list unigd_info_(int devnum)
@@ -133,6 +188,18 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
     zoom = 1;
   }
 
+  if (unigd::render_cost::is_auto(renderer_id))
+  {
+    const char *selected;
+    unigd::render_cost::estimate estimate;
+    if (!dev->plt_estimate(renderer_id.c_str(), page, width / zoom, height / zoom, zoom,
+                           &selected, &estimate))
+    {
+      cpp11::stop("Could not select a renderer.");
+    }
+    renderer_id = selected;
+  }
+
   unigd::renderers::renderer_map_entry ren;
   auto fi_renderer = unigd::renderers::find(renderer_id, &ren);
   if (!fi_renderer)
@@ -142,7 +209,7 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
   auto renderer = ren.generator();
   if (!dev->plt_render(page, width / zoom, height / zoom, renderer.get(), zoom))
   {
-    cpp11::stop("Plot does not exist.");
+    stop_render_failed(dev);
   }
 
   const uint8_t *buf;
@@ -159,6 +226,65 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
   }
 }
 
+[[cpp11::register]] bool unigd_save_(int devnum, int page, double width, double height,
+                                     double zoom, std::string renderer_id,
+                                     std::string file)
+{
+  auto dev = validate_unigddev(devnum);
+
+  if (width < 0 || height < 0)
+  {
+    zoom = 1;
+  }
+
+  unigd::renderers::renderer_map_entry ren;
+  auto fi_renderer = unigd::renderers::find(renderer_id, &ren);
+  if (!fi_renderer)
+  {
+    cpp11::stop("Not a valid renderer ID.");
+  }
+
+  // Written next to the target and renamed when complete, so a failed render does
+  // not truncate an existing file
+  const std::string part = file + ".part";
+  std::FILE *f = std::fopen(part.c_str(), "wb");
+  if (!f)
+  {
+    cpp11::stop("Could not open file.");
+  }
+
+  // Streaming renderers write directly to the file
+  unigd::output_sink sink(fileno(f));
+  auto renderer = ren.generator();
+  const bool streaming = renderer->set_sink(&sink);
+  if (!dev->plt_render(page, width / zoom, height / zoom, renderer.get(), zoom))
+  {
+    std::fclose(f);
+    std::remove(part.c_str());
+    stop_render_failed(dev);
+  }
+  if (!streaming)
+  {
+    const uint8_t *buf;
+    size_t buf_size;
+    renderer->get_data(&buf, &buf_size);
+    sink.write(buf, buf_size);
+  }
+  bool ok = sink.ok();
+  ok = std::fclose(f) == 0 && ok;
+  if (ok && std::rename(part.c_str(), file.c_str()) != 0)
+  {
+    // Windows does not replace existing files
+    ok = std::remove(file.c_str()) == 0 && std::rename(part.c_str(), file.c_str()) == 0;
+  }
+  if (!ok)
+  {
+    std::remove(part.c_str());
+    cpp11::stop("Could not write file.");
+  }
+  return true;
+}
+
 [[cpp11::register]] bool unigd_remove_(int devnum, int page)
 {
   auto dev = validate_unigddev(devnum);
@@ -194,7 +320,7 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
 
   for (std::size_t i = 0; i < res.ids.size(); ++i)
   {
-    cpp11::writable::list p{"id"_nm = res.ids[i]};
+    cpp11::writable::list p{"id"_nm = res.ids[i], "version"_nm = res.versions[i]};
     p.attr("class") = "unigd_pid";
     plots[i] = p;
   }
@@ -202,6 +328,155 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
   return {"state"_nm = state, "plots"_nm = plots};
 }
 
+[[cpp11::register]] cpp11::writable::data_frame unigd_plots_(int devnum, int page,
+                                                             int limit)
+{
+  auto dev = validate_unigddev(devnum);
+
+  limit = std::max(limit, 0);
+  const auto res = dev->plt_info(page, limit);
+
+  using namespace cpp11::literals;
+
+  const R_xlen_t n = res.entries.size();
+  cpp11::writable::integers p_id(n);
+  cpp11::writable::integers p_index(n);
+  cpp11::writable::integers p_version(n);
+  cpp11::writable::doubles p_width(n);
+  cpp11::writable::doubles p_height(n);
+  cpp11::writable::doubles p_draw_calls(n);
+  cpp11::writable::doubles p_clips(n);
+  cpp11::writable::doubles p_raster_bytes(n);
+  cpp11::writable::doubles p_last_render(n);
+
+  for (R_xlen_t i = 0; i < n; ++i)
+  {
+    const auto &e = res.entries[i];
+    p_id[i] = e.id;
+    p_index[i] = e.index + 1;
+    p_version[i] = static_cast<int>(e.version);
+    p_width[i] = e.width;
+    p_height[i] = e.height;
+    p_draw_calls[i] = static_cast<double>(e.draw_calls);
+    p_clips[i] = static_cast<double>(e.clips);
+    p_raster_bytes[i] = static_cast<double>(e.raster_bytes);
+    p_last_render[i] = e.last_render > 0 ? e.last_render : NA_REAL;
+  }
+
+  return cpp11::writable::data_frame(
+      {"id"_nm = p_id, "index"_nm = p_index, "version"_nm = p_version,
+       "width"_nm = p_width, "height"_nm = p_height, "draw_calls"_nm = p_draw_calls,
+       "clips"_nm = p_clips, "raster_bytes"_nm = p_raster_bytes,
+       "last_render"_nm = p_last_render});
+}
+
+[[cpp11::register]] cpp11::writable::data_frame unigd_search_(int devnum,
+                                                              std::string query,
+                                                              int limit)
+{
+  auto dev = validate_unigddev(devnum);
+
+  limit = std::max(limit, 0);
+  const auto res = dev->plt_search(query, limit);
+
+  using namespace cpp11::literals;
+
+  const R_xlen_t n = res.matches.size();
+  cpp11::writable::integers p_id(n);
+  cpp11::writable::integers p_index(n);
+  cpp11::writable::doubles p_x(n);
+  cpp11::writable::doubles p_y(n);
+  cpp11::writable::strings p_text(n);
+
+  for (R_xlen_t i = 0; i < n; ++i)
+  {
+    const auto &m = res.matches[i];
+    p_id[i] = m.id;
+    p_index[i] = m.index + 1;
+    p_x[i] = m.x;
+    p_y[i] = m.y;
+    p_text[i] = res.texts[i];
+  }
+
+  return cpp11::writable::data_frame({"id"_nm = p_id, "index"_nm = p_index,
+                                      "x"_nm = p_x, "y"_nm = p_y,
+                                      "text"_nm = p_text});
+}
+
+[[cpp11::register]] cpp11::writable::list unigd_render_patch_(int devnum, int page,
+                                                              int since, double zoom,
+                                                              std::string renderer_id)
+{
+  auto dev = validate_unigddev(devnum);
+
+  const auto found = dev->plt_query(page, 1);
+  if (found.ids.empty())
+  {
+    cpp11::stop("Not a valid plot index.");
+  }
+  unigd::renderers::renderer_map_entry ren;
+  if (!unigd::renderers::find(renderer_id, &ren))
+  {
+    cpp11::stop("Not a valid renderer ID.");
+  }
+
+  unigd::ex::render_patch patch;
+  auto renderer = dev->api_render_patch(renderer_id.c_str(), found.ids[0],
+                                        static_cast<unigd::ex::plot_version_t>(since),
+                                        zoom, &patch);
+  if (!renderer)
+  {
+    stop_render_failed(dev);
+  }
+
+  const uint8_t *buf;
+  size_t buf_size;
+  renderer->get_data(&buf, &buf_size);
+
+  using namespace cpp11::literals;
+  cpp11::sexp data =
+      ren.info.text
+          ? static_cast<SEXP>(cpp11::writable::strings(
+                {cpp11::r_string(std::string(buf, buf + buf_size))}))
+          : static_cast<SEXP>(cpp11::writable::raws(buf, buf + buf_size));
+  return {"data"_nm = data,
+          "x"_nm = static_cast<int>(patch.x),
+          "y"_nm = static_cast<int>(patch.y),
+          "width"_nm = static_cast<int>(patch.width),
+          "height"_nm = static_cast<int>(patch.height),
+          "version"_nm = static_cast<int>(patch.version),
+          "full"_nm = patch.full};
+}
+
+[[cpp11::register]] cpp11::writable::raws unigd_render_document_(
+    int devnum, int from, int to, double width, double height, double zoom,
+    std::string renderer_id)
+{
+  auto dev = validate_unigddev(devnum);
+
+  if (width < 0 || height < 0)
+  {
+    zoom = 1;
+  }
+
+  unigd::renderers::document_gen generator;
+  if (!unigd::renderers::find_document(renderer_id, &generator))
+  {
+    cpp11::stop("Renderer does not support multi-page documents.");
+  }
+  auto renderer = generator();
+  if (!dev->plt_render_document(from, to, width / zoom, height / zoom, renderer.get(),
+                                zoom))
+  {
+    stop_render_failed(dev);
+  }
+
+  const uint8_t *buf;
+  size_t buf_size;
+  renderer->get_data(&buf, &buf_size);
+  return cpp11::writable::raws(buf, buf + buf_size);
+}
+
 [[cpp11::register]] bool unigd_clear_(int devnum)
 {
   auto dev = validate_unigddev(devnum);
@@ -210,4 +485,10 @@ inline std::shared_ptr<unigd::unigd_device> validate_unigddev(int devnum)
 
 [[cpp11::register]] void unigd_ipc_open_() { unigd::async::ipc_open(); }
 
-[[cpp11::register]] void unigd_ipc_close_() { unigd::async::ipc_close(); }
+[[cpp11::register]] void unigd_ipc_close_()
+{
+  // Background renders call back into clients, finish them before the library is
+  // unloaded
+  unigd::async::worker_pool_shutdown();
+  unigd::async::ipc_close();
+}
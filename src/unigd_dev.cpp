@@ -3,12 +3,15 @@
 
 #include <svglite_utils.h>
 
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cpp11/as.hpp>
 #include <cpp11/doubles.hpp>
 #include <cpp11/function.hpp>
 #include <cpp11/list.hpp>
 #include <cpp11/strings.hpp>
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -45,11 +48,16 @@ unigd_device::unigd_device(const device_params &t_params)
       system_aliases(cpp11::as_cpp<cpp11::list>(t_params.aliases["system"])),
       user_aliases(cpp11::as_cpp<cpp11::list>(t_params.aliases["user"])),
       m_history(),
+      m_history_enabled(t_params.history),
       m_client(nullptr)
 {
-  m_df_displaylist = true;
+  m_df_displaylist = m_history_enabled;
 
   m_data_store = std::make_shared<page_store>();
+  if (!t_params.store_file.empty() && !m_data_store->open_file(t_params.store_file))
+  {
+    cpp11::stop("Could not open page store file.");
+  }
 
   m_reset_par = t_params.reset_par ? r_graphics_par_get() : cpp11::list();
 
@@ -102,6 +110,23 @@ bool unigd_device::remove_client()
   return true;
 }
 
+bool unigd_device::is_open() const { return m_initialized; }
+
+bool unigd_device::history_enabled() const { return m_history_enabled; }
+
+void unigd_device::reopen()
+{
+  m_data_store->remove_all();
+  m_render_cache.clear();
+  m_dc_buffer.clear();
+  m_target.set_void();
+  m_target.set_newest_index(-1);
+  replaying = false;
+  m_initialized = true;
+}
+
+void unigd_device::release() { m_initialized = false; }
+
 // DEVICE CALLBACKS
 
 void unigd_device::dev_activate(pDevDesc dd)
@@ -155,6 +180,8 @@ void unigd_device::dev_close(pDevDesc dd)
 
   // cleanup r session data
   m_history.clear();
+
+  m_data_store->flush();
 }
 
 void unigd_device::dev_metricInfo(int c, pGEcontext gc, double *ascent, double *descent,
@@ -244,7 +271,7 @@ void unigd_device::dev_newPage(pGEcontext gc, pDevDesc dd)
   debug_print("[new_page] replaying=%i\n", replaying);
   if (!replaying)
   {
-    if (m_target.get_newest_index() >= 0)  // no previous pages
+    if (m_history_enabled && m_target.get_newest_index() >= 0)  // no previous pages
     {
       debug_print("    -> record open page in history\n");
       m_history.put_last(m_target.get_newest_index(), dd);
@@ -302,7 +329,7 @@ void unigd_device::dev_text(double x, double y, const char *str, double rot, dou
   put(std::make_unique<renderers::Text>(
       gc->col, gvertex<double>{x, y}, str, rot, hadj,
       renderers::TextInfo{
-          weight, feature,
+          weight, std::move(feature),
           fontname(gc->fontfamily, gc->fontface, system_aliases, user_aliases, font_info),
           gc->cex * gc->ps, is_italic(gc->fontface), dev_strWidth(str, gc, dd)}));
 }
@@ -378,10 +405,16 @@ void unigd_device::put(std::unique_ptr<renderers::DrawCall> &&t_dc)
   // m_data_store->add_dc(m_target.get_index(), dc, replaying);
 }
 
-void unigd_device::plt_prerender(int index, double width, double height)
+bool unigd_device::plt_prerender(int index, double width, double height)
 {
   if (index == -1) index = m_target.get_newest_index();
 
+  // Restored pages have no snapshot to replay
+  if (!m_history_enabled || m_data_store->restored(index))
+  {
+    return false;
+  }
+
   pDevDesc dd = get_active_pDevDesc();
 
   debug_print("[render_page] index=%i\n", index);
@@ -410,6 +443,7 @@ void unigd_device::plt_prerender(int index, double width, double height)
         m_target.get_newest_index());  // set target to open page for new draw calls
   }
   replaying = false;
+  return true;
 }
 
 bool unigd_device::plt_clear()
@@ -419,6 +453,7 @@ bool unigd_device::plt_clear()
 
   // clear history
   m_history.clear();
+  m_render_cache.clear();
   m_target.set_void();
   m_target.set_newest_index(-1);
 
@@ -450,7 +485,15 @@ bool unigd_device::plt_remove(int index)
   debug_print("[hist_remove] index = %i\n", index);
   replaying = true;
   m_history.remove(index);
-  if (index == m_target.get_newest_index() && index > 0)
+  if (!m_history_enabled || (index > 0 && m_data_store->restored(index - 1)))
+  {
+    // The previous page can not be restored, drop draw calls until the next page
+    if (index == m_target.get_newest_index())
+    {
+      m_target.set_void();
+    }
+  }
+  else if (index == m_target.get_newest_index() && index > 0)
   {
     debug_print("   -> last removed replay new last\n");
     m_target.set_index(m_target.get_newest_index() - 1);
@@ -487,24 +530,155 @@ bool unigd_device::plt_render(int index, double width, double height,
   else
   {
     debug_println("graphics engine rerender");
-    plt_prerender(*index_norm, width, height);
+    if (!plt_prerender(*index_norm, width, height))
+    {
+      return false;
+    }
   }
   debug_println("render");
   return m_data_store->render(*index_norm, t_renderer, t_scale);
 }
 
+bool unigd_device::plt_render_document(int from, int to, double width, double height,
+                                       renderers::document_target *t_renderer,
+                                       double t_scale)
+{
+  const auto from_norm = m_data_store->normalize_index(from);
+  const auto to_norm = m_data_store->normalize_index(to);
+
+  if (!from_norm.has_value() || !to_norm.has_value() || *from_norm > *to_norm)
+  {
+    return false;
+  }
+
+  // only replay pages with a different size
+  for (auto index = *from_norm; index <= *to_norm; ++index)
+  {
+    const auto size = m_data_store->size(index);
+    const double target_width = width < 0.1 ? size.x : width;
+    const double target_height = height < 0.1 ? size.y : height;
+    if ((std::fabs(target_width - size.x) > 0.1 ||
+         std::fabs(target_height - size.y) > 0.1) &&
+        !plt_prerender(index, target_width, target_height))
+    {
+      return false;
+    }
+  }
+  return m_data_store->render_document(*from_norm, *to_norm, t_renderer, t_scale);
+}
+
 int unigd_device::plt_index(int32_t id)
 {
   return m_data_store->find_index(id).value_or(-1);
 }
 
+namespace
+{
+// Output pixels at the requested size, or at the current page size
+double output_pixels(gvertex<double> t_page_size, double t_width, double t_height,
+                     double t_scale)
+{
+  const double width = t_width < 0.1 ? t_page_size.x : t_width;
+  const double height = t_height < 0.1 ? t_page_size.y : t_height;
+  return width * height * t_scale * t_scale;
+}
+}  // namespace
+
+bool unigd_device::plt_estimate(const char *t_renderer_id, int index, double width,
+                                double height, double t_scale, const char **t_selected,
+                                render_cost::estimate *t_estimate)
+{
+  renderers::PageStats stats;
+  gvertex<double> size;
+  if (!m_data_store->stats(index, &stats, &size))
+  {
+    return false;
+  }
+  const double pixels = output_pixels(size, width, height, std::fabs(t_scale));
+  if (render_cost::is_auto(t_renderer_id))
+  {
+    return render_cost::select(t_renderer_id, stats, pixels, t_selected, t_estimate);
+  }
+  *t_selected = t_renderer_id;
+  return render_cost::predict(t_renderer_id, stats, pixels, t_estimate);
+}
+
+const char *unigd_device::select_renderer(const char *t_renderer_id, int t_plot_idx,
+                                          double t_width, double t_height,
+                                          double t_scale)
+{
+  if (!render_cost::is_auto(t_renderer_id))
+  {
+    return t_renderer_id;
+  }
+  const char *selected;
+  render_cost::estimate estimate;
+  if (!plt_estimate(t_renderer_id, t_plot_idx, t_width, t_height, t_scale, &selected,
+                    &estimate))
+  {
+    return nullptr;
+  }
+  return selected;
+}
+
+void unigd_device::observe_render(const char *t_renderer_id, int t_plot_idx,
+                                  double t_width, double t_height, double t_scale,
+                                  double t_seconds, size_t t_bytes)
+{
+  renderers::PageStats stats;
+  gvertex<double> size;
+  if (t_seconds < 0 || !m_data_store->stats(t_plot_idx, &stats, &size))
+  {
+    return;
+  }
+  render_cost::observe(t_renderer_id, stats,
+                       output_pixels(size, t_width, t_height, std::fabs(t_scale)),
+                       t_seconds, t_bytes);
+}
+
 ex::device_state unigd_device::plt_state() { return m_data_store->state(); }
 
+snapshot_stats unigd_device::plt_snapshot_stats() const { return m_history.stats(); }
+
+block_store::stats unigd_device::plt_block_stats() { return m_data_store->block_stats(); }
+
+render_limiter::stats unigd_device::plt_render_queue_stats()
+{
+  return m_render_limiter->get_stats();
+}
+
+ex::search_results unigd_device::plt_search(const std::string &query, int limit)
+{
+  return m_data_store->search(query, limit);
+}
+
 ex::find_results unigd_device::plt_query(int offset, int limit)
 {
   return m_data_store->query(offset, limit);
 }
 
+ex::plots_info_results unigd_device::plt_info(int offset, int limit)
+{
+  return m_data_store->info(offset, limit);
+}
+
+bool unigd_device::api_append(int32_t t_plot_id, const ex::primitive_batch *t_batch)
+{
+  const auto plot_idx = plt_index(t_plot_id);
+  if (plot_idx == -1 || !t_batch)
+  {
+    return false;
+  }
+  try
+  {
+    return m_data_store->append_batch(plot_idx, *t_batch);
+  }
+  catch (...)
+  {
+  }
+  return false;
+}
+
 bool unigd_device::api_remove(int32_t id)
 {
   const auto plot_idx = plt_index(id);
@@ -529,33 +703,363 @@ bool unigd_device::api_clear()
   return false;
 }
 
-std::unique_ptr<ex::render_data> unigd_device::api_render(ex::renderer_id_t t_renderer_id,
-                                                          int32_t t_plot_id,
-                                                          double t_width, double t_height,
-                                                          double t_scale)
+void unigd_device::api_render_limits(const render_limiter::limits &t_limits)
+{
+  m_render_limiter->set_limits(t_limits);
+}
+
+bool unigd_device::api_fingerprint(ex::renderer_id_t t_renderer_id, int32_t t_plot_id,
+                                   double t_width, double t_height, double t_scale,
+                                   fingerprint::fingerprint_t *t_fingerprint)
+{
+  const auto plot_idx = plt_index(t_plot_id);
+  unigd_renderer_info info;
+  if (plot_idx == -1 || !renderers::find_info(t_renderer_id, &info))
+  {
+    return false;
+  }
+  return m_data_store->fingerprint(plot_idx, t_renderer_id, t_scale, {t_width, t_height},
+                                   t_fingerprint);
+}
+
+std::unique_ptr<ex::render_data> unigd_device::api_render_patch(
+    ex::renderer_id_t t_renderer_id, int32_t t_plot_id, ex::plot_version_t t_since,
+    double t_scale, ex::render_patch *t_patch)
 {
   const auto plot_idx = plt_index(t_plot_id);
+  renderers::renderer_map_entry ren;
+  if (plot_idx == -1 || !renderers::find(t_renderer_id, &ren))
+  {
+    return nullptr;
+  }
+  auto renderer = ren.generator();
+  if (!m_data_store->render_patch(plot_idx, t_since, renderer.get(), t_scale, t_patch))
+  {
+    return nullptr;
+  }
+  return renderer;
+}
+
+bool unigd_device::render_or_replay(int t_plot_idx, renderers::render_target *t_renderer,
+                                    double t_width, double t_height, double t_scale,
+                                    double *t_seconds)
+{
+  const auto start = std::chrono::steady_clock::now();
+  if (m_data_store->render_if_size(t_plot_idx, t_renderer, t_scale, {t_width, t_height}))
+  {
+    if (t_seconds)
+    {
+      *t_seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+  }
+  if (t_seconds)
+  {
+    *t_seconds = -1;
+  }
+  if (!m_history_enabled)
+  {
+    return false;
+  }
+  return async::r_thread(
+             [&]()
+             { return plt_render(t_plot_idx, t_width, t_height, t_renderer, t_scale); })
+      .get();
+}
 
+namespace
+{
+const char *progressive_preview_renderer = "png";
+const double progressive_preview_scale = 0.25;
+}  // namespace
+
+std::unique_ptr<ex::render_data> unigd_device::api_render_progressive(
+    ex::renderer_id_t t_renderer_id, int32_t t_plot_id, double t_width, double t_height,
+    double t_scale, double t_preview_scale, render_ready_fn t_ready)
+{
+  render_limiter::reset_rejected();
+  t_renderer_id = select_renderer(t_renderer_id, plt_index(t_plot_id), t_width,
+                                  t_height, t_scale);
   renderers::renderer_map_entry ren;
-  auto fi_renderer = renderers::find(t_renderer_id, &ren);
-  if (!fi_renderer)
+  if (!t_renderer_id || !renderers::find(t_renderer_id, &ren))
+  {
+    return nullptr;
+  }
+  if (t_preview_scale <= 0 || t_preview_scale >= 1)
+  {
+    t_preview_scale = progressive_preview_scale;
+  }
+
+  // The preview replays the plot if the size changed, so the page store is up to date
+  // for the full render and the background task never needs the R thread.
+  auto preview = api_render(progressive_preview_renderer, t_plot_id, t_width, t_height,
+                            t_scale * t_preview_scale);
+  if (!preview)
   {
     return nullptr;
   }
 
+  // The full render keeps its slot until it is done in the background. Waiting for a
+  // slot would hold back the preview, so the full render is rejected when all slots
+  // are busy and reports failure from the pool like other failed renders.
+  auto slot = m_render_limiter->try_acquire();
+  auto store = m_data_store;
   auto renderer = ren.generator();
-  if (!m_data_store->render_if_size(plot_idx, renderer.get(), t_scale,
+  // Tasks only hold on to the page store, the device may be closed in the meantime
+  async::worker_pool()->submit(
+      [store, t_plot_id, t_width, t_height, t_scale, t_ready,
+       renderer = std::move(renderer), slot = std::move(slot)]() mutable
+      {
+        // Exceptions would end up in the discarded future, ready is called either way
+        std::unique_ptr<ex::render_data> result;
+        try
+        {
+          const auto plot_idx = store->find_index(t_plot_id);
+          if (slot && plot_idx &&
+              store->render_if_size(*plot_idx, renderer.get(), t_scale,
                                     {t_width, t_height}))
+          {
+            result = std::move(renderer);
+          }
+        }
+        catch (...)
+        {
+          result.reset();
+        }
+        t_ready(std::move(result));
+      });
+  return preview;
+}
+
+#ifndef UNIGD_NO_SHM
+namespace
+{
+// Segments are a few MB each, a handful of local clients is the common case
+const std::size_t shm_max_clients = 16;
+
+uint8_t *shm_reserve(void *t_shm, size_t t_capacity)
+{
+  return static_cast<shm_region *>(t_shm)->reserve(t_capacity);
+}
+}  // namespace
+
+bool unigd_device::api_render_shm(ex::renderer_id_t t_renderer_id, int32_t t_plot_id,
+                                  double t_width, double t_height, double t_scale,
+                                  ex::shm_access *t_access)
+{
+  const uint64_t client = render_limiter::client();
+  std::shared_ptr<shm_slot> slot;
   {
-    if (!async::r_thread(
-             [&]()
-             { return plt_render(plot_idx, t_width, t_height, renderer.get(), t_scale); })
-             .get())
+    const std::lock_guard<std::mutex> lock(m_shm_mutex);
+    auto it = m_shm.find(client);
+    if (it != m_shm.end())
     {
-      return nullptr;
+      m_shm_lru.splice(m_shm_lru.begin(), m_shm_lru, it->second.lru);
+      slot = it->second.slot;
     }
+    else
+    {
+      if (m_shm.size() >= shm_max_clients)
+      {
+        // The segment is marked as dropped when its last render is done
+        debug_print("[shm] drop segment of client %llu\n",
+                    static_cast<unsigned long long>(m_shm_lru.back()));
+        m_shm.erase(m_shm_lru.back());
+        m_shm_lru.pop_back();
+      }
+      m_shm_lru.push_front(client);
+      slot = std::make_shared<shm_slot>();
+      m_shm[client] = {slot, m_shm_lru.begin()};
+    }
+  }
+
+  const std::lock_guard<std::mutex> lock(slot->mutex);
+  if (!slot->region)
+  {
+    auto region = std::make_unique<shm_region>();
+    if (region->name().empty())
+    {
+      return false;
+    }
+    slot->region = std::move(region);
+  }
+
+  // The segment of this client can be dropped by renders of other clients, the
+  // name is copied so it stays valid until the next call of this thread
+  thread_local std::string name;
+  shm_region *region = slot->region.get();
+  region->begin_write();
+  output_sink sink(shm_reserve, region, shm_region::header_size);
+  if (!api_render_stream(t_renderer_id, t_plot_id, t_width, t_height, t_scale, &sink))
+  {
+    region->end_write(0);
+    return false;
+  }
+
+  name = region->name();
+  t_access->name = name.c_str();
+  t_access->generation = region->end_write(sink.size());
+  t_access->offset = shm_region::header_size;
+  t_access->size = sink.size();
+  return true;
+}
+#else
+bool unigd_device::api_render_shm(ex::renderer_id_t t_renderer_id, int32_t t_plot_id,
+                                  double t_width, double t_height, double t_scale,
+                                  ex::shm_access *t_access)
+{
+  return false;
+}
+#endif
+
+std::unique_ptr<ex::render_data> unigd_device::api_render_document(
+    ex::renderer_id_t t_renderer_id, int t_from, int t_to, double t_width,
+    double t_height, double t_scale)
+{
+  render_limiter::reset_rejected();
+  renderers::document_gen generator;
+  if (!renderers::find_document(t_renderer_id, &generator))
+  {
+    return nullptr;
+  }
+
+  const auto slot = m_render_limiter->acquire();
+  if (!slot)
+  {
+    return nullptr;
+  }
+  auto renderer = generator();
+  if (!async::r_thread(
+           [&]()
+           {
+             return plt_render_document(t_from, t_to, t_width, t_height, renderer.get(),
+                                        t_scale);
+           })
+           .get())
+  {
+    return nullptr;
   }
   return std::move(renderer);
 }
 
+bool unigd_device::api_render_stream(ex::renderer_id_t t_renderer_id, int32_t t_plot_id,
+                                     double t_width, double t_height, double t_scale,
+                                     output_sink *t_sink)
+{
+  render_limiter::reset_rejected();
+  const auto plot_idx = plt_index(t_plot_id);
+  t_renderer_id = select_renderer(t_renderer_id, plot_idx, t_width, t_height, t_scale);
+
+  renderers::renderer_gen generator;
+  if (!t_renderer_id || !renderers::find_generator(t_renderer_id, &generator))
+  {
+    return false;
+  }
+
+  const auto slot = m_render_limiter->acquire();
+  if (!slot)
+  {
+    return false;
+  }
+  auto renderer = generator();
+  const bool streaming = renderer->set_sink(t_sink);
+  const auto sink_start = t_sink->size();
+  double seconds;
+  if (!render_or_replay(plot_idx, renderer.get(), t_width, t_height, t_scale, &seconds))
+  {
+    return false;
+  }
+  if (!streaming)
+  {
+    const uint8_t *buf;
+    size_t buf_size;
+    renderer->get_data(&buf, &buf_size);
+    t_sink->write(buf, buf_size);
+  }
+  observe_render(t_renderer_id, plot_idx, t_width, t_height, t_scale, seconds,
+                 t_sink->size() - sink_start);
+  return t_sink->ok();
+}
+
+std::unique_ptr<ex::render_data> unigd_device::api_render(
+    ex::renderer_id_t t_renderer_id, int32_t t_plot_id, double t_width, double t_height,
+    double t_scale, ex::render_encoding_t t_encoding)
+{
+  render_limiter::reset_rejected();
+  const auto plot_idx = plt_index(t_plot_id);
+  t_renderer_id = select_renderer(t_renderer_id, plot_idx, t_width, t_height, t_scale);
+
+  renderers::renderer_map_entry ren;
+  if (!t_renderer_id || !renderers::find(t_renderer_id, &ren))
+  {
+    return nullptr;
+  }
+
+  // Text results are cached by fingerprint, the fingerprint is only available when
+  // no replay is needed.
+  fingerprint::fingerprint_t fp_before = fingerprint::seed;
+  const bool cacheable =
+      ren.info.text && plot_idx != -1 &&
+      m_data_store->fingerprint(plot_idx, t_renderer_id, t_scale, {t_width, t_height},
+                                &fp_before);
+  if (cacheable)
+  {
+    if (auto entry = m_render_cache.get(fp_before))
+    {
+      if (!entry->encode(t_encoding))
+      {
+        return nullptr;
+      }
+      return std::make_unique<cached_render>(std::move(entry), t_encoding);
+    }
+  }
+
+  const auto slot = m_render_limiter->acquire();
+  if (!slot)
+  {
+    return nullptr;
+  }
+  auto renderer = ren.generator();
+  double seconds;
+  if (!render_or_replay(plot_idx, renderer.get(), t_width, t_height, t_scale, &seconds))
+  {
+    return nullptr;
+  }
+
+  const uint8_t *buf;
+  size_t buf_size;
+  renderer->get_data(&buf, &buf_size);
+  observe_render(t_renderer_id, plot_idx, t_width, t_height, t_scale, seconds, buf_size);
+
+  if (!cacheable && t_encoding == UNIGD_RENDER_ENCODING_IDENTITY)
+  {
+    return std::move(renderer);
+  }
+
+  std::vector<uint8_t> data(buf, buf + buf_size);
+
+  // Only store the result if the plot did not change while rendering
+  fingerprint::fingerprint_t fp_after;
+  std::shared_ptr<const render_cache_entry> entry;
+  if (cacheable &&
+      m_data_store->fingerprint(plot_idx, t_renderer_id, t_scale, {t_width, t_height},
+                                &fp_after) &&
+      fp_after == fp_before)
+  {
+    entry = m_render_cache.put(fp_after, std::move(data));
+  }
+  else
+  {
+    entry = std::make_shared<const render_cache_entry>(fp_before, std::move(data));
+  }
+  // Output that can not be encoded fails the render, clients would otherwise decode
+  // an empty body
+  if (!entry->encode(t_encoding))
+  {
+    return nullptr;
+  }
+  return std::make_unique<cached_render>(std::move(entry), t_encoding);
+}
+
 }  // namespace unigd
@@ -3,13 +3,20 @@
 
 #include <compat/optional.hpp>
 #include <cpp11/list.hpp>
+#include <functional>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 
 #include "generic_dev.h"
 #include "page_store.h"
 #include "plot_history.h"
+#include "render_cache.h"
+#include "render_cost.h"
+#include "render_limiter.h"
+#include "shm_region.h"
 #include "unigd_commons.h"
 #include "unigd_external.h"
 
@@ -23,6 +30,10 @@ struct device_params
   double pointsize;
   cpp11::list aliases;
   bool reset_par;
+  // Record the display list and page snapshots, needed to replay plots at a new size
+  bool history;
+  // Page file that keeps plots across sessions, empty for none
+  std::string store_file;
 };
 
 class DeviceTarget
@@ -64,25 +75,82 @@ class unigd_device : public generic_dev<unigd_device>
   bool get_client_anonymous(ex::graphics_client **t_client, void **t_client_data);
   bool remove_client();
 
+  // Device reuse (see device_pool.h)
+
+  // Has not been closed by R yet
+  bool is_open() const;
+  // Plots can be replayed (e.g. rendered at a different size)
+  bool history_enabled() const;
+  // Reset a closed device so it can be added to R again
+  void reopen();
+  // Mark a reopened device as closed if it could not be added to R
+  void release();
+
   // Synchronous access
 
-  void plt_prerender(int index, double width, double height);
+  bool plt_prerender(int index, double width, double height);
   bool plt_remove(int index);
   bool plt_clear();
   bool plt_render(int index, double width, double height,
                   renderers::render_target *t_renderer, double t_scale);
+  bool plt_render_document(int from, int to, double width, double height,
+                           renderers::document_target *t_renderer, double t_scale);
 
   // Datastore only access
 
   ex::device_state plt_state();
+  snapshot_stats plt_snapshot_stats() const;
+  block_store::stats plt_block_stats();
+  render_limiter::stats plt_render_queue_stats();
   ex::find_results plt_query(int offset, int limit);
+  ex::plots_info_results plt_info(int offset, int limit);
+  ex::search_results plt_search(const std::string &query, int limit);
   int plt_index(int32_t id);
+  // Predicted output size and render time. "auto" renderer IDs are resolved to the
+  // renderer selected for the budget.
+  bool plt_estimate(const char *t_renderer_id, int index, double width, double height,
+                    double t_scale, const char **t_selected,
+                    render_cost::estimate *t_estimate);
 
   // Asynchronous access
 
+  // Render calls of clients go through an admission queue (see render_limiter.h) and
+  // fail without rendering when it is full. Cached results and patches are not
+  // queued.
+  void api_render_limits(const render_limiter::limits &t_limits);
   std::unique_ptr<ex::render_data> api_render(ex::renderer_id_t t_renderer_id,
                                               int32_t t_plot_id, double t_width,
-                                              double t_height, double t_scale);
+                                              double t_height, double t_scale,
+                                              ex::render_encoding_t t_encoding =
+                                                  UNIGD_RENDER_ENCODING_IDENTITY);
+  // Receives the full quality result of a progressive render, nullptr on failure.
+  using render_ready_fn = std::function<void(std::unique_ptr<ex::render_data>)>;
+  // Returns a low resolution PNG preview right away and renders the full result on a
+  // background thread. t_ready is only called if a preview could be rendered.
+  std::unique_ptr<ex::render_data> api_render_progressive(
+      ex::renderer_id_t t_renderer_id, int32_t t_plot_id, double t_width,
+      double t_height, double t_scale, double t_preview_scale, render_ready_fn t_ready);
+  // Render into the shared memory segment of the device. The output stays valid until
+  // the next call.
+  bool api_render_shm(ex::renderer_id_t t_renderer_id, int32_t t_plot_id, double t_width,
+                      double t_height, double t_scale, ex::shm_access *t_access);
+  std::unique_ptr<ex::render_data> api_render_document(ex::renderer_id_t t_renderer_id,
+                                                       int t_from, int t_to,
+                                                       double t_width, double t_height,
+                                                       double t_scale);
+  bool api_render_stream(ex::renderer_id_t t_renderer_id, int32_t t_plot_id,
+                         double t_width, double t_height, double t_scale,
+                         output_sink *t_sink);
+  // Render the area changed after plot version t_since at the current plot size.
+  std::unique_ptr<ex::render_data> api_render_patch(ex::renderer_id_t t_renderer_id,
+                                                    int32_t t_plot_id,
+                                                    ex::plot_version_t t_since,
+                                                    double t_scale,
+                                                    ex::render_patch *t_patch);
+  bool api_fingerprint(ex::renderer_id_t t_renderer_id, int32_t t_plot_id,
+                       double t_width, double t_height, double t_scale,
+                       fingerprint::fingerprint_t *t_fingerprint);
+  bool api_append(int32_t t_plot_id, const ex::primitive_batch *t_batch);
   bool api_remove(int32_t t_id);
   bool api_clear();
 
@@ -117,7 +185,29 @@ class unigd_device : public generic_dev<unigd_device>
 
  private:
   PlotHistory m_history;
+  const bool m_history_enabled;
   std::shared_ptr<page_store> m_data_store;
+  render_cache m_render_cache{16 * 1024 * 1024};
+  // Shared with background renders, which may outlive the device
+  std::shared_ptr<render_limiter> m_render_limiter{std::make_shared<render_limiter>()};
+
+#ifndef UNIGD_NO_SHM
+  struct shm_slot
+  {
+    std::mutex mutex;
+    std::unique_ptr<shm_region> region;
+  };
+  struct shm_entry
+  {
+    std::shared_ptr<shm_slot> slot;
+    std::list<uint64_t>::iterator lru;
+  };
+  // Segments by render client key (see render_limiter::set_client). The least
+  // recently used segment is dropped when too many clients have one.
+  std::mutex m_shm_mutex;
+  std::unordered_map<uint64_t, shm_entry> m_shm;
+  std::list<uint64_t> m_shm_lru;  // most recently used first
+#endif
 
   ex::graphics_client *m_client{nullptr};
   UNIGD_CLIENT_ID m_client_id = 0;
@@ -130,6 +220,18 @@ class unigd_device : public generic_dev<unigd_device>
 
   void put(std::unique_ptr<renderers::DrawCall> &&t_dc);
 
+  // Render from the page store, replay on the R thread if the size changed. The render
+  // time is written to t_seconds, or -1 if the plot had to be replayed.
+  bool render_or_replay(int t_plot_idx, renderers::render_target *t_renderer,
+                        double t_width, double t_height, double t_scale,
+                        double *t_seconds = nullptr);
+  // Resolves "auto" renderer IDs, nullptr if no renderer could be selected
+  const char *select_renderer(const char *t_renderer_id, int t_plot_idx, double t_width,
+                              double t_height, double t_scale);
+  // Calibrate the render cost model with a timed render
+  void observe_render(const char *t_renderer_id, int t_plot_idx, double t_width,
+                      double t_height, double t_scale, double t_seconds, size_t t_bytes);
+
   // set device size
   void resize_device_to_page(pDevDesc dd);
 
@@ -1,5 +1,6 @@
 #include "unigd_external.h"
 
+#include "compress.h"
 #include "r_thread.h"
 #include "renderers.h"
 #include "unigd_dev.h"
@@ -16,6 +17,20 @@ unigd_find_results find_results::c_repr()
   return {state, static_cast<plot_index_t>(ids.size()), ids.data()};
 }
 
+unigd_plots_info_results plots_info_results::c_repr()
+{
+  return {state, static_cast<plot_index_t>(entries.size()), entries.data()};
+}
+
+unigd_search_results search_results::c_repr()
+{
+  for (std::size_t i = 0; i < matches.size(); ++i)
+  {
+    matches[i].text = texts[i].c_str();
+  }
+  return {state, static_cast<plot_index_t>(matches.size()), matches.data()};
+}
+
 int api_test_fun() { return 7; }
 
 void api_log(const char *t_message)
@@ -87,16 +102,83 @@ bool api_plots_remove(UNIGD_HANDLE ugd_handle, UNIGD_PLOT_ID id)
   return ugd->device->api_remove(id);
 }
 
+bool api_plots_append(UNIGD_HANDLE ugd_handle, UNIGD_PLOT_ID id,
+                      const unigd_primitive_batch *batch)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  return ugd->device->api_append(id, batch);
+}
+
+void api_render_limits(UNIGD_HANDLE ugd_handle, unigd_render_limits limits)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  ugd->device->api_render_limits({limits.workers, limits.queue, limits.client_queue});
+}
+
+unigd_render_queue_stats api_render_queue(UNIGD_HANDLE ugd_handle)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  const auto stats = ugd->device->plt_render_queue_stats();
+  return {{stats.limit.workers, stats.limit.queue, stats.limit.client_queue},
+          stats.running,
+          stats.queued,
+          stats.clients,
+          stats.peak_queued,
+          stats.admitted,
+          stats.rejected};
+}
+
+void api_render_client(uint64_t client_key) { render_limiter::set_client(client_key); }
+
+bool api_render_busy() { return render_limiter::last_rejected(); }
+
+UNIGD_RENDER_HANDLE api_render_create_encoded(UNIGD_HANDLE ugd_handle,
+                                              UNIGD_RENDERER_ID renderer_id,
+                                              UNIGD_PLOT_ID plot_id,
+                                              unigd_render_args render_args,
+                                              unigd_render_encoding encoding,
+                                              unigd_render_access *render_access)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  auto handle = ugd->device
+                    ->api_render(renderer_id, plot_id, render_args.width,
+                                 render_args.height, render_args.scale, encoding)
+                    .release();
+  if (handle)
+  {
+    size_t buf_size;
+    handle->get_data(&render_access->buffer, &buf_size);
+    render_access->size = buf_size;
+  }
+  else
+  {
+    render_access->buffer = nullptr;
+    render_access->size = 0;
+  }
+  return handle;
+}
+
 UNIGD_RENDER_HANDLE api_render_create(UNIGD_HANDLE ugd_handle,
                                       UNIGD_RENDERER_ID renderer_id,
                                       UNIGD_PLOT_ID plot_id,
                                       unigd_render_args render_args,
                                       unigd_render_access *render_access)
+{
+  return api_render_create_encoded(ugd_handle, renderer_id, plot_id, render_args,
+                                   UNIGD_RENDER_ENCODING_IDENTITY, render_access);
+}
+
+UNIGD_RENDER_HANDLE api_render_document_create(UNIGD_HANDLE ugd_handle,
+                                               UNIGD_RENDERER_ID renderer_id,
+                                               UNIGD_PLOT_RELATIVE from,
+                                               UNIGD_PLOT_RELATIVE to,
+                                               unigd_render_args render_args,
+                                               unigd_render_access *render_access)
 {
   const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
   auto handle = ugd->device
-                    ->api_render(renderer_id, plot_id, render_args.width,
-                                 render_args.height, render_args.scale)
+                    ->api_render_document(renderer_id, from, to, render_args.width,
+                                          render_args.height, render_args.scale)
                     .release();
   if (handle)
   {
@@ -112,6 +194,140 @@ UNIGD_RENDER_HANDLE api_render_create(UNIGD_HANDLE ugd_handle,
   return handle;
 }
 
+UNIGD_RENDER_HANDLE api_render_progressive(UNIGD_HANDLE ugd_handle,
+                                           UNIGD_RENDERER_ID renderer_id,
+                                           UNIGD_PLOT_ID plot_id,
+                                           unigd_render_args render_args,
+                                           double preview_scale,
+                                           unigd_render_access *preview,
+                                           unigd_render_ready ready, void *ready_data)
+{
+  if (!ready)
+  {
+    preview->buffer = nullptr;
+    preview->size = 0;
+    return nullptr;
+  }
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  auto handle =
+      ugd->device
+          ->api_render_progressive(
+              renderer_id, plot_id, render_args.width, render_args.height,
+              render_args.scale, preview_scale,
+              [ready, ready_data](std::unique_ptr<render_data> t_result)
+              {
+                unigd_render_access access{nullptr, 0};
+                if (t_result)
+                {
+                  size_t buf_size;
+                  t_result->get_data(&access.buffer, &buf_size);
+                  access.size = buf_size;
+                }
+                ready(ready_data, t_result.release(), &access);
+              })
+          .release();
+  if (handle)
+  {
+    size_t buf_size;
+    handle->get_data(&preview->buffer, &buf_size);
+    preview->size = buf_size;
+  }
+  else
+  {
+    preview->buffer = nullptr;
+    preview->size = 0;
+  }
+  return handle;
+}
+
+bool api_render_estimate(UNIGD_HANDLE ugd_handle, UNIGD_RENDERER_ID renderer_id,
+                         UNIGD_PLOT_ID plot_id, unigd_render_args render_args,
+                         unigd_render_estimate *render_estimate)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  const auto plot_idx = ugd->device->plt_index(plot_id);
+  render_cost::estimate estimate;
+  if (plot_idx == -1 ||
+      !ugd->device->plt_estimate(renderer_id, plot_idx, render_args.width,
+                                 render_args.height, render_args.scale,
+                                 &render_estimate->renderer_id, &estimate))
+  {
+    return false;
+  }
+  render_estimate->bytes = estimate.bytes;
+  render_estimate->seconds = estimate.seconds;
+  return true;
+}
+
+bool api_render_shm(UNIGD_HANDLE ugd_handle, UNIGD_RENDERER_ID renderer_id,
+                    UNIGD_PLOT_ID plot_id, unigd_render_args render_args,
+                    unigd_shm_access *shm_access)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  return ugd->device->api_render_shm(renderer_id, plot_id, render_args.width,
+                                     render_args.height, render_args.scale, shm_access);
+}
+
+bool api_render_stream(UNIGD_HANDLE ugd_handle, UNIGD_RENDERER_ID renderer_id,
+                       UNIGD_PLOT_ID plot_id, unigd_render_args render_args,
+                       unigd_render_writer writer, void *writer_data)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  output_sink sink(writer, writer_data);
+  return ugd->device->api_render_stream(renderer_id, plot_id, render_args.width,
+                                        render_args.height, render_args.scale, &sink);
+}
+
+bool api_render_fd(UNIGD_HANDLE ugd_handle, UNIGD_RENDERER_ID renderer_id,
+                   UNIGD_PLOT_ID plot_id, unigd_render_args render_args, int fd)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  output_sink sink(fd);
+  return ugd->device->api_render_stream(renderer_id, plot_id, render_args.width,
+                                        render_args.height, render_args.scale, &sink);
+}
+
+void api_render_encoding_dictionary(unigd_render_access *dictionary,
+                                    uint32_t *dictionary_id)
+{
+  const auto &dict = unigd::compr::dictionary();
+  dictionary->buffer = reinterpret_cast<const uint8_t *>(dict.data());
+  dictionary->size = dict.size();
+  *dictionary_id = unigd::compr::dictionary_id();
+}
+
+bool api_render_fingerprint(UNIGD_HANDLE ugd_handle, UNIGD_RENDERER_ID renderer_id,
+                            UNIGD_PLOT_ID plot_id, unigd_render_args render_args,
+                            uint64_t *fingerprint)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  return ugd->device->api_fingerprint(renderer_id, plot_id, render_args.width,
+                                      render_args.height, render_args.scale,
+                                      fingerprint);
+}
+
+UNIGD_RENDER_HANDLE api_render_patch(UNIGD_HANDLE ugd_handle, UNIGD_RENDERER_ID renderer_id,
+                                     UNIGD_PLOT_ID plot_id, UNIGD_PLOT_VERSION since,
+                                     double scale, unigd_render_patch *patch,
+                                     unigd_render_access *render_access)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+  auto handle =
+      ugd->device->api_render_patch(renderer_id, plot_id, since, scale, patch).release();
+  if (handle)
+  {
+    size_t buf_size;
+    handle->get_data(&render_access->buffer, &buf_size);
+    render_access->size = buf_size;
+  }
+  else
+  {
+    render_access->buffer = nullptr;
+    render_access->size = 0;
+  }
+  return handle;
+}
+
 void api_render_destroy(UNIGD_RENDER_HANDLE handle)
 {
   delete static_cast<unigd::ex::render_data *>(handle);
@@ -133,6 +349,39 @@ void api_plots_find_destroy(UNIGD_FIND_HANDLE handle)
   delete static_cast<unigd::ex::find_results *>(handle);
 }
 
+UNIGD_PLOTS_INFO_HANDLE api_plots_info(UNIGD_HANDLE ugd_handle,
+                                       UNIGD_PLOT_RELATIVE offset, UNIGD_PLOT_INDEX limit,
+                                       unigd_plots_info_results *results)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+
+  auto *re = new plots_info_results{};
+  *re = ugd->device->plt_info(offset, limit);
+  *results = re->c_repr();
+  return re;
+}
+
+void api_plots_info_destroy(UNIGD_PLOTS_INFO_HANDLE handle)
+{
+  delete static_cast<unigd::ex::plots_info_results *>(handle);
+}
+
+UNIGD_SEARCH_HANDLE api_plots_search(UNIGD_HANDLE ugd_handle, const char *query,
+                                     UNIGD_PLOT_INDEX limit, unigd_search_results *results)
+{
+  const auto ugd = static_cast<unigd_handle_t *>(ugd_handle);
+
+  auto *re = new search_results{};
+  *re = ugd->device->plt_search(query, limit);
+  *results = re->c_repr();
+  return re;
+}
+
+void api_plots_search_destroy(UNIGD_SEARCH_HANDLE handle)
+{
+  delete static_cast<unigd::ex::search_results *>(handle);
+}
+
 UNIGD_RENDERERS_ENTRY_HANDLE api_renderers_find(UNIGD_RENDERER_ID id,
                                                 unigd_renderer_info *renderer)
 {
@@ -202,6 +451,34 @@ int api_v1_create(unigd_api_v1 **api_)
   api->renderers_find = api_renderers_find;
   api->renderers_find_destroy = api_renderers_find_destroy;
 
+  api->device_render_fingerprint = api_render_fingerprint;
+
+  api->device_plots_info = api_plots_info;
+  api->device_plots_info_destroy = api_plots_info_destroy;
+
+  api->device_render_create_encoded = api_render_create_encoded;
+  api->render_encoding_dictionary = api_render_encoding_dictionary;
+
+  api->device_render_stream = api_render_stream;
+  api->device_render_fd = api_render_fd;
+
+  api->device_render_document_create = api_render_document_create;
+
+  api->device_render_shm = api_render_shm;
+
+  api->device_render_progressive = api_render_progressive;
+
+  api->device_render_estimate = api_render_estimate;
+  api->device_plots_search = api_plots_search;
+  api->device_plots_search_destroy = api_plots_search_destroy;
+
+  api->device_render_patch = api_render_patch;
+  api->device_plots_append = api_plots_append;
+  api->device_render_limits = api_render_limits;
+  api->device_render_queue = api_render_queue;
+  api->render_client = api_render_client;
+  api->render_busy = api_render_busy;
+
   *api_ = api;
   return 0;
 }
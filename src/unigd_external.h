@@ -16,7 +16,12 @@ namespace ex
 using plot_index_t = UNIGD_PLOT_INDEX;
 using plot_relative_t = UNIGD_PLOT_RELATIVE;
 using plot_id_t = UNIGD_PLOT_ID;
+using plot_version_t = UNIGD_PLOT_VERSION;
 using renderer_id_t = UNIGD_RENDERER_ID;
+using render_encoding_t = unigd_render_encoding;
+using shm_access = unigd_shm_access;
+using render_patch = unigd_render_patch;
+using primitive_batch = unigd_primitive_batch;
 
 using graphics_client = unigd_graphics_client;
 
@@ -42,10 +47,32 @@ struct find_results
 {
   unigd_device_state state;
   std::vector<plot_id_t> ids;
+  std::vector<plot_version_t> versions;
 
   unigd_find_results c_repr();
 };
 
+using plot_info = unigd_plot_info;
+
+struct plots_info_results
+{
+  unigd_device_state state;
+  std::vector<plot_info> entries;
+
+  unigd_plots_info_results c_repr();
+};
+
+using text_match = unigd_text_match;
+
+struct search_results
+{
+  unigd_device_state state;
+  std::vector<text_match> matches;
+  std::vector<std::string> texts;
+
+  unigd_search_results c_repr();
+};
+
 class render_data
 {
  public:
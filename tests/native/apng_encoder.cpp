@@ -0,0 +1,225 @@
+// Animated PNG encoder: the frames are rebuilt from the chunks and compared with
+// the input, merged delays must fit into 16 bits, and the number of frames held in
+// memory must not grow with the frame count. Not run by R CMD check, build and run
+// from the package root with:
+//
+//   c++ -std=c++17 -pthread -Isrc tests/native/apng_encoder.cpp src/apng.cpp \
+//     src/async_utils.cpp src/output_sink.cpp -lz -o apng_encoder && ./apng_encoder
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "apng.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+std::atomic<int> frames_alive{0};
+std::atomic<int> frames_peak{0};
+
+std::shared_ptr<const apng::frame> tracked(apng::frame t_frame)
+{
+  const int alive = ++frames_alive;
+  int peak = frames_peak;
+  while (alive > peak && !frames_peak.compare_exchange_weak(peak, alive))
+  {
+  }
+  return std::shared_ptr<const apng::frame>(new apng::frame(std::move(t_frame)),
+                                            [](const apng::frame *f)
+                                            {
+                                              --frames_alive;
+                                              delete f;
+                                            });
+}
+
+// A square moving over a white background
+apng::frame make_frame(int t_width, int t_height, int t_pos)
+{
+  apng::frame f{t_width, t_height,
+                std::vector<uint8_t>(static_cast<size_t>(t_width) * t_height * 4, 0xFF)};
+  for (int y = 0; y < 5 && y < t_height; ++y)
+  {
+    for (int x = 0; x < 5; ++x)
+    {
+      const int px = (t_pos + x) % t_width;
+      std::memcpy(&f.rgba[(static_cast<size_t>(y) * t_width + px) * 4], "\x20\x40\x80\xFF",
+                  4);
+    }
+  }
+  return f;
+}
+
+uint32_t get_u32(const uint8_t *t_data)
+{
+  return (uint32_t(t_data[0]) << 24) | (uint32_t(t_data[1]) << 16) |
+         (uint32_t(t_data[2]) << 8) | t_data[3];
+}
+
+struct decoded
+{
+  int width{0};
+  int height{0};
+  uint32_t num_frames{0};
+  std::vector<std::vector<uint8_t>> frames;  // canvas after each frame
+  std::vector<uint16_t> delays;
+  bool crc_ok{true};
+};
+
+// Minimal APNG decoder for the output of the encoder (8 bit RGBA, Sub filter)
+decoded decode(const uint8_t *t_data, size_t t_size)
+{
+  decoded res;
+  std::vector<uint8_t> canvas;
+  uint32_t fx = 0, fy = 0, fw = 0, fh = 0;
+  for (size_t pos = 8; pos + 12 <= t_size;)
+  {
+    const uint32_t length = get_u32(t_data + pos);
+    const std::string type(reinterpret_cast<const char *>(t_data + pos + 4), 4);
+    const uint8_t *body = t_data + pos + 8;
+    const uLong crc = crc32(crc32(0L, Z_NULL, 0), t_data + pos + 4, length + 4);
+    res.crc_ok = res.crc_ok && crc == get_u32(body + length);
+    pos += length + 12;
+
+    if (type == "IHDR")
+    {
+      res.width = get_u32(body);
+      res.height = get_u32(body + 4);
+      canvas.assign(static_cast<size_t>(res.width) * res.height * 4, 0);
+    }
+    else if (type == "acTL")
+    {
+      res.num_frames = get_u32(body);
+    }
+    else if (type == "fcTL")
+    {
+      fw = get_u32(body + 4);
+      fh = get_u32(body + 8);
+      fx = get_u32(body + 12);
+      fy = get_u32(body + 16);
+      res.delays.push_back(static_cast<uint16_t>((body[20] << 8) | body[21]));
+    }
+    else if (type == "IDAT" || type == "fdAT")
+    {
+      const size_t skip = type == "fdAT" ? 4 : 0;
+      const size_t row_size = fw * 4;
+      std::vector<uint8_t> raw((row_size + 1) * fh);
+      uLongf raw_size = raw.size();
+      uncompress(raw.data(), &raw_size, body + skip, length - skip);
+      for (uint32_t y = 0; y < fh; ++y)
+      {
+        uint8_t *row = &raw[y * (row_size + 1) + 1];
+        for (size_t i = 4; i < row_size; ++i)
+        {
+          row[i] = static_cast<uint8_t>(row[i] + row[i - 4]);
+        }
+        std::memcpy(&canvas[((fy + y) * res.width + fx) * 4], row, row_size);
+      }
+      res.frames.push_back(canvas);
+    }
+  }
+  return res;
+}
+
+bool same_pixels(const std::vector<uint8_t> &t_canvas, int t_canvas_width,
+                 const apng::frame &t_frame)
+{
+  for (int y = 0; y < t_frame.height; ++y)
+  {
+    if (std::memcmp(&t_canvas[static_cast<size_t>(y) * t_canvas_width * 4],
+                    &t_frame.rgba[static_cast<size_t>(y) * t_frame.width * 4],
+                    static_cast<size_t>(t_frame.width) * 4) != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+int main()
+{
+  async::thread_pool pool(4);
+
+  {
+    // Moving square, every third frame repeated, last frame is larger
+    std::vector<int> positions;
+    for (int i = 0; i < 300; ++i)
+    {
+      positions.push_back(i - i / 3);
+    }
+    apng::encoder encoder(1, 10, &pool);
+    for (std::size_t i = 0; i < positions.size(); ++i)
+    {
+      encoder.add(tracked(make_frame(i + 1 == positions.size() ? 90 : 80, 60, positions[i])));
+    }
+    output_sink out;
+    apng::encode_stats stats;
+    expect("Frames are encoded", encoder.finish(&out, &stats));
+
+    const auto res = decode(out.data(), out.size());
+    expect("Chunk CRCs are valid", res.crc_ok);
+    expect("Canvas fits all frames", res.width == 90 && res.height == 60);
+    expect("Identical frames are merged",
+           res.num_frames == 201 && res.frames.size() == 201 && stats.frames == 201);
+
+    bool frames_match = true;
+    int total_delay = 0;
+    for (std::size_t i = 0, f = 0; i < positions.size(); ++i)
+    {
+      if (i > 0 && positions[i] == positions[i - 1])
+      {
+        continue;
+      }
+      const auto expected = make_frame(i + 1 == positions.size() ? 90 : 80, 60, positions[i]);
+      frames_match = frames_match && same_pixels(res.frames[f], res.width, expected);
+      total_delay += res.delays[f++];
+    }
+    expect("Decoded frames match the input", frames_match);
+    expect("Delays add up", total_delay == 300);
+    std::printf("     peak frames in memory: %d of 300\n", frames_peak.load());
+    // Up to two frames per queued diff task (four per pool thread), the first and the
+    // previous frame and the one being added
+    expect("Frames in memory are bounded", frames_peak <= 4 * 4 + 3);
+    expect("Frames are released", frames_alive == 0);
+  }
+
+  {
+    // More identical frames than a 16 bit delay can hold
+    apng::encoder encoder(1, 10, &pool);
+    for (int i = 0; i < 70000; ++i)
+    {
+      encoder.add(tracked(make_frame(8, 8, 0)));
+    }
+    output_sink out;
+    encoder.finish(&out);
+    const auto res = decode(out.data(), out.size());
+    int total_delay = 0;
+    for (auto d : res.delays)
+    {
+      total_delay += d;
+    }
+    expect("Long delays are split into frames",
+           res.num_frames == 2 && res.delays[0] == 65535 && total_delay == 70000 &&
+               res.frames.size() == 2 && res.frames[1] == res.frames[0]);
+  }
+
+  return failures == 0 ? 0 : 1;
+}
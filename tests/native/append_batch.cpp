@@ -0,0 +1,190 @@
+// Primitive batches of the C API: appended primitives are rendered, clipped and kept
+// by the page file, oversized batches are rejected without allocating, and the
+// throughput of append_batch is compared with recording draw calls one by one. Not
+// run by R CMD check, build and run from the package root with:
+//
+//   c++ -std=c++17 -O2 -DUNIGD_NO_CAIRO -DFMT_HEADER_ONLY -Isrc -Isrc/lib -Iinst/include \
+//     tests/native/append_batch.cpp src/page_store.cpp src/block_store.cpp \
+//     src/draw_data.cpp src/fingerprint.cpp src/page_file.cpp src/text_index.cpp \
+//     src/compress.cpp src/renderer_json.cpp src/base_64.cpp src/png_palette.cpp \
+//     src/output_sink.cpp -lpng -lz -o append_batch && ./append_batch
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "draw_data.h"
+#include "page_store.h"
+#include "renderer_json.h"
+
+namespace
+{
+using namespace unigd;
+using namespace unigd::renderers;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+std::string render_json(page_store *t_store, int t_index)
+{
+  RendererJSON renderer;
+  t_store->render(t_index, &renderer, 1.0);
+  const uint8_t *buf;
+  size_t size;
+  renderer.get_data(&buf, &size);
+  return std::string(reinterpret_cast<const char *>(buf), size);
+}
+
+std::size_t count(const std::string &t_str, const std::string &t_what)
+{
+  std::size_t n = 0;
+  for (auto pos = t_str.find(t_what); pos != std::string::npos;
+       pos = t_str.find(t_what, pos + 1))
+  {
+    n++;
+  }
+  return n;
+}
+
+struct line_batch
+{
+  std::vector<double> x0, y0, x1, y1;
+  std::vector<uint32_t> clip;
+  unigd_primitive_style style{0xFF000000u, 0x00FFFFFFu, 1.0, 0};
+  unigd_clip_rect clips[2]{{0, 0, 100, 100}, {100, 100, 200, 200}};
+
+  explicit line_batch(uint64_t t_size)
+  {
+    for (uint64_t i = 0; i < t_size; ++i)
+    {
+      x0.push_back(i % 700);
+      y0.push_back(i % 500);
+      x1.push_back(x0.back() + 3);
+      y1.push_back(y0.back() + 4);
+      clip.push_back(i < t_size / 2 ? 0 : 1);
+    }
+  }
+
+  unigd_primitive_batch get(bool t_clipped)
+  {
+    return {UNIGD_PRIMITIVE_LINE, x0.size(), x0.data(), y0.data(), x1.data(),
+            y1.data(), nullptr, &style, 1, t_clipped ? clip.data() : nullptr,
+            t_clipped ? clips : nullptr, t_clipped ? 2u : 0u};
+  }
+};
+
+double throughput(uint64_t t_n, std::chrono::steady_clock::time_point t_start)
+{
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+  return t_n / seconds / 1e6;
+}
+
+std::unique_ptr<DrawCall> line(const line_batch &t_batch, uint64_t t_i)
+{
+  return std::make_unique<Line>(
+      LineInfo{static_cast<color_t>(0xFF000000u), 1.0, 0, LineInfo::GC_ROUND_CAP,
+               LineInfo::GC_ROUND_JOIN, 10.0},
+      gvertex<double>{t_batch.x0[t_i], t_batch.y0[t_i]},
+      gvertex<double>{t_batch.x1[t_i], t_batch.y1[t_i]});
+}
+}  // namespace
+
+int main()
+{
+  {
+    page_store store;
+    store.append({720, 576});
+    line_batch lines(10);
+    double cx[] = {50}, cy[] = {60}, r[] = {5};
+    unigd_primitive_style fill{0xFF000000u, 0xFF0000FFu, 1.0, 0};
+    unigd_primitive_batch circles{UNIGD_PRIMITIVE_CIRCLE, 1, cx, cy, r, nullptr,
+                                  nullptr, &fill, 1, nullptr, nullptr, 0};
+    expect("Lines are appended", store.append_batch(0, lines.get(true)));
+    expect("Circles are appended", store.append_batch(0, circles));
+    const auto json = render_json(&store, 0);
+    expect("Appended primitives are rendered",
+           count(json, "\"type\": \"line\"") == 10 && count(json, "\"type\": \"circle\"") == 1);
+    expect("Batch clipping regions are used", count(json, "\"clip_id\": 2") == 5);
+
+    auto invalid = lines.get(false);
+    invalid.size = UINT64_MAX;
+    expect("Oversized batches are rejected", !store.append_batch(0, invalid));
+    invalid.size = (uint64_t{1} << 24) + 1;
+    expect("Batches over 2^24 primitives are rejected", !store.append_batch(0, invalid));
+    expect("Rejected batches append nothing", render_json(&store, 0) == json);
+  }
+
+  {
+    const std::string path = "append_batch_test.ugd";
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+    line_batch lines(4);
+    {
+      page_store store;
+      store.open_file(path);
+      store.append({720, 576});
+      store.append_batch(0, lines.get(false));
+      store.append({720, 576});  // writes the first page to the file
+      store.append_batch(0, lines.get(false));
+      store.flush();
+    }
+    page_store restored;
+    restored.open_file(path);
+    const auto json = render_json(&restored, 0);
+    expect("Page file keeps primitives appended after the page was stored",
+           restored.restored(0) && count(json, "\"type\": \"line\"") == 8);
+    const auto info = restored.info(0, 1);
+    expect("Restored pages report their draw calls",
+           info.entries.size() == 1 && info.entries[0].draw_calls == 8 &&
+               info.entries[0].clips == 1);
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+  }
+
+  // Throughput on the record path
+  const uint64_t n = 2000000;
+  line_batch lines(n);
+  {
+    page_store store;
+    store.append({720, 576});
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < n; ++i)
+    {
+      store.add_dc(0, line(lines, i), false);
+    }
+    std::printf("     add_dc per primitive   %6.2f M/s\n", throughput(n, start));
+  }
+  {
+    page_store store;
+    store.append({720, 576});
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<DrawCall>> buffer;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+      buffer.emplace_back(line(lines, i));
+    }
+    store.add_dc(0, std::move(buffer), false);
+    std::printf("     add_dc buffered        %6.2f M/s\n", throughput(n, start));
+  }
+  {
+    page_store store;
+    store.append({720, 576});
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = store.append_batch(0, lines.get(false));
+    std::printf("     append_batch           %6.2f M/s\n", throughput(n, start));
+    expect("Large batches are appended", ok);
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+// Block deduplication shares draw calls only when their content is equal, not just
+// their hashes. Not run by R CMD check, build and run from the package root with:
+//
+//   c++ -std=c++17 -DUNIGD_NO_CAIRO -Isrc -Isrc/lib -Iinst/include \
+//     tests/native/block_dedupe.cpp src/block_store.cpp src/draw_data.cpp \
+//     src/fingerprint.cpp -o block_dedupe && ./block_dedupe
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "block_store.h"
+#include "draw_data.h"
+#include "fingerprint.h"
+
+namespace
+{
+using namespace unigd;
+using namespace unigd::renderers;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+LineInfo line_info(double t_lwd = 1.0)
+{
+  return {0, t_lwd, 0, LineInfo::GC_ROUND_CAP, LineInfo::GC_ROUND_JOIN, 10.0};
+}
+
+std::unique_ptr<DrawCall> line(double t_x)
+{
+  return std::make_unique<Line>(line_info(), gvertex<double>{t_x, 0},
+                                gvertex<double>{t_x, 10});
+}
+
+std::unique_ptr<DrawCall> polygon(double t_y)
+{
+  return std::make_unique<Polygon>(line_info(), 0,
+                                   std::vector<gvertex<double>>{{0, 0}, {5, t_y}, {9, 1}});
+}
+
+std::unique_ptr<DrawCall> text(const char *t_str)
+{
+  return std::make_unique<Text>(0, gvertex<double>{1, 2}, t_str, 0, 0.5,
+                                TextInfo{400, "", "sans", 12, false, 30});
+}
+
+Page page(int t_id, int t_lines, double t_offset = 0)
+{
+  Page p{static_cast<page_id_t>(t_id), {720, 576}};
+  std::vector<std::unique_ptr<DrawCall>> dcs;
+  for (int i = 0; i < t_lines; ++i)
+  {
+    dcs.emplace_back(line(i + t_offset));
+  }
+  p.put(std::move(dcs));
+  return p;
+}
+
+bool same(const std::unique_ptr<DrawCall> &t_lhs, const std::unique_ptr<DrawCall> &t_rhs)
+{
+  return fingerprint::same_content(*t_lhs, *t_rhs);
+}
+}  // namespace
+
+int main()
+{
+  expect("Equal lines", same(line(1), line(1)));
+  expect("Lines with different coordinates", !same(line(1), line(2)));
+  expect("Zero and negative zero differ, as in the hash", !same(line(0.0), line(-0.0)));
+  expect("Different types", !same(line(1), polygon(1)) && !same(polygon(1), line(1)));
+  expect("Equal polygons", same(polygon(3), polygon(3)));
+  expect("Polygons with different points", !same(polygon(3), polygon(4)));
+  expect("Equal text", same(text("label"), text("label")));
+  expect("Different text", !same(text("label"), text("other")));
+  {
+    auto thin = std::make_unique<Line>(line_info(1.0), gvertex<double>{0, 0},
+                                       gvertex<double>{1, 1});
+    auto thick = std::make_unique<Line>(line_info(2.0), gvertex<double>{0, 0},
+                                        gvertex<double>{1, 1});
+    expect("Different line widths", !fingerprint::same_content(*thin, *thick));
+  }
+  {
+    auto a = line(1);
+    auto b = line(1);
+    b->clip_id = 1;
+    expect("Different clip IDs", !same(a, b));
+  }
+
+  block_store blocks;
+  auto first = page(0, 8);
+  auto repeated = page(1, 8);
+  auto different = page(2, 8, 0.5);
+  blocks.dedupe(&first);
+  blocks.dedupe(&repeated);
+  blocks.dedupe(&different);
+  expect("Repeated blocks share draw calls",
+         repeated.dcs[3].get() == first.dcs[3].get() &&
+             blocks.get_stats().deduplicated == 8);
+  expect("Different blocks are kept",
+         different.dcs[3].get() != first.dcs[3].get() && blocks.get_stats().blocks == 2);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// Round trip of the preset dictionary deflate encoding. Not run by R CMD check,
+// build and run from the package root with:
+//
+//   c++ -std=c++17 -Isrc tests/native/compress_dict.cpp src/compress.cpp -lz \
+//     -o compress_dict && ./compress_dict
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "compress.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+// Decoder as clients implement it: raw inflate, dictionary set up front
+bool inflate_dict(const std::vector<uint8_t> &t_input, std::string *t_output)
+{
+  z_stream zs{};
+  if (inflateInit2(&zs, -15) != Z_OK)
+  {
+    return false;
+  }
+  const auto &dict = compr::dictionary();
+  if (inflateSetDictionary(&zs, reinterpret_cast<const Bytef *>(dict.data()),
+                           static_cast<uInt>(dict.size())) != Z_OK)
+  {
+    inflateEnd(&zs);
+    return false;
+  }
+  zs.next_in = const_cast<Bytef *>(t_input.data());
+  zs.avail_in = static_cast<uInt>(t_input.size());
+  int ret = Z_OK;
+  while (ret == Z_OK)
+  {
+    char chunk[4096];
+    zs.next_out = reinterpret_cast<Bytef *>(chunk);
+    zs.avail_out = sizeof(chunk);
+    ret = inflate(&zs, Z_NO_FLUSH);
+    t_output->append(chunk, sizeof(chunk) - zs.avail_out);
+  }
+  inflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+
+std::string svg(int t_points)
+{
+  std::string res =
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"720.00\" height=\"576.00\">\n";
+  for (int i = 0; i < t_points; ++i)
+  {
+    res += "<circle cx=\"" + std::to_string(i * 7 % 720) + "\" cy=\"" +
+           std::to_string(i * 13 % 576) +
+           "\" r=\"2.70\" style=\"stroke-width: 0.75;\"/>\n";
+  }
+  return res + "</svg>";
+}
+}  // namespace
+
+int main()
+{
+  for (int points : {0, 10, 10000})
+  {
+    const auto input = svg(points);
+    const auto encoded = compr::compress_dict(
+        reinterpret_cast<const uint8_t *>(input.data()), input.size());
+    std::string decoded;
+    const auto name = "Round trip of " + std::to_string(points) + " points";
+    expect(name.c_str(), inflate_dict(encoded, &decoded) && decoded == input);
+  }
+
+  const std::string dict = compr::dictionary();
+  expect("Dictionary ID is the Adler-32 checksum",
+         compr::dictionary_id() ==
+             adler32(adler32(0, Z_NULL, 0), reinterpret_cast<const Bytef *>(dict.data()),
+                     static_cast<uInt>(dict.size())));
+
+  // zlib sizes are 32 bit, larger inputs must not be truncated silently. The input
+  // is not read when the size is rejected.
+  const uint8_t byte = 0;
+  expect("Inputs over 4 GiB are rejected",
+         compr::compress_dict(&byte, std::size_t{std::numeric_limits<uInt>::max()} + 1)
+             .empty());
+
+  return failures == 0 ? 0 : 1;
+}
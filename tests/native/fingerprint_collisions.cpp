@@ -0,0 +1,88 @@
+// Draw calls that differ only in sign bits or in a few bits of several fields must
+// hash differently. The fingerprint is used as ETag, render cache key and block
+// dedupe key. Not run by R CMD check, build and run from the package root with:
+//
+//   c++ -std=c++17 -DUNIGD_NO_CAIRO -Isrc -Isrc/lib -Iinst/include \
+//     tests/native/fingerprint_collisions.cpp src/draw_data.cpp src/fingerprint.cpp \
+//     -o fingerprint_collisions && ./fingerprint_collisions
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+#include "draw_data.h"
+#include "fingerprint.h"
+
+namespace
+{
+using namespace unigd;
+using namespace unigd::renderers;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+void expect_different(const char *t_name, fingerprint::fingerprint_t t_a,
+                      fingerprint::fingerprint_t t_b)
+{
+  expect(t_name, t_a != t_b);
+}
+
+LineInfo line_info()
+{
+  return {0, 1.0, 0, LineInfo::GC_ROUND_CAP, LineInfo::GC_ROUND_JOIN, 10.0};
+}
+
+fingerprint::fingerprint_t line(gvertex<double> t_orig, gvertex<double> t_dest)
+{
+  return fingerprint::draw_call(Line(line_info(), t_orig, t_dest));
+}
+
+fingerprint::fingerprint_t text(double t_rot, double t_hadj)
+{
+  return fingerprint::draw_call(Text(0, {10, 20}, "label", t_rot, t_hadj,
+                                     TextInfo{400, "", "sans", 12, false, 10}));
+}
+}  // namespace
+
+int main()
+{
+  // Flipping bit 63 of two consecutive words
+  expect_different(
+      "gvertex sign flip",
+      fingerprint::combine(fingerprint::seed, gvertex<double>{10.5, 20.25}),
+      fingerprint::combine(fingerprint::seed, gvertex<double>{-10.5, -20.25}));
+  expect_different("Text rot/hadj sign flip", text(90, 0.5), text(-90, -0.5));
+  expect_different("Line orig.y/dest.x sign flip", line({10, -20}, {-30, 40}),
+                   line({10, 20}, {30, 40}));
+
+  // Every combination of sign flips of all four coordinates
+  std::set<fingerprint::fingerprint_t> hashes;
+  for (int signs = 0; signs < 16; ++signs)
+  {
+    auto s = [&](int bit, double v) { return signs & (1 << bit) ? -v : v; };
+    hashes.insert(line({s(0, 10), s(1, 20)}, {s(2, 30), s(3, 40)}));
+  }
+  expect("Line sign flip combinations", hashes.size() == 16);
+
+  // Single bit flips anywhere in a buffer
+  std::string buffer(64, 'x');
+  std::set<fingerprint::fingerprint_t> flips{fingerprint::combine(fingerprint::seed,
+                                                                  buffer)};
+  for (std::size_t i = 0; i < buffer.size() * 8; ++i)
+  {
+    std::string flipped = buffer;
+    flipped[i / 8] = static_cast<char>(flipped[i / 8] ^ (1 << (i % 8)));
+    flips.insert(fingerprint::combine(fingerprint::seed, flipped));
+  }
+  expect("Single bit flips", flips.size() == buffer.size() * 8 + 1);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Output sinks take back partial output (memory, external buffers and seekable files)
+// and the indexed PNG encoder reports a failed write instead of leaving a truncated
+// image. Not run by R CMD check, build and run from the package root with:
+//
+//   c++ -std=c++17 -Isrc tests/native/output_sink.cpp src/output_sink.cpp \
+//     src/png_palette.cpp -lpng -lz -o output_sink && ./output_sink
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "output_sink.h"
+#include "png_palette.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+const uint8_t data[] = "0123456789";
+
+// External buffer that can not grow beyond a limit
+struct limited_buffer
+{
+  std::vector<uint8_t> buffer;
+  size_t limit;
+};
+
+uint8_t *limited_reserve(void *t_user, size_t t_capacity)
+{
+  auto *b = static_cast<limited_buffer *>(t_user);
+  if (t_capacity > b->limit)
+  {
+    return nullptr;
+  }
+  b->buffer.resize(t_capacity);
+  return b->buffer.data();
+}
+
+bool count_writer(void *t_user, const uint8_t *, uint64_t t_size)
+{
+  *static_cast<uint64_t *>(t_user) += t_size;
+  return true;
+}
+
+// Two colour image, suitable for the indexed encoder
+std::vector<uint32_t> image(int t_width, int t_height)
+{
+  std::vector<uint32_t> px(static_cast<size_t>(t_width) * t_height, 0xFFFFFFFF);
+  for (size_t i = 0; i < px.size(); i += 7)
+  {
+    px[i] = 0xFF0000FF;
+  }
+  return px;
+}
+}  // namespace
+
+int main()
+{
+  {
+    output_sink sink;
+    sink.write(data, 10);
+    expect("Memory sink truncates", sink.truncate(4) && sink.size() == 4 &&
+                                        std::memcmp(sink.data(), "0123", 4) == 0);
+    sink.write(data + 8, 2);
+    expect("Memory sink appends after truncation",
+           sink.size() == 6 && std::memcmp(sink.data(), "012389", 6) == 0);
+    expect("Truncating beyond the end fails", !sink.truncate(7) && sink.ok());
+  }
+  {
+    limited_buffer buffer{{}, 1024};
+    output_sink sink(limited_reserve, &buffer, 2);
+    sink.write(data, 10);
+    expect("External sink truncates", sink.truncate(3) && sink.size() == 3);
+    sink.write(data + 9, 1);
+    expect("External sink appends after truncation",
+           std::memcmp(sink.data(), "0129", 4) == 0);
+  }
+  {
+    char path[] = "/tmp/output_sink_XXXXXX";
+    const int fd = mkstemp(path);
+    output_sink sink(fd);
+    sink.write(data, 10);
+    const bool truncated = sink.truncate(5);
+    sink.write(data, 2);
+    char content[16] = {0};
+    const auto n = pread(fd, content, sizeof(content), 0);
+    expect("File sink truncates", truncated && n == 7 && std::string(content) == "0123401");
+    close(fd);
+    std::remove(path);
+  }
+  {
+    uint64_t written = 0;
+    output_sink sink(count_writer, &written);
+    sink.write(data, 10);
+    expect("Writer sink fails on truncation", !sink.truncate(5) && !sink.ok());
+  }
+
+  const int width = 200;
+  const int height = 200;
+  const auto px = image(width, height);
+  {
+    output_sink sink;
+    sink.write(data, 3);
+    expect("Indexed PNG is written",
+           png_palette::encode(px.data(), width, height, width * 4,
+                               png_palette::pixel_format::r_color,
+                               png_palette::mode::exact, &sink) &&
+               sink.size() > 3);
+  }
+  {
+    // The buffer runs out in the middle of the image
+    limited_buffer buffer{{}, 100};
+    output_sink sink(limited_reserve, &buffer, 0);
+    expect("Failed writes are reported",
+           !png_palette::encode(px.data(), width, height, width * 4,
+                                png_palette::pixel_format::r_color,
+                                png_palette::mode::exact, &sink) &&
+               !sink.ok());
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Counts heap allocations on the draw call record path, so redundant copies of
+// draw call payloads are caught. Not run by R CMD check, build and run from the
+// package root with:
+//
+//   c++ -std=c++17 -DUNIGD_NO_CAIRO -Isrc -Isrc/lib -Iinst/include \
+//     tests/native/record_allocations.cpp src/page_store.cpp src/block_store.cpp \
+//     src/draw_data.cpp src/fingerprint.cpp src/page_file.cpp src/text_index.cpp \
+//     src/compress.cpp -lz -o record_allocations && ./record_allocations
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "draw_data.h"
+#include "page_store.h"
+
+namespace
+{
+std::size_t allocations = 0;
+bool counting = false;
+
+void *counted_alloc(std::size_t t_size)
+{
+  if (counting)
+  {
+    allocations++;
+  }
+  if (void *p = std::malloc(t_size ? t_size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+}  // namespace
+
+void *operator new(std::size_t t_size) { return counted_alloc(t_size); }
+void *operator new[](std::size_t t_size) { return counted_alloc(t_size); }
+void operator delete(void *t_ptr) noexcept { std::free(t_ptr); }
+void operator delete[](void *t_ptr) noexcept { std::free(t_ptr); }
+void operator delete(void *t_ptr, std::size_t) noexcept { std::free(t_ptr); }
+void operator delete[](void *t_ptr, std::size_t) noexcept { std::free(t_ptr); }
+
+namespace
+{
+using namespace unigd;
+using namespace unigd::renderers;
+
+int failures = 0;
+
+template <class F>
+void expect_allocations(const char *t_name, std::size_t t_expected, F t_fn)
+{
+  allocations = 0;
+  counting = true;
+  t_fn();
+  counting = false;
+  const bool ok = allocations == t_expected;
+  std::printf("%s %s: %zu allocations (expected %zu)\n", ok ? "ok  " : "FAIL", t_name,
+              allocations, t_expected);
+  if (!ok)
+  {
+    failures++;
+  }
+}
+
+LineInfo line_info()
+{
+  return {0, 1.0, 0, LineInfo::GC_ROUND_CAP, LineInfo::GC_ROUND_JOIN, 10.0};
+}
+
+// Payloads are built like unigd_device::dev_* builds them
+std::vector<gvertex<double>> points(int t_n)
+{
+  std::vector<gvertex<double>> res(t_n);
+  for (int i = 0; i < t_n; ++i)
+  {
+    res[i] = {i * 1.0, i * 2.0};
+  }
+  return res;
+}
+
+std::unique_ptr<DrawCall> line()
+{
+  return std::make_unique<Line>(line_info(), gvertex<double>{0, 0}, gvertex<double>{1, 1});
+}
+}  // namespace
+
+int main()
+{
+  // Strings longer than the small string buffer
+  const char *str = "a label that does not fit into the small string buffer";
+  const char *family = "a font family name that is long";
+
+  // One allocation per payload and one for the draw call itself
+
+  expect_allocations("Line", 1, [] { auto dc = line(); });
+  expect_allocations("Rect", 1, [] {
+    auto dc = std::make_unique<Rect>(line_info(), 0, grect<double>{0, 0, 1, 1});
+  });
+  expect_allocations("Circle", 1, [] {
+    auto dc = std::make_unique<Circle>(line_info(), 0, gvertex<double>{0, 0}, 1);
+  });
+  expect_allocations("Text", 3, [&] {
+    auto dc = std::make_unique<Text>(0, gvertex<double>{0, 0}, str, 0, 0,
+                                     TextInfo{400, "", family, 12, false, 10});
+  });
+  expect_allocations("Polyline", 2, [] {
+    auto dc = std::make_unique<Polyline>(line_info(), points(100));
+  });
+  expect_allocations("Polygon", 2, [] {
+    auto dc = std::make_unique<Polygon>(line_info(), 0, points(100));
+  });
+  expect_allocations("Path", 3, [] {
+    auto dc = std::make_unique<Path>(line_info(), 0, points(100),
+                                     std::vector<int>{50, 50}, true);
+  });
+  expect_allocations("Raster", 2, [] {
+    std::vector<unsigned int> raster(100 * 100);
+    auto dc = std::make_unique<Raster>(std::move(raster), gvertex<int>{100, 100},
+                                       grect<double>{0, 0, 1, 1}, 0, false);
+  });
+
+  // Recording does not allocate per draw call: a batch takes one shared owner, one
+  // draw call list reservation and one damage log entry, whatever its size.
+
+  for (std::size_t n : {1, 1000})
+  {
+    page_store store;
+    const auto index = store.append({720, 576});
+    std::vector<std::unique_ptr<DrawCall>> batch;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      batch.emplace_back(line());
+    }
+    const auto name = "page_store::add_dc batch of " + std::to_string(n);
+    expect_allocations(name.c_str(), 3,
+                       [&] { store.add_dc(index, std::move(batch), false); });
+  }
+  {
+    page_store store;
+    const auto index = store.append({720, 576});
+    auto dc = line();
+    // Shared pointer control block, draw call list and damage log entry
+    expect_allocations("page_store::add_dc single", 3,
+                       [&] { store.add_dc(index, std::move(dc), false); });
+  }
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
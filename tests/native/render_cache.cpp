@@ -0,0 +1,108 @@
+// Render cache hits, the byte limit of the cache and render fingerprints of plots
+// with identical content. Not run by R CMD check, build and run from the package
+// root with:
+//
+//   c++ -std=c++17 -DUNIGD_NO_CAIRO -DFMT_HEADER_ONLY -Isrc -Isrc/lib -Iinst/include \
+//     tests/native/render_cache.cpp src/render_cache.cpp src/page_store.cpp \
+//     src/block_store.cpp src/draw_data.cpp src/fingerprint.cpp src/page_file.cpp \
+//     src/text_index.cpp src/compress.cpp src/renderer_json.cpp src/base_64.cpp \
+//     src/png_palette.cpp src/output_sink.cpp -lpng -lz -o render_cache && ./render_cache
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "draw_data.h"
+#include "page_store.h"
+#include "render_cache.h"
+#include "renderer_json.h"
+
+namespace
+{
+using namespace unigd;
+using namespace unigd::renderers;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+std::vector<uint8_t> bytes(size_t t_size) { return std::vector<uint8_t>(t_size, 'x'); }
+
+void add_plot(page_store *t_store)
+{
+  const auto index = t_store->append({720, 576});
+  t_store->add_dc(index,
+                  std::make_unique<Line>(LineInfo{0, 1.0, 0, LineInfo::GC_ROUND_CAP,
+                                                  LineInfo::GC_ROUND_JOIN, 10.0},
+                                         gvertex<double>{10, 20}, gvertex<double>{30, 40}),
+                  false);
+}
+
+std::string render_json(page_store *t_store, int t_index)
+{
+  RendererJSON renderer;
+  t_store->render_if_size(t_index, &renderer, 1.0, {720, 576});
+  const uint8_t *buf;
+  size_t size;
+  renderer.get_data(&buf, &size);
+  return std::string(reinterpret_cast<const char *>(buf), size);
+}
+}  // namespace
+
+int main()
+{
+  {
+    render_cache cache(100);
+    const auto stored = cache.put(1, bytes(40));
+    expect("Cache hit", cache.get(1) == stored);
+    expect("Cache miss", cache.get(2) == nullptr);
+
+    cache.put(2, bytes(40));
+    cache.get(1);  // 2 is now least recently used
+    cache.put(3, bytes(40));
+    expect("Least recently used entry is evicted by size",
+           cache.get(1) && !cache.get(2) && cache.get(3));
+
+    const auto large = cache.put(4, bytes(101));
+    expect("Entries over the limit are returned but not cached",
+           large->size() == 101 && !cache.get(4) && cache.get(1) && cache.get(3));
+
+    cache.put(1, bytes(80));
+    expect("Replaced entries are not counted twice", cache.get(1)->size() == 80 &&
+                                                          !cache.get(3));
+  }
+
+  {
+    const render_cache_entry entry(1, bytes(0));
+    expect("Empty output is encoded",
+           entry.encode(UNIGD_RENDER_ENCODING_GZIP) &&
+               entry.encode(UNIGD_RENDER_ENCODING_DEFLATE_DICT) &&
+               !entry.data(UNIGD_RENDER_ENCODING_DEFLATE_DICT).empty());
+  }
+
+  {
+    page_store store;
+    add_plot(&store);
+    add_plot(&store);
+
+    fingerprint::fingerprint_t first, second;
+    store.fingerprint(0, "json", 1.0, {720, 576}, &first);
+    store.fingerprint(1, "json", 1.0, {720, 576}, &second);
+    expect("Identical plots have different fingerprints", first != second);
+
+    render_cache cache(1024 * 1024);
+    const auto json = render_json(&store, 0);
+    cache.put(first, std::vector<uint8_t>(json.begin(), json.end()));
+    expect("Identical plots do not share cached output", cache.get(second) == nullptr);
+    expect("JSON output contains the plot ID", json != render_json(&store, 1));
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Admission control of renders: concurrency bound, round robin between client queues,
+// rejections when the queues are full and non-blocking acquisition for progressive
+// renders, plus the cost of acquire() under contention. Not run by R CMD check, build
+// and run from the package root with:
+//
+//   c++ -std=c++17 -O2 -pthread -Isrc tests/native/render_limiter.cpp \
+//     src/render_limiter.cpp -o render_limiter && ./render_limiter
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "render_limiter.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+void sleep_ms(int t_ms) { std::this_thread::sleep_for(std::chrono::milliseconds(t_ms)); }
+}  // namespace
+
+int main()
+{
+  auto limiter = std::make_shared<render_limiter>();
+  limiter->set_limits({2, 4, 2});
+
+  {
+    // Both slots are held, then two clients queue three renders each
+    auto a = limiter->acquire();
+    auto b = limiter->acquire();
+    render_limiter::set_client(0);
+    expect("Slots are granted", a && b && !render_limiter::last_rejected());
+    expect("try_acquire is rejected when all slots are busy",
+           !limiter->try_acquire() && render_limiter::last_rejected());
+    render_limiter::reset_rejected();
+
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+    std::atomic<int> busy{0};
+    std::mutex order_mutex;
+    std::vector<int> order;
+    auto render = [&](uint64_t t_client)
+    {
+      render_limiter::set_client(t_client);
+      auto slot = limiter->acquire();
+      if (!slot)
+      {
+        busy += render_limiter::last_rejected() ? 1 : 0;
+        return;
+      }
+      {
+        const std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(static_cast<int>(t_client));
+      }
+      const int now = ++running;
+      int p = peak;
+      while (now > p && !peak.compare_exchange_weak(p, now))
+      {
+      }
+      sleep_ms(5);
+      --running;
+    };
+
+    std::vector<std::thread> threads;
+    for (uint64_t client : {1, 1, 1, 2, 2, 2})
+    {
+      threads.emplace_back(render, client);
+      sleep_ms(5);
+    }
+    auto stats = limiter->get_stats();
+    expect("Client queues are bounded",
+           stats.queued == 4 && stats.clients == 2 && stats.rejected == 3);
+    expect("try_acquire does not overtake waiting renders", !limiter->try_acquire());
+
+    // One worker from now on, the queued renders run one by one
+    limiter->set_limits({1, 4, 2});
+    a = render_limiter::ticket();
+    b = render_limiter::ticket();
+    for (auto &t : threads)
+    {
+      t.join();
+    }
+    expect("Rejected renders report busy", busy == 2);
+    expect("Concurrency is bounded", peak == 1);
+    expect("Clients are served round robin",
+           order.size() == 4 && order[0] != order[1] && order[2] != order[3]);
+    stats = limiter->get_stats();
+    expect("Slots are released", stats.running == 0 && stats.queued == 0);
+  }
+
+  {
+    auto slot = limiter->try_acquire();
+    expect("try_acquire takes a free slot", slot && !render_limiter::last_rejected());
+  }
+
+  // Cost of acquire() with 16 threads competing for 4 slots
+  limiter->set_limits({4, 1000, 0});
+  std::atomic<long> admitted{0};
+  std::vector<std::thread> threads;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 16; ++i)
+  {
+    threads.emplace_back(
+        [&, i]()
+        {
+          render_limiter::set_client(i % 4);
+          for (int k = 0; k < 20000; ++k)
+          {
+            if (auto slot = limiter->acquire())
+            {
+              admitted++;
+            }
+          }
+        });
+  }
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::printf("     %ld acquires in %.3f s (%.2f us each)\n", admitted.load(), seconds,
+              seconds * 1e6 / admitted);
+  expect("All renders are admitted below the queue limit", admitted == 16 * 20000);
+
+  return failures == 0 ? 0 : 1;
+}
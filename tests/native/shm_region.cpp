@@ -0,0 +1,149 @@
+// Shared memory segments: names are random and created exclusively, and readers that
+// follow the generation sequence lock never accept a torn copy of the output while a
+// writer keeps replacing it. Dropped segments are flagged for readers that still map
+// them. Not run by R CMD check, build and run from the package root with:
+//
+//   c++ -std=c++17 -pthread -Isrc tests/native/shm_region.cpp src/shm_region.cpp \
+//     -o shm_region && ./shm_region   (add -lrt on older glibc)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "shm_region.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+bool exists(const std::string &t_name)
+{
+  const int fd = shm_open(t_name.c_str(), O_RDONLY, 0);
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  return fd >= 0;
+}
+}  // namespace
+
+int main()
+{
+  std::string first_name;
+  {
+    shm_region a;
+    shm_region b;
+    first_name = a.name();
+    expect("Segments are created", !a.name().empty() && !b.name().empty());
+    expect("Names differ", a.name() != b.name());
+    expect("Names fit macOS limits", a.name().size() <= 31 && a.name()[0] == '/');
+    expect("Segments can be opened by name", exists(a.name()) && exists(b.name()));
+    expect("Header is mapped", a.capacity() >= shm_region::header_size);
+  }
+  expect("Segments are unlinked", !exists(first_name));
+
+  shm_region region;
+  const size_t output_size = 256 * 1024;
+  region.reserve(shm_region::header_size + output_size);
+
+  // Reader maps the segment by name, like a client process
+  const int fd = shm_open(region.name().c_str(), O_RDONLY, 0);
+  const size_t map_size = shm_region::header_size + output_size;
+  auto *map = static_cast<const uint8_t *>(
+      mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0));
+  close(fd);
+  const auto *generation = reinterpret_cast<const std::atomic<uint64_t> *>(map);
+
+  std::atomic<bool> done{false};
+  std::thread writer(
+      [&]()
+      {
+        for (int i = 1; i <= 2000; ++i)
+        {
+          region.begin_write();
+          std::memset(region.data() + shm_region::header_size, i & 0xFF, output_size);
+          region.end_write(output_size - (i & 0xFF));
+          // Renders are not back to back, readers get a chance to copy complete output
+          if (i % 4 == 0)
+          {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+          }
+        }
+        done = true;
+      });
+
+  std::vector<uint8_t> copy(output_size);
+  unsigned accepted = 0;
+  unsigned torn = 0;
+  unsigned retried = 0;
+  while (!done)
+  {
+    const uint64_t before = generation->load(std::memory_order_acquire);
+    if (before % 2 == 1)
+    {
+      retried++;
+      std::this_thread::yield();
+      continue;
+    }
+    uint64_t size;
+    std::memcpy(&size, map + sizeof(uint64_t), sizeof(size));
+    std::memcpy(copy.data(), map + shm_region::header_size, output_size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (generation->load(std::memory_order_relaxed) != before)
+    {
+      retried++;
+      continue;
+    }
+    if (before == 0)
+    {
+      continue;
+    }
+    accepted++;
+    const uint8_t value = copy[0];
+    const bool consistent =
+        size == output_size - value &&
+        std::all_of(copy.begin(), copy.end(), [=](uint8_t v) { return v == value; });
+    torn += consistent ? 0 : 1;
+  }
+  writer.join();
+  std::printf("     %u copies accepted, %u retried\n", accepted, retried);
+  expect("Accepted copies are consistent", accepted > 0 && torn == 0);
+  expect("Generation is even when done", generation->load() == 4000);
+
+  munmap(const_cast<uint8_t *>(map), map_size);
+
+  // Readers that still map a dropped segment see the flag
+  auto dropped = std::make_unique<shm_region>();
+  dropped->reserve(shm_region::header_size);
+  const int dropped_fd = shm_open(dropped->name().c_str(), O_RDONLY, 0);
+  auto *dropped_map = static_cast<const uint8_t *>(
+      mmap(nullptr, shm_region::header_size, PROT_READ, MAP_SHARED, dropped_fd, 0));
+  close(dropped_fd);
+  const auto *flag =
+      reinterpret_cast<const std::atomic<uint64_t> *>(dropped_map + 2 * sizeof(uint64_t));
+  expect("Live segment is not flagged", flag->load() == 0);
+  dropped.reset();
+  expect("Dropped segment is flagged", flag->load(std::memory_order_acquire) == 1);
+  munmap(const_cast<uint8_t *>(dropped_map), shm_region::header_size);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+// Throughput and compression ratio of the TIFF strip codecs on a plot like and a
+// photo like image, with strips compressed on the package worker pool as the TIFF
+// renderers do. Every strip is decoded again, including the predictor, and compared
+// with the input. Not run by R CMD check, build and run from the package root with:
+//
+//   c++ -std=c++17 -O2 -pthread -Isrc tests/native/tiff_codec.cpp src/tiff_codec.cpp \
+//     src/async_utils.cpp -lz -o tiff_codec && ./tiff_codec
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "async_utils.h"
+#include "tiff_codec.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+
+const int width = 2000;
+const int height = 1500;
+const std::size_t row_bytes = width * 4;
+const std::size_t strip_rows = 256 * 1024 / row_bytes;
+
+// White background with grid lines and a scatter of coloured points
+std::vector<uint8_t> plot_image()
+{
+  std::vector<uint8_t> img(row_bytes * height, 0xFF);
+  std::mt19937 rng(1);
+  auto set = [&](int x, int y, uint32_t c)
+  {
+    if (x >= 0 && y >= 0 && x < width && y < height)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        img[y * row_bytes + x * 4 + i] = static_cast<uint8_t>(c >> (8 * i));
+      }
+    }
+  };
+  for (int y = 0; y < height; y += 100)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      set(x, y, 0xFFDDDDDD);
+    }
+  }
+  for (int n = 0; n < 5000; ++n)
+  {
+    const int cx = rng() % width;
+    const int cy = rng() % height;
+    const uint32_t c = 0xFF000000 | (rng() & 0xFFFFFF);
+    for (int dy = -3; dy <= 3; ++dy)
+    {
+      for (int dx = -3; dx <= 3; ++dx)
+      {
+        set(cx + dx, cy + dy, c);
+      }
+    }
+  }
+  return img;
+}
+
+// Smooth gradients with noise
+std::vector<uint8_t> photo_image()
+{
+  std::vector<uint8_t> img(row_bytes * height);
+  std::mt19937 rng(2);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      uint8_t *px = &img[y * row_bytes + x * 4];
+      px[0] = static_cast<uint8_t>(x * 255 / width + rng() % 8);
+      px[1] = static_cast<uint8_t>(y * 255 / height + rng() % 8);
+      px[2] = static_cast<uint8_t>((x + y) / 16 + rng() % 8);
+      px[3] = 0xFF;
+    }
+  }
+  return img;
+}
+
+// TIFF LZW as written by libtiff: MSB first codes, the width grows one code early
+bool lzw_decode(const std::vector<uint8_t> &t_in, std::vector<uint8_t> *t_out)
+{
+  std::vector<uint16_t> prefix(4096);
+  std::vector<uint8_t> suffix(4096);
+  std::vector<uint8_t> first(4096);
+  for (uint32_t i = 0; i < 256; ++i)
+  {
+    suffix[i] = first[i] = static_cast<uint8_t>(i);
+  }
+  std::size_t pos = 0;
+  auto read = [&](int t_bits, uint32_t *t_code)
+  {
+    if (pos + t_bits > t_in.size() * 8)
+    {
+      return false;
+    }
+    *t_code = 0;
+    for (int i = 0; i < t_bits; ++i, ++pos)
+    {
+      *t_code = *t_code << 1 | ((t_in[pos / 8] >> (7 - pos % 8)) & 1);
+    }
+    return true;
+  };
+
+  uint32_t free = 258;
+  int32_t prev = -1;
+  std::vector<uint8_t> str;
+  for (;;)
+  {
+    // The encoder adds its entry one code before the decoder does
+    const uint32_t encoder_free = free + (prev >= 0 ? 1 : 0);
+    int bits = 9;
+    while (encoder_free > (1U << bits) - 1)
+    {
+      bits++;
+    }
+    uint32_t code;
+    if (bits > 12 || !read(bits, &code))
+    {
+      return false;
+    }
+    if (code == 257)
+    {
+      return true;
+    }
+    if (code == 256)
+    {
+      free = 258;
+      prev = -1;
+      continue;
+    }
+    if (prev < 0)
+    {
+      if (code > 255)
+      {
+        return false;
+      }
+      t_out->push_back(static_cast<uint8_t>(code));
+      prev = static_cast<int32_t>(code);
+      continue;
+    }
+    if (code > free || free >= 4096)
+    {
+      return false;
+    }
+    prefix[free] = static_cast<uint16_t>(prev);
+    suffix[free] = code == free ? first[prev] : first[code];
+    first[free] = first[prev];
+    free++;
+    str.clear();
+    for (uint32_t c = code;; c = prefix[c])
+    {
+      str.push_back(suffix[c]);
+      if (c < 256)
+      {
+        break;
+      }
+    }
+    t_out->insert(t_out->end(), str.rbegin(), str.rend());
+    prev = static_cast<int32_t>(code);
+  }
+}
+
+bool packbits_decode(const std::vector<uint8_t> &t_in, std::vector<uint8_t> *t_out)
+{
+  std::size_t i = 0;
+  while (i < t_in.size())
+  {
+    const int n = static_cast<int8_t>(t_in[i++]);
+    if (n >= 0)
+    {
+      if (i + n + 1 > t_in.size())
+      {
+        return false;
+      }
+      t_out->insert(t_out->end(), t_in.begin() + i, t_in.begin() + i + n + 1);
+      i += n + 1;
+    }
+    else if (n != -128)
+    {
+      if (i >= t_in.size())
+      {
+        return false;
+      }
+      t_out->insert(t_out->end(), 1 - n, t_in[i++]);
+    }
+  }
+  return true;
+}
+
+// Decodes a strip of t_rows rows and undoes the predictor
+bool decode(const std::vector<uint8_t> &t_in, std::size_t t_rows,
+            const tiff_codec::options &t_options, std::vector<uint8_t> *t_out)
+{
+  t_out->clear();
+  bool ok = true;
+  switch (t_options.codec)
+  {
+    case tiff_codec::compression::none:
+      t_out->assign(t_in.begin(), t_in.end());
+      break;
+    case tiff_codec::compression::lzw:
+      ok = lzw_decode(t_in, t_out);
+      break;
+    case tiff_codec::compression::packbits:
+      ok = packbits_decode(t_in, t_out);
+      break;
+    case tiff_codec::compression::deflate:
+    {
+      t_out->resize(t_rows * row_bytes);
+      uLongf size = t_out->size();
+      ok = uncompress(t_out->data(), &size, t_in.data(), t_in.size()) == Z_OK;
+      t_out->resize(size);
+      break;
+    }
+  }
+  if (!ok || t_out->size() != t_rows * row_bytes)
+  {
+    return false;
+  }
+  if (tiff_codec::uses_predictor(t_options))
+  {
+    for (std::size_t y = 0; y < t_rows; ++y)
+    {
+      uint8_t *row = t_out->data() + y * row_bytes;
+      for (std::size_t i = 4; i < row_bytes; ++i)
+      {
+        row[i] = static_cast<uint8_t>(row[i] + row[i - 4]);
+      }
+    }
+  }
+  return true;
+}
+
+struct result
+{
+  double seconds;
+  std::size_t bytes;
+  bool roundtrip;
+};
+
+result run(const std::vector<uint8_t> &t_image, const tiff_codec::options &t_options)
+{
+  auto *pool = async::worker_pool();
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::future<std::vector<uint8_t>>> strips;
+  for (std::size_t y = 0; y < height; y += strip_rows)
+  {
+    const std::size_t rows = std::min<std::size_t>(strip_rows, height - y);
+    strips.push_back(pool->submit(
+        [&, y, rows]()
+        {
+          std::vector<uint8_t> strip(t_image.begin() + y * row_bytes,
+                                     t_image.begin() + (y + rows) * row_bytes);
+          return tiff_codec::encode(strip.data(), row_bytes, rows, 4, t_options);
+        }));
+  }
+  result res{0, 0, true};
+  std::vector<std::vector<uint8_t>> encoded;
+  for (auto &f : strips)
+  {
+    encoded.push_back(pool->get(f));
+    res.bytes += encoded.back().size();
+  }
+  res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                    .count();
+
+  std::vector<uint8_t> raw;
+  for (std::size_t i = 0; i < encoded.size(); ++i)
+  {
+    const std::size_t y = i * strip_rows;
+    const std::size_t rows = std::min<std::size_t>(strip_rows, height - y);
+    res.roundtrip = res.roundtrip && decode(encoded[i], rows, t_options, &raw) &&
+                    std::equal(raw.begin(), raw.end(), t_image.begin() + y * row_bytes);
+  }
+  return res;
+}
+}  // namespace
+
+int main()
+{
+  struct named
+  {
+    const char *name;
+    tiff_codec::options options;
+  };
+  const named codecs[] = {
+      {"none", {tiff_codec::compression::none, -1, false}},
+      {"packbits", {tiff_codec::compression::packbits, -1, false}},
+      {"lzw", {tiff_codec::compression::lzw, -1, false}},
+      {"lzw+predictor", {tiff_codec::compression::lzw, -1, true}},
+      {"deflate 1", {tiff_codec::compression::deflate, 1, false}},
+      {"deflate", {tiff_codec::compression::deflate, -1, false}},
+      {"deflate+predictor", {tiff_codec::compression::deflate, -1, true}},
+  };
+  const struct
+  {
+    const char *name;
+    std::vector<uint8_t> data;
+  } images[] = {{"plot", plot_image()}, {"photo", photo_image()}};
+
+  std::printf("%zu threads, %dx%d RGBA\n", async::worker_pool()->size(), width, height);
+  bool bounded = true;
+  for (const auto &image : images)
+  {
+    for (const auto &codec : codecs)
+    {
+      run(image.data, codec.options);  // warm up
+      const auto res = run(image.data, codec.options);
+      std::printf("     %-6s %-18s %8.1f MB/s  ratio %6.2f\n", image.name, codec.name,
+                  image.data.size() / res.seconds / 1e6,
+                  static_cast<double>(image.data.size()) / res.bytes);
+      const std::string name = std::string(image.name) + " " + codec.name +
+                               " strips decode to the input";
+      expect(name.c_str(), res.roundtrip);
+      bounded = bounded && res.bytes <= tiff_codec::max_encoded_size(image.data.size());
+    }
+  }
+  expect("Encoded size is within max_encoded_size", bounded);
+
+  async::worker_pool_shutdown();
+  return failures == 0 ? 0 : 1;
+}
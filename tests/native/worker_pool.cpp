@@ -0,0 +1,86 @@
+// Shared worker pool: tasks waiting for tasks they submitted, and draining queued
+// tasks on shutdown. Not run by R CMD check, build and run from the package root
+// with:
+//
+//   c++ -std=c++17 -pthread -Isrc tests/native/worker_pool.cpp src/async_utils.cpp \
+//     -o worker_pool && ./worker_pool
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "async_utils.h"
+
+namespace
+{
+using namespace unigd;
+
+int failures = 0;
+
+void expect(const char *t_name, bool t_ok)
+{
+  std::printf("%s %s\n", t_ok ? "ok  " : "FAIL", t_name);
+  if (!t_ok)
+  {
+    failures++;
+  }
+}
+}  // namespace
+
+int main()
+{
+  {
+    // Every worker is busy with a task that waits for subtasks
+    async::thread_pool pool(2);
+    std::vector<std::future<int>> outer;
+    for (int i = 0; i < 8; ++i)
+    {
+      outer.push_back(pool.submit(
+          [&pool, i]
+          {
+            std::vector<std::future<int>> inner;
+            for (int j = 0; j < 4; ++j)
+            {
+              inner.push_back(pool.submit([i, j] { return i * j; }));
+            }
+            int sum = 0;
+            for (auto &f : inner)
+            {
+              sum += pool.get(f);
+            }
+            return sum;
+          }));
+    }
+    int total = 0;
+    for (auto &f : outer)
+    {
+      total += pool.get(f);
+    }
+    expect("Nested tasks do not deadlock", total == 6 * 28);
+  }
+
+  {
+    std::atomic<int> done{0};
+    auto *pool = async::worker_pool();
+    expect("Shared pool is reused", pool == async::worker_pool());
+    for (int i = 0; i < 100; ++i)
+    {
+      pool->submit(
+          [&done]
+          {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            done++;
+          });
+    }
+    async::worker_pool_shutdown();
+    expect("Shutdown runs all queued tasks", done == 100);
+
+    auto f = async::worker_pool()->submit([] { return 1; });
+    expect("Shared pool is created again after shutdown", f.get() == 1);
+    async::worker_pool_shutdown();
+  }
+
+  return failures == 0 ? 0 : 1;
+}